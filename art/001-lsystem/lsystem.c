@@ -0,0 +1,1787 @@
+#include "lsystem.h"
+#include "plsystem.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Everything needed to draw a word and save the result. */
+typedef struct lsystem_canvas_s
+{
+    amiss_backend_st backend;
+    gradient_st gradient;
+    uint8_t *bg; /* Copy of the background, NULL if not kept. */
+} lsystem_canvas_st;
+
+/* Gradient details. */
+static double_t const canvas_stops[] = {0.0, 0.5, 1.0};
+
+/* Segments converted to lines at once before they are handed to a backend. */
+#define SEGS_DRAW_BATCH 256U
+
+/**
+ * @brief Create a canvas and paint the background on it.
+ * @param canvas Canvas to create.
+ * @param backend Backend drawing on the canvas.
+ * @param draw_params Colors of the background.
+ * @param keep_bg Keep a copy of the background so it can be restored quickly.
+ * @param size Width and height of the canvas.
+ * @param arena Where to allocate the pixels from.
+ * @return 0 on success, 1 on failure.
+ */
+static uint8_t canvas_create(lsystem_canvas_st *const canvas,
+                             amiss_backend_kind_et const backend,
+                             lsystem_draw_params_st const *const draw_params,
+                             bool const keep_bg, uint32_t const size,
+                             amiss_arena_st *const arena)
+{
+    PROF_SCOPE("canvas_create");
+    uint64_t const t_begin = amiss_stage_now();
+    if (amiss_backend_create(&canvas->backend, backend, arena, size, size) !=
+        0)
+    {
+        log_err("MAIN", "Failed to allocate image\n");
+        return 1U;
+    }
+    canvas->bg = NULL;
+
+    /* Add background to image. */
+    canvas->gradient = (gradient_st){.count = 3U,
+                                     .colors = draw_params->color_gradient,
+                                     .stops = canvas_stops};
+    amiss_backend_gradient(&canvas->backend, canvas->gradient);
+
+    size_t bg_len;
+    uint8_t const *const pixels =
+        amiss_backend_pixels(&canvas->backend, &bg_len);
+    if (keep_bg == true && pixels != NULL)
+    {
+        canvas->bg = amiss_arena_alloc(arena, bg_len);
+        if (canvas->bg == NULL)
+        {
+            log_err("MAIN", "Failed to allocate background copy\n");
+            amiss_backend_destroy(&canvas->backend);
+            return 1U;
+        }
+        memcpy(canvas->bg, pixels, bg_len);
+    }
+    amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
+    return 0U;
+}
+
+/**
+ * @brief Restore the background of a canvas, erasing everything drawn on it.
+ * @param canvas Canvas to clear.
+ */
+static void canvas_clear(lsystem_canvas_st *const canvas)
+{
+    PROF_SCOPE("canvas_clear");
+    uint64_t const t_begin = amiss_stage_now();
+    if (canvas->bg != NULL)
+    {
+        size_t bg_len;
+        uint8_t *const pixels = amiss_backend_pixels(&canvas->backend, &bg_len);
+        memcpy(pixels, canvas->bg, bg_len);
+    }
+    else
+    {
+        amiss_backend_gradient(&canvas->backend, canvas->gradient);
+    }
+    amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
+}
+
+/**
+ * @brief Save a canvas in the file format of its backend.
+ * @param canvas What to save.
+ * @param path_prefix Start of the path, the file extension gets appended to it.
+ * @param frame Index of the frame, appended to the path when not negative.
+ * @return 0 on success, 1 on failure.
+ */
+static uint8_t canvas_save(lsystem_canvas_st *const canvas,
+                           char const *const path_prefix, int32_t const frame)
+{
+    PROF_SCOPE("canvas_save");
+    char path_out[512U];
+    char const *const ext = amiss_backend_ext(canvas->backend.kind);
+    int const path_len =
+        frame < 0 ? snprintf(path_out, sizeof(path_out), "%s.%s", path_prefix,
+                             ext)
+                  : snprintf(path_out, sizeof(path_out), "%s_f%02d.%s",
+                             path_prefix, frame, ext);
+    if (path_len < 0 || (uint32_t)path_len >= sizeof(path_out))
+    {
+        log_err("MAIN", "Output path is too long\n");
+        return 1U;
+    }
+    if (amiss_backend_save(&canvas->backend, path_out) != 0)
+    {
+        log_err("MAIN", "Failed to save image to disk\n");
+        return 1U;
+    }
+    return 0U;
+}
+
+/**
+ * @brief Draw a range of segments on a canvas.
+ * @param segs Segments to draw.
+ * @param seg_first Index of the first segment to draw.
+ * @param seg_count How many segments to draw.
+ * @param draw_params How to draw the segments.
+ * @param backend Canvas to draw on.
+ */
+static void segs_draw(lsystem_seg_st const *const segs,
+                      uint32_t const seg_first, uint32_t const seg_count,
+                      lsystem_draw_params_st const draw_params,
+                      amiss_backend_st *const backend)
+{
+    PROF_SCOPE("segs_draw");
+    uint64_t const t_begin = amiss_stage_now();
+    amiss_line_st lines[SEGS_DRAW_BATCH];
+    for (uint32_t batch_first = seg_first;
+         batch_first < seg_first + seg_count; batch_first += SEGS_DRAW_BATCH)
+    {
+        uint32_t const batch_count =
+            seg_first + seg_count - batch_first < SEGS_DRAW_BATCH
+                ? seg_first + seg_count - batch_first
+                : SEGS_DRAW_BATCH;
+        for (uint32_t line_idx = 0U; line_idx < batch_count; ++line_idx)
+        {
+            lsystem_seg_st const *const seg = &segs[batch_first + line_idx];
+            lines[line_idx] = (amiss_line_st){
+                .start = seg->start, .end = seg->end, .width = seg->width};
+        }
+        amiss_backend_lines(backend, draw_params.color_branch, lines,
+                            batch_count);
+    }
+    amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
+}
+
+/**
+ * @brief Clip a segment to a view, Liang-Barsky style.
+ * @param seg Segment to clip.
+ * @param view_min Top left corner of the view.
+ * @param view_max Bottom right corner of the view, exclusive.
+ * @param t Set to where the clipped segment starts and ends, as fractions of
+ * the segment.
+ * @return True if some of the segment is in the view.
+ */
+static bool seg_clip(lsystem_seg_st const *const seg,
+                     double_t const view_min[2U], double_t const view_max[2U],
+                     double_t t[2U])
+{
+    t[0U] = 0.0;
+    t[1U] = 1.0;
+    for (uint32_t axis = 0U; axis < 2U; ++axis)
+    {
+        double_t const start = seg->start.a[axis];
+        double_t const delta = (double_t)seg->end.a[axis] - start;
+        if (delta == 0.0)
+        {
+            if (start < view_min[axis] || start >= view_max[axis])
+            {
+                return false;
+            }
+            continue;
+        }
+        double_t const t_min = (view_min[axis] - start) / delta;
+        double_t const t_max = (view_max[axis] - start) / delta;
+        double_t const t_in = t_min < t_max ? t_min : t_max;
+        double_t const t_out = t_min < t_max ? t_max : t_min;
+        t[0U] = t_in > t[0U] ? t_in : t[0U];
+        t[1U] = t_out < t[1U] ? t_out : t[1U];
+    }
+    return t[0U] <= t[1U];
+}
+
+/**
+ * @brief Draw the segments found in a view, clipped to it and scaled so the
+ * view fills the canvas.
+ * @param segs All segments.
+ * @param ids Indices of the segments overlapping the view, in drawing order.
+ * NULL to go through the first id_count segments.
+ * @param id_count Number of indices.
+ * @param view Part of the scene to draw.
+ * @param draw_params How to draw the segments.
+ * @param backend Canvas to draw on.
+ */
+static void segs_draw_view(lsystem_seg_st const *const segs,
+                           uint32_t const *const ids, uint32_t const id_count,
+                           amiss_box_st const view,
+                           lsystem_draw_params_st const draw_params,
+                           amiss_backend_st *const backend)
+{
+    PROF_SCOPE("segs_draw_view");
+    uint64_t const t_begin = amiss_stage_now();
+    double_t const view_min[2U] = {view.x0, view.y0};
+    double_t const view_max[2U] = {view.x1 + 1.0, view.y1 + 1.0};
+    double_t const view_size = view_max[0U] - view_min[0U] >
+                                       view_max[1U] - view_min[1U]
+                                   ? view_max[0U] - view_min[0U]
+                                   : view_max[1U] - view_min[1U];
+    double_t const scale = backend->w / view_size;
+    amiss_line_st lines[SEGS_DRAW_BATCH];
+    uint32_t line_count = 0U;
+    for (uint32_t id_idx = 0U; id_idx < id_count; ++id_idx)
+    {
+        lsystem_seg_st const *const seg =
+            &segs[ids != NULL ? ids[id_idx] : id_idx];
+        double_t t[2U];
+        if (seg_clip(seg, view_min, view_max, t) == false)
+        {
+            continue; /* Only its bounds overlap the view. */
+        }
+        vec2u32_st ends[2U];
+        for (uint32_t end_idx = 0U; end_idx < 2U; ++end_idx)
+        {
+            for (uint32_t axis = 0U; axis < 2U; ++axis)
+            {
+                double_t const start = seg->start.a[axis];
+                double_t const coord =
+                    start + (t[end_idx] * ((double_t)seg->end.a[axis] - start));
+                int64_t const px = llround((coord - view_min[axis]) * scale);
+                /* Safe cast, the segment is clipped to the view. */
+                ends[end_idx].a[axis] =
+                    px < 0 ? 0U
+                           : (px >= backend->w ? backend->w - 1U
+                                               : (uint32_t)px);
+            }
+        }
+        lines[line_count++] = (amiss_line_st){
+            .start = ends[0U], .end = ends[1U], .width = seg->width * scale};
+        if (line_count == SEGS_DRAW_BATCH)
+        {
+            amiss_backend_lines(backend, draw_params.color_branch, lines,
+                                line_count);
+            line_count = 0U;
+        }
+    }
+    if (line_count > 0U)
+    {
+        amiss_backend_lines(backend, draw_params.color_branch, lines,
+                            line_count);
+    }
+    amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
+}
+
+/**
+ * @brief Check if a production rule only stretches a line i.e. turns F into a
+ * run of Fs. Geometry drawn by a stretched F is kept, only scaled.
+ * @param prule Production rule to check.
+ * @return True if the rule stretches F, false if not.
+ */
+static bool prule_stretches(lsystem_prule_st const prule)
+{
+    if (strcmp(prule.l, "F") != 0 || prule.r[0U] == '\0')
+    {
+        return false;
+    }
+    for (uint32_t r_idx = 0U; prule.r[r_idx] != '\0'; ++r_idx)
+    {
+        if (prule.r[r_idx] != 'F')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check if a symbol gets rewritten by any of the production rules.
+ * @param ls The L-system containing the production rules.
+ * @param sym Symbol to look for.
+ * @return True if some rule rewrites the symbol, false if not.
+ */
+static bool sym_rewritten(lsystem_st const ls, char const sym)
+{
+    for (uint32_t prule_idx = 0U; prule_idx < ls.pr_count; ++prule_idx)
+    {
+        if ((*ls.pr)[prule_idx].l[0U] == sym)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Check if every rewritten symbol (other than F) in a word is placed so
+ * that whatever it expands to can not move what gets drawn after it. This is
+ * the case when only rotations follow it until the end of the word or of the
+ * branch it's in.
+ * @param ls The L-system the word belongs to.
+ * @param w The word to check.
+ * @param wlen Length of the word.
+ * @return True if all rewritten symbols are placed safely, false if not.
+ */
+static bool word_grows_in_place(lsystem_st const ls, char const *const w,
+                                uint32_t const wlen)
+{
+    for (uint32_t w_idx = 0U; w_idx < wlen; ++w_idx)
+    {
+        if (w[w_idx] == 'F' || sym_rewritten(ls, w[w_idx]) == false)
+        {
+            continue;
+        }
+        for (uint32_t rest_idx = w_idx + 1U; rest_idx < wlen; ++rest_idx)
+        {
+            char const sym = w[rest_idx];
+            if (sym == ']')
+            {
+                break;
+            }
+            if (sym == 'F' || sym == '[' || sym_rewritten(ls, sym) == true)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Determine if every iteration of an L-system only adds geometry to the
+ * one before it, as long as the line length shrinks with each F stretch. When
+ * this holds, all iterations can be drawn by revealing the segments of the last
+ * one generation by generation.
+ * @param ls The L-system to check.
+ * @return True if geometry of earlier iterations survives, false if not.
+ */
+bool lsystem_grows_in_place(lsystem_st const ls)
+{
+    if (word_grows_in_place(ls, ls.axiom.w, ls.axiom.wlen) == false)
+    {
+        return false;
+    }
+    for (uint32_t prule_idx = 0U; prule_idx < ls.pr_count; ++prule_idx)
+    {
+        lsystem_prule_st const prule = (*ls.pr)[prule_idx];
+        if (strlen(prule.l) != 1U || strchr("+-[]", prule.l[0U]) != NULL)
+        {
+            return false;
+        }
+        if (prule.l[0U] == 'F' && prule_stretches(prule) == false)
+        {
+            return false;
+        }
+        if (word_grows_in_place(ls, prule.r, (uint32_t)strlen(prule.r)) ==
+            false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Determine if a production rule is applicable at given position in a
+ * word.
+ * @param prule Production rule to check.
+ * @param word Word to check applicability of rule for.
+ * @param word_idx Position in the word where to check if production rule
+ * applies.
+ * @return True if rule can be applied, false if not.
+ */
+bool lsystem_prule_check(lsystem_prule_st const prule,
+                         lsystem_vword_st *const word, uint32_t const word_idx)
+{
+    uint32_t const llen = (uint32_t)strlen(prule.l);
+    if (word_idx + llen <= word->wlen &&
+        memcmp(&word->w[word_idx], prule.l, llen) == 0)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+/**
+ * @brief Make sure a word has room for a given length, growing its buffers
+ * geometrically when it doesn't.
+ * @param word Word to grow, its symbols and generations are kept.
+ * @param wlen Length the word needs to be able to hold.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_word_reserve(lsystem_vword_st *const word, uint32_t const wlen)
+{
+    if (wlen <= word->blen)
+    {
+        return 0U;
+    }
+    uint32_t const blen_new =
+        word->blen * WLEN_SIZE_GROWTH > wlen ? word->blen * WLEN_SIZE_GROWTH
+                                             : wlen;
+    char *w_new =
+        amiss_arena_realloc(word->arena, word->w, word->blen, blen_new);
+    if (w_new == NULL)
+    {
+        log_err("RWR", "Failed to realloc buffer for rewritten word\n");
+        return 1U;
+    }
+    word->w = w_new;
+    if (word->g != NULL)
+    {
+        uint8_t *g_new =
+            amiss_arena_realloc(word->arena, word->g, word->blen, blen_new);
+        if (g_new == NULL)
+        {
+            log_err("RWR", "Failed to realloc buffer for generations of "
+                           "rewritten word\n");
+            return 1U;
+        }
+        word->g = g_new;
+    }
+    log_dbg("RWR", "Reallocated word buffer from %u to %u\n", word->blen,
+            blen_new);
+    word->blen = blen_new;
+    return 0U;
+}
+
+/**
+ * @brief Perform one rewrite iteration of the given word using a grammar.
+ * @param grammar What L-System grammar to use for generation.
+ * @param word Where the generated word will be stored. When the word tracks
+ * generations, symbols written by a rule are tagged with the new generation,
+ * except for F stretches which keep the generation of the F they replace.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_rewrite(lsystem_st const grammar, lsystem_vword_st *const word)
+{
+    if (grammar.rewrite != NULL)
+    {
+        return grammar.rewrite(word);
+    }
+    PROF_SCOPE("lsystem_rewrite");
+    /* Nothing to rewrite. */
+    if (word->wlen == 0)
+    {
+        return 1;
+    }
+    uint32_t prules_applied_total = 0U;
+    for (uint32_t word_idx = 0U; word_idx < word->wlen; ++word_idx)
+    {
+        uint32_t prules_applied = 0U;
+        for (uint32_t prule_idx = 0U; prule_idx < grammar.pr_count; ++prule_idx)
+        {
+            lsystem_prule_st const prule = (*grammar.pr)[prule_idx];
+            uint32_t const llen = (uint32_t)strlen(prule.l);
+            uint32_t const rlen = (uint32_t)strlen(prule.r);
+
+            if (lsystem_prule_check(prule, word, word_idx) == true)
+            {
+                log_dbg("RWR",
+                        // clang-format off
+                        "Applying rule %.*s->%.*s"
+                        CLR_TXT(CLR_YEL, " = ")
+                        "%.*s"
+                        CLR_TXT(CLR_BLU, "%.*s")
+                        "%.*s"
+                        " to...\n",
+                        // clang-format on
+                        llen, prule.l, rlen, prule.r, word_idx, &word->w[0U],
+                        llen, &word->w[word_idx], word->wlen - word_idx - llen,
+                        &word->w[word_idx + llen]);
+
+                int64_t const wlen_delta = rlen - llen;
+                /**
+                 * Safe cast because it is not possible for word length to
+                 * become negative here.
+                 */
+                uint32_t const wlen_after = (uint32_t)(word->wlen + wlen_delta);
+
+                /**
+                 * Allocate extra memory for word if rewrite rule leads to
+                 * overflow of current word buffer.
+                 */
+                if (lsystem_word_reserve(word, wlen_after) != 0U)
+                {
+                    return 1U;
+                }
+
+                /* Generation to tag the RHS with, read before it's moved. */
+                uint8_t const gen_rhs =
+                    word->g == NULL || prule_stretches(prule) == false
+                        ? (uint8_t)(word->gen + 1U)
+                        : word->g[word_idx];
+
+                /**
+                 * In order to rewrite, might have to move parts of the current
+                 * word to not overwrite them.
+                 */
+                if (wlen_delta != 0)
+                {
+                    memmove(&word->w[word_idx + (rlen - llen) + 1U],
+                            &word->w[word_idx + llen],
+                            word->wlen - word_idx - llen);
+                    if (word->g != NULL)
+                    {
+                        memmove(&word->g[word_idx + (rlen - llen) + 1U],
+                                &word->g[word_idx + llen],
+                                word->wlen - word_idx - llen);
+                    }
+                }
+
+                /**
+                 * Write RHS of production rule where LHS is located in the
+                 * word.
+                 */
+                if (rlen > 0)
+                {
+                    memcpy(&word->w[word_idx], prule.r, rlen);
+                    if (word->g != NULL)
+                    {
+                        memset(&word->g[word_idx], gen_rhs, rlen);
+                    }
+                }
+
+                log_dbg("RWR", "%.*s" CLR_TXT(CLR_BLU, "%.*s") "%.*s\n",
+                        word_idx, &word->w[0U], rlen, &word->w[word_idx],
+                        word->wlen - word_idx - rlen,
+                        &word->w[word_idx + rlen]);
+
+                int64_t const word_idx_new = word_idx + wlen_delta;
+                if (word_idx_new < 0 || word_idx_new > UINT32_MAX)
+                {
+                    log_dbg("RWR", "Word index cannot become negative\n");
+                    return 1U;
+                }
+                word_idx =
+                    (uint32_t)(word_idx +
+                               wlen_delta); /* Safe cast due to bound check. */
+                word->wlen = wlen_after;
+                prules_applied++;
+            }
+        }
+        prules_applied_total += prules_applied;
+    }
+    if (prules_applied_total == 0U)
+    {
+        return 1;
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_SYMBOLS, word->wlen);
+    word->gen++;
+    return 0U;
+}
+
+/**
+ * @brief Append a segment, growing the buffer when it's full.
+ * @param segs Where to append the segment.
+ * @param seg Segment to append.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_segs_push(lsystem_segs_st *const segs, lsystem_seg_st const seg)
+{
+    if (segs->count >= segs->cap)
+    {
+        uint32_t const cap_new =
+            segs->cap == 0U ? SEGS_SIZE_INIT : segs->cap * 2U;
+        lsystem_seg_st *const s_new = amiss_arena_realloc(
+            segs->arena, segs->s, segs->cap * sizeof(lsystem_seg_st),
+            cap_new * sizeof(lsystem_seg_st));
+        if (s_new == NULL)
+        {
+            log_err("DRAW", "Failed to realloc segment buffer\n");
+            return 1U;
+        }
+        segs->s = s_new;
+        segs->cap = cap_new;
+    }
+    segs->s[segs->count++] = seg;
+    return 0U;
+}
+
+/**
+ * @brief Interpret a word generated using an L-System (F,+,-,[,]) as turtle
+ * commands and collect the segments it traces.
+ * @param word The word to interpret.
+ * @param draw_params How to draw the word.
+ * @param segs Where the segments get appended. On failure it holds the segments
+ * traced up to the point of failure. Turtle stacks are allocated from its arena
+ * too.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_interpret(lsystem_vword_st const word,
+                          lsystem_draw_params_st const draw_params,
+                          lsystem_segs_st *const segs)
+{
+    PROF_SCOPE("lsystem_interpret");
+    uint64_t const t_begin = amiss_stage_now();
+    uint32_t const stack_size = 1024U;
+    double_t const line_width = draw_params.line_width_min;
+    double_t const line_len = draw_params.line_len;
+    double_t const angle_delta = draw_params.angle_delta;
+    /**
+     * Step of the last F. Runs of F share their angle, as F stretches write
+     * them, so the step is only worked out again when the angle changes.
+     */
+    double_t step_angle = NAN;
+    int64_t step_x = 0;
+    int64_t step_y = 0;
+    vec2u32_st *pos_stack =
+        amiss_arena_alloc(segs->arena, stack_size * sizeof(vec2u32_st));
+    double_t *angle_stack =
+        amiss_arena_alloc(segs->arena, stack_size * sizeof(double_t));
+    double_t *width_delta_stack =
+        amiss_arena_alloc(segs->arena, stack_size * sizeof(double_t));
+    uint32_t sp = 0U;
+    uint8_t ret = 0U;
+
+    if (pos_stack == NULL || angle_stack == NULL || width_delta_stack == NULL)
+    {
+        log_err("DRAW", "Failed to allocate stacks\n");
+        amiss_stage_end(AMISS_STAGE_INTERPRET, t_begin);
+        return 1U;
+    }
+
+    pos_stack[0U].x = draw_params.x_start;
+    pos_stack[0U].y = draw_params.y_start;
+    angle_stack[0U] = 180.0 + 90.0 + draw_params.angle_start; /* Degrees. */
+    width_delta_stack[0U] = draw_params.line_width_start;
+
+    for (uint32_t word_idx = 0; word_idx < word.wlen && ret == 0U; ++word_idx)
+    {
+        switch (word.w[word_idx])
+        {
+        case 'F': {
+            vec2u32_st const start = {.x = pos_stack[sp].x,
+                                      .y = pos_stack[sp].y};
+            if (angle_stack[sp] != step_angle)
+            {
+                step_angle = angle_stack[sp];
+                step_x = llround(cos(step_angle * (M_PI / 180.0)) * line_len);
+                step_y = llround(sin(step_angle * (M_PI / 180.0)) * line_len);
+            }
+            int64_t endx = pos_stack[sp].x + step_x;
+            int64_t endy = pos_stack[sp].y + step_y;
+            if (endx < 0)
+            {
+                endx = 0;
+            }
+            if (endy < 0)
+            {
+                endy = 0;
+            }
+            vec2u32_st const end = {
+                .x = (uint32_t)endx,
+                .y = (uint32_t)endy}; /* Safe cast thanks to bound checks. */
+
+            if (lsystem_segs_push(
+                    segs, (lsystem_seg_st){
+                              .start = start,
+                              .end = end,
+                              .width = width_delta_stack[sp] > line_width
+                                           ? width_delta_stack[sp]
+                                           : line_width,
+                              .gen = word.g == NULL ? word.gen
+                                                    : word.g[word_idx],
+                          }) != 0U)
+            {
+                ret = 1U;
+                break;
+            }
+
+            width_delta_stack[sp] -= draw_params.line_width_delta;
+            pos_stack[sp].x = end.x;
+            pos_stack[sp].y = end.y;
+            break;
+        }
+        case '+': {
+            angle_stack[sp] = fmod(angle_stack[sp] + angle_delta, 365.0);
+            break;
+        }
+        case '-': {
+            double_t const angle_next = angle_stack[sp] - angle_delta;
+            angle_stack[sp] =
+                angle_next < 0.0 ? 365.0 - angle_next : angle_next;
+            break;
+        }
+        case '[': {
+            if (sp + 1U >= stack_size)
+            {
+                log_err("DRAW", "Stack too small\n");
+                ret = 1U;
+                break;
+            }
+            memcpy(&pos_stack[sp + 1U], &pos_stack[sp], sizeof(pos_stack[0U]));
+            memcpy(&angle_stack[sp + 1U], &angle_stack[sp],
+                   sizeof(angle_stack[0U]));
+            memcpy(&width_delta_stack[sp + 1U], &width_delta_stack[sp],
+                   sizeof(width_delta_stack[0U]));
+            sp += 1;
+            break;
+        }
+        case ']': {
+            if ((int64_t)sp - 1 < 0)
+            {
+                log_err("DRAW", "Stack too small\n");
+                ret = 1U;
+                break;
+            }
+            sp -= 1;
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+    amiss_stage_end(AMISS_STAGE_INTERPRET, t_begin);
+    return ret;
+}
+
+/**
+ * @brief Draw a word generated using an L-System (F,+,-,[,]).
+ * @param word The word to draw.
+ * @param draw_params How to draw the word.
+ * @param backend Canvas to draw the word on.
+ * @param arena Where the segments and turtle stacks are allocated from. The
+ * word is only read so it can be shared by several draws at once.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_draw(lsystem_vword_st const word,
+                     lsystem_draw_params_st const draw_params,
+                     amiss_backend_st *const backend,
+                     amiss_arena_st *const arena)
+{
+    lsystem_segs_st segs = {
+        .cap = 0U, .count = 0U, .s = NULL, .arena = arena};
+    uint8_t const ret = lsystem_interpret(word, draw_params, &segs);
+    segs_draw(segs.s, 0U, segs.count, draw_params, backend);
+    return ret;
+}
+
+/**
+ * @brief Generate the word of an L-system by rewriting its axiom.
+ * @param ls The L-system to use.
+ * @param word Where the generated word is stored.
+ * @param arena Where the word is allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_expand(lsystem_st const ls, lsystem_vword_st *const word,
+                       amiss_arena_st *const arena)
+{
+    PROF_SCOPE("lsystem_expand");
+    *word = (lsystem_vword_st){.w = amiss_arena_alloc(arena, WLEN_SIZE_INIT),
+                               .wlen = ls.axiom.wlen,
+                               .blen = WLEN_SIZE_INIT,
+                               .g = NULL,
+                               .gen = 0U,
+                               .arena = arena};
+    if (word->w == NULL)
+    {
+        log_err("MAIN", "Failed to allocate word\n");
+        return 1U;
+    }
+    memcpy(word->w, ls.axiom.w, ls.axiom.wlen);
+
+    uint64_t const t_expand = amiss_stage_now();
+    uint32_t const iter_max = ls.iters;
+    for (uint32_t iter = 0U; iter <= iter_max + 1; ++iter)
+    {
+        /* Do something with intermediate word. */
+        log_info("MAIN", "[%u] '%.*s'\n\n", iter, word->wlen, word->w);
+        if (iter + 1 > iter_max + 1)
+        {
+            break;
+        }
+
+        int ret = lsystem_rewrite(ls, word);
+        if (ret > 0)
+        {
+            log_info("MAIN", "No more rules can be applied\n");
+            break;
+        }
+        else if (ret < 0)
+        {
+            log_err("MAIN", "An error occurred\n");
+            return 1U;
+        }
+    }
+    amiss_stage_end(AMISS_STAGE_EXPAND, t_expand);
+    return 0U;
+}
+
+/**
+ * @brief Draw a generated word on a fresh canvas and save it.
+ * @param word The word to draw, it's only read.
+ * @param draw_params How to draw the word.
+ * @param backend Backend to draw with.
+ * @param path_prefix Where to save the drawn word, the file extension of the
+ * backend gets appended to it.
+ * @param arena Where the image and scratch buffers are allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_render(lsystem_vword_st const word,
+                       lsystem_draw_params_st const draw_params,
+                       amiss_backend_kind_et const backend,
+                       char const *const path_prefix,
+                       amiss_arena_st *const arena)
+{
+    PROF_SCOPE("lsystem_render");
+    lsystem_segs_st segs = {.cap = 0U, .count = 0U, .s = NULL, .arena = arena};
+    uint8_t const ret = lsystem_interpret(word, draw_params, &segs);
+    if (lsystem_render_segs(&segs, draw_params, backend, path_prefix, arena) !=
+        0U)
+    {
+        return 1U;
+    }
+    return ret;
+}
+
+/**
+ * @brief Draw segments on a fresh canvas and save it.
+ * @param segs Segments to draw.
+ * @param draw_params How to draw the segments.
+ * @param backend Backend to draw with.
+ * @param path_prefix Where to save the drawing, the file extension of the
+ * backend gets appended to it.
+ * @param arena Where the image is allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_render_segs(lsystem_segs_st const *const segs,
+                            lsystem_draw_params_st const draw_params,
+                            amiss_backend_kind_et const backend,
+                            char const *const path_prefix,
+                            amiss_arena_st *const arena)
+{
+    lsystem_canvas_st canvas;
+    if (canvas_create(&canvas, backend, &draw_params, false, IMG_SIZE,
+                      arena) != 0U)
+    {
+        return 1U;
+    }
+    segs_draw(segs->s, 0U, segs->count, draw_params, &canvas.backend);
+    uint8_t const ret = canvas_save(&canvas, path_prefix, -1);
+    log_info("MAIN", "%s: %llu lines drawn by the %s backend\n", path_prefix,
+             (unsigned long long)canvas.backend.stats.lines,
+             canvas.backend.ops->name);
+    amiss_backend_destroy(&canvas.backend);
+    return ret;
+}
+
+/**
+ * @brief Draw close-ups of a generated word and save each of them. The word is
+ * interpreted once and its segments indexed in a grid, so every view only
+ * goes through the segments overlapping it.
+ * @param word The word to draw, it's only read.
+ * @param draw_params How to draw the word.
+ * @param backend Backend to draw with.
+ * @param path_prefix Start of the path of each view, _view, the index of the
+ * view and the file extension of the backend get appended to it.
+ * @param views Parts of the scene to draw, each scaled to fill the canvas.
+ * @param view_count Number of views.
+ * @param arena Where the image, segments and grid are allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_render_views(lsystem_vword_st const word,
+                             lsystem_draw_params_st const draw_params,
+                             amiss_backend_kind_et const backend,
+                             char const *const path_prefix,
+                             amiss_box_st const *const views,
+                             uint32_t const view_count,
+                             amiss_arena_st *const arena)
+{
+    PROF_SCOPE("lsystem_render_views");
+    lsystem_canvas_st canvas;
+    if (canvas_create(&canvas, backend, &draw_params, view_count > 1U,
+                      IMG_SIZE, arena) != 0U)
+    {
+        return 1U;
+    }
+    lsystem_segs_st segs = {.cap = 0U, .count = 0U, .s = NULL, .arena = arena};
+    if (lsystem_interpret(word, draw_params, &segs) != 0U)
+    {
+        amiss_backend_destroy(&canvas.backend);
+        return 1U;
+    }
+
+    uint64_t const t_index = amiss_stage_now();
+    amiss_box_st *const boxes =
+        amiss_arena_alloc(arena, (segs.count + 1U) * sizeof(boxes[0U]));
+    uint32_t *const ids =
+        amiss_arena_alloc(arena, (segs.count + 1U) * sizeof(ids[0U]));
+    if (boxes == NULL || ids == NULL)
+    {
+        log_err("MAIN", "Failed to allocate segment index\n");
+        amiss_backend_destroy(&canvas.backend);
+        return 1U;
+    }
+    for (uint32_t seg_idx = 0U; seg_idx < segs.count; ++seg_idx)
+    {
+        lsystem_seg_st const *const seg = &segs.s[seg_idx];
+        boxes[seg_idx] = (amiss_box_st){
+            .x0 = seg->start.x < seg->end.x ? seg->start.x : seg->end.x,
+            .y0 = seg->start.y < seg->end.y ? seg->start.y : seg->end.y,
+            .x1 = seg->start.x < seg->end.x ? seg->end.x : seg->start.x,
+            .y1 = seg->start.y < seg->end.y ? seg->end.y : seg->start.y,
+        };
+    }
+    amiss_grid_st grid;
+    int const grid_ret = amiss_grid_build(&grid, arena, boxes, segs.count);
+    amiss_stage_end(AMISS_STAGE_INTERPRET, t_index);
+    if (grid_ret != 0)
+    {
+        amiss_backend_destroy(&canvas.backend);
+        return 1U;
+    }
+
+    uint8_t ret = 0U;
+    for (uint32_t view_idx = 0U; view_idx < view_count && ret == 0U;
+         ++view_idx)
+    {
+        if (view_idx > 0U)
+        {
+            canvas_clear(&canvas);
+        }
+        uint32_t const id_count = amiss_grid_query(&grid, views[view_idx], ids);
+        segs_draw_view(segs.s, ids, id_count, views[view_idx], draw_params,
+                       &canvas.backend);
+        char path_view[512U];
+        int const path_len = snprintf(path_view, sizeof(path_view),
+                                      "%s_view%02u", path_prefix, view_idx);
+        if (path_len < 0 || (uint32_t)path_len >= sizeof(path_view))
+        {
+            log_err("MAIN", "Output path is too long\n");
+            ret = 1U;
+            break;
+        }
+        ret = canvas_save(&canvas, path_view, -1);
+        log_info("MAIN", "%s: %u of %u segments in view\n", path_view,
+                 id_count, segs.count);
+    }
+    amiss_backend_destroy(&canvas.backend);
+    return ret;
+}
+
+/**
+ * @brief Generate a word using an L-system definition and draw it according to
+ * drawing params.
+ * @param ls The L-system to use.
+ * @param draw_params How to draw the word after it is generated.
+ * @param backend Backend to draw with.
+ * @param path_prefix Where to save the drawn word, the file extension of the
+ * backend gets appended to it.
+ * @param arena Where the image, word and scratch buffers are allocated from.
+ * Everything stays allocated until the caller resets the arena.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_gen(lsystem_st const ls,
+                    lsystem_draw_params_st const draw_params,
+                    amiss_backend_kind_et const backend,
+                    char const *const path_prefix, amiss_arena_st *const arena)
+{
+    PROF_SCOPE("lsystem_gen");
+    lsystem_vword_st word;
+    if (lsystem_expand(ls, &word, arena) != 0U)
+    {
+        return 1U;
+    }
+    return lsystem_render(word, draw_params, backend, path_prefix, arena);
+}
+
+/**
+ * @brief Generate a word using an L-system definition and draw every iteration
+ * of it as a separate frame.
+ *
+ * When the L-system grows in place (see lsystem_grows_in_place), only the last
+ * word is interpreted and its segments are drawn generation by generation on
+ * the same canvas, so each frame only draws what the iteration added. Drawing
+ * all frames then costs about as much as drawing the last one. The line length
+ * in the draw params is the one of the last iteration, earlier frames show the
+ * same geometry as if the line length was scaled up with each F stretch.
+ * Other L-systems have each frame drawn from scratch.
+ * @param ls The L-system to use.
+ * @param draw_params How to draw the words.
+ * @param backend Backend to draw with.
+ * @param path_prefix Start of the path of each frame, the frame index and file
+ * extension of the backend get appended to it.
+ * @param arena Where the image, words and scratch buffers are allocated from.
+ * Everything stays allocated until the caller resets the arena.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_gen_frames(lsystem_st const ls,
+                           lsystem_draw_params_st const draw_params,
+                           amiss_backend_kind_et const backend,
+                           char const *const path_prefix,
+                           amiss_arena_st *const arena)
+{
+    PROF_SCOPE("lsystem_gen_frames");
+    bool const in_place = lsystem_grows_in_place(ls);
+    log_info("MAIN", "Drawing frames %s\n",
+             in_place == true ? "incrementally" : "from scratch");
+
+    lsystem_canvas_st canvas;
+    if (canvas_create(&canvas, backend, &draw_params, !in_place, IMG_SIZE,
+                      arena) != 0U)
+    {
+        return 1U;
+    }
+
+    lsystem_segs_st segs = {.cap = 0U, .count = 0U, .s = NULL, .arena = arena};
+    lsystem_vword_st word = {
+        .w = amiss_arena_alloc(arena, WLEN_SIZE_INIT),
+        .wlen = ls.axiom.wlen,
+        .blen = WLEN_SIZE_INIT,
+        .g = in_place == true ? amiss_arena_alloc(arena, WLEN_SIZE_INIT) : NULL,
+        .gen = 0U,
+        .arena = arena};
+    if (word.w == NULL || (in_place == true && word.g == NULL))
+    {
+        log_err("MAIN", "Failed to allocate word\n");
+        amiss_backend_destroy(&canvas.backend);
+        return 1U;
+    }
+    memcpy(word.w, ls.axiom.w, ls.axiom.wlen);
+    if (word.g != NULL)
+    {
+        memset(word.g, 0U, ls.axiom.wlen);
+    }
+
+    uint32_t const iter_max = ls.iters;
+    for (uint32_t iter = 0U; iter <= iter_max + 1; ++iter)
+    {
+        if (in_place == false)
+        {
+            /* Old geometry may move, draw the whole word again. */
+            canvas_clear(&canvas);
+            segs.count = 0U;
+            if (lsystem_interpret(word, draw_params, &segs) != 0U)
+            {
+                log_err("MAIN", "Failed to interpret frame %u\n", word.gen);
+                amiss_backend_destroy(&canvas.backend);
+                return 1U;
+            }
+            segs_draw(segs.s, 0U, segs.count, draw_params, &canvas.backend);
+            if (canvas_save(&canvas, path_prefix, word.gen) != 0U)
+            {
+                amiss_backend_destroy(&canvas.backend);
+                return 1U;
+            }
+        }
+        if (iter + 1 > iter_max + 1)
+        {
+            break;
+        }
+
+        uint64_t const t_expand = amiss_stage_now();
+        uint8_t const ret = lsystem_rewrite(ls, &word);
+        amiss_stage_end(AMISS_STAGE_EXPAND, t_expand);
+        if (ret > 0)
+        {
+            log_info("MAIN", "No more rules can be applied\n");
+            break;
+        }
+    }
+
+    if (in_place == true)
+    {
+        /* Sort segments by generation so each frame draws a single run. */
+        if (lsystem_interpret(word, draw_params, &segs) != 0U)
+        {
+            log_err("MAIN", "Failed to interpret frames\n");
+            amiss_backend_destroy(&canvas.backend);
+            return 1U;
+        }
+        uint32_t gen_first[UINT8_MAX + 2U] = {0U};
+        for (uint32_t seg_idx = 0U; seg_idx < segs.count; ++seg_idx)
+        {
+            gen_first[segs.s[seg_idx].gen + 1U]++;
+        }
+        for (uint32_t gen = 1U; gen < UINT8_MAX + 2U; ++gen)
+        {
+            gen_first[gen] += gen_first[gen - 1U];
+        }
+        lsystem_seg_st *const segs_sorted = amiss_arena_alloc(
+            arena, (segs.count + 1U) * sizeof(lsystem_seg_st));
+        if (segs_sorted == NULL)
+        {
+            log_err("MAIN", "Failed to allocate sorted segments\n");
+            amiss_backend_destroy(&canvas.backend);
+            return 1U;
+        }
+        uint32_t gen_next[UINT8_MAX + 1U];
+        memcpy(gen_next, gen_first, sizeof(gen_next));
+        for (uint32_t seg_idx = 0U; seg_idx < segs.count; ++seg_idx)
+        {
+            segs_sorted[gen_next[segs.s[seg_idx].gen]++] = segs.s[seg_idx];
+        }
+
+        for (uint32_t gen = 0U; gen <= word.gen; ++gen)
+        {
+            segs_draw(segs_sorted, gen_first[gen],
+                      gen_first[gen + 1U] - gen_first[gen], draw_params,
+                      &canvas.backend);
+            if (canvas_save(&canvas, path_prefix, (int32_t)gen) != 0U)
+            {
+                amiss_backend_destroy(&canvas.backend);
+                return 1U;
+            }
+        }
+    }
+
+    amiss_backend_destroy(&canvas.backend);
+    return 0U;
+}
+
+/* A word generated once and drawn by every job using the same L-system. */
+typedef struct lsystem_expansion_s
+{
+    lsystem_st const *ls;
+    lsystem_vword_st word;
+    amiss_arena_st arena; /* Holds the word until its last job is done. */
+    /* Memory of the word, held against the budget of the pool meanwhile. */
+    size_t mem;
+    atomic_uint users; /* Jobs left to draw the word. */
+    amiss_job_pool_st *pool;
+} lsystem_expansion_st;
+
+typedef struct lsystem_batch_arg_s
+{
+    lsystem_job_st const *job;
+    /* NULL for frame jobs and parametric L-systems. */
+    lsystem_expansion_st *expansion;
+} lsystem_batch_arg_st;
+
+/**
+ * @brief Check if two L-systems generate the same word. Only definitions
+ * sharing their rules and axiom are considered equal, comparing the strings is
+ * not worth it.
+ */
+static bool ls_same(lsystem_st const *const a, lsystem_st const *const b)
+{
+    return a->pr == b->pr && a->pr_count == b->pr_count &&
+           a->axiom.w == b->axiom.w && a->axiom.wlen == b->axiom.wlen &&
+           a->iters == b->iters;
+}
+
+/**
+ * @brief Estimate the length of the word an L-system generates without
+ * generating it, by counting how many of every symbol each rewrite makes.
+ * Rules apply as in lsystem_rewrite, cascades included, but rules whose LHS
+ * has several symbols are left out so the estimate is rough for those.
+ * @param ls The L-system.
+ * @return Estimated length of the word, at most UINT32_MAX.
+ */
+static uint32_t ls_wlen_estimate(lsystem_st const *const ls)
+{
+    double_t counts[2U][UINT8_MAX + 1U] = {{0.0}};
+    for (uint32_t w_idx = 0U; w_idx < ls->axiom.wlen; ++w_idx)
+    {
+        counts[0U][(uint8_t)ls->axiom.w[w_idx]] += 1.0;
+    }
+    /* Like lsystem_expand, the axiom is rewritten once more than iters. */
+    uint32_t const rewrites = ls->iters + 1U;
+    for (uint32_t iter = 0U; iter < rewrites; ++iter)
+    {
+        double_t const *const cur = counts[iter % 2U];
+        double_t *const next = counts[(iter + 1U) % 2U];
+        memset(next, 0, sizeof(counts[0U]));
+        for (uint32_t sym_first = 0U; sym_first <= UINT8_MAX; ++sym_first)
+        {
+            if (cur[sym_first] == 0.0)
+            {
+                continue;
+            }
+            /**
+             * The rules after the one applied go on with the last symbol it
+             * wrote, which is only counted once no rule is left.
+             */
+            uint8_t sym = (uint8_t)sym_first;
+            bool erased = false;
+            for (uint32_t prule_idx = 0U;
+                 prule_idx < ls->pr_count && erased == false; ++prule_idx)
+            {
+                lsystem_prule_st const prule = (*ls->pr)[prule_idx];
+                if ((uint8_t)prule.l[0U] != sym || prule.l[1U] != '\0')
+                {
+                    continue;
+                }
+                size_t const rlen = strlen(prule.r);
+                erased = rlen == 0U;
+                for (size_t r_idx = 0U; r_idx + 1U < rlen; ++r_idx)
+                {
+                    next[(uint8_t)prule.r[r_idx]] += cur[sym_first];
+                }
+                sym = rlen > 0U ? (uint8_t)prule.r[rlen - 1U] : sym;
+            }
+            if (erased == false)
+            {
+                next[sym] += cur[sym_first];
+            }
+        }
+    }
+    double_t wlen = 0.0;
+    for (uint32_t sym = 0U; sym <= UINT8_MAX; ++sym)
+    {
+        wlen += counts[rewrites % 2U][sym];
+    }
+    return wlen < UINT32_MAX ? (uint32_t)wlen : UINT32_MAX;
+}
+
+/**
+ * @brief Estimate the most memory growing a word takes. Its buffers grow by
+ * WLEN_SIZE_GROWTH and may be copied when they can't grow in place.
+ * @param wlen Length of the word.
+ * @param gens Whether the generation of every symbol is kept too.
+ * @return Estimate in bytes.
+ */
+static size_t word_mem(uint32_t const wlen, bool const gens)
+{
+    uint32_t const blen_min = wlen > WLEN_SIZE_INIT ? wlen : WLEN_SIZE_INIT;
+    size_t const blen = (size_t)blen_min * WLEN_SIZE_GROWTH * 2U /* Copy */;
+    return gens == true ? blen * 2U : blen;
+}
+
+/**
+ * @brief Estimate the most memory drawing a word takes: the canvas, twice the
+ * segments (the buffer grows by doubling) and the turtle stacks.
+ * @param backend Backend drawing the word.
+ * @param wlen Length of the word, 0 if not known yet.
+ * @return Estimate in bytes.
+ */
+static size_t render_mem(amiss_backend_kind_et const backend,
+                         uint32_t const wlen)
+{
+    return amiss_backend_mem(backend, IMG_SIZE, IMG_SIZE) +
+           ((size_t)wlen * 2U * sizeof(lsystem_seg_st)) +
+           (1024U * (sizeof(vec2u32_st) + (2U * sizeof(double_t))));
+}
+
+/**
+ * @brief Estimate the most memory drawing views of a word takes: a render,
+ * the copy of the background and the grid, whose boxes are listed in at most
+ * 4 cells each and whose cells hold about 2 boxes.
+ * @param backend Backend drawing the word.
+ * @param wlen Length of the word.
+ * @return Estimate in bytes.
+ */
+static size_t render_views_mem(amiss_backend_kind_et const backend,
+                               uint32_t const wlen)
+{
+    return render_mem(backend, wlen) +
+           amiss_backend_mem(backend, IMG_SIZE, IMG_SIZE) +
+           ((size_t)wlen * (sizeof(amiss_box_st) + (6U * sizeof(uint32_t))));
+}
+
+/**
+ * @brief Estimate the most memory drawing the frames of an L-system takes: a
+ * render, the copy of the background, the word with its generations and the
+ * segments sorted by generation.
+ * @param backend Backend drawing the frames.
+ * @param ls The L-system.
+ * @return Estimate in bytes.
+ */
+static size_t frames_mem(amiss_backend_kind_et const backend,
+                         lsystem_st const *const ls)
+{
+    uint32_t const wlen = ls_wlen_estimate(ls);
+    return render_mem(backend, wlen) +
+           amiss_backend_mem(backend, IMG_SIZE, IMG_SIZE) +
+           word_mem(wlen, true) + ((size_t)wlen * sizeof(lsystem_seg_st));
+}
+
+/**
+ * @brief Bound the most memory drawing a parametric L-system takes: a render
+ * and the two words it rewrites between, whose arrays are allocated anew as
+ * they grow.
+ * @param backend Backend drawing the word.
+ * @param ls The parametric L-system.
+ * @return Estimate in bytes.
+ */
+static size_t param_mem(amiss_backend_kind_et const backend,
+                        plsystem_st const *const ls)
+{
+    uint32_t const len = plsystem_len_bound(*ls);
+    size_t const module_len =
+        sizeof(char) + sizeof(uint8_t) + (PLSYSTEM_PARAM_MAX * sizeof(float));
+    return render_mem(backend, len) +
+           ((size_t)(len > WLEN_SIZE_INIT ? len : WLEN_SIZE_INIT) *
+            module_len * WLEN_SIZE_GROWTH * 2U /* Words */ * 2U /* Copies */);
+}
+
+static int batch_expand(void *const arg, amiss_arena_st *const arena)
+{
+    lsystem_expansion_st *const expansion = arg;
+    return lsystem_expand(*expansion->ls, &expansion->word,
+                          &expansion->arena);
+}
+
+/**
+ * @brief Let go of an expansion once its last job is done with it: free the
+ * word and give its memory back to the pool.
+ * @param expansion Expansion a job is done with.
+ */
+static void expansion_done(lsystem_expansion_st *const expansion)
+{
+    if (atomic_fetch_sub(&expansion->users, 1U) == 1U)
+    {
+        amiss_arena_free(&expansion->arena);
+        amiss_job_pool_release(expansion->pool, expansion->mem);
+    }
+}
+
+static int batch_render(void *const arg, amiss_arena_st *const arena)
+{
+    lsystem_batch_arg_st const *const batch_arg = arg;
+    int const ret =
+        batch_arg->job->view_count > 0U
+            ? lsystem_render_views(
+                  batch_arg->expansion->word, *batch_arg->job->draw_params,
+                  batch_arg->job->backend, batch_arg->job->path_prefix,
+                  batch_arg->job->views, batch_arg->job->view_count, arena)
+            : lsystem_render(batch_arg->expansion->word,
+                             *batch_arg->job->draw_params,
+                             batch_arg->job->backend,
+                             batch_arg->job->path_prefix, arena);
+    expansion_done(batch_arg->expansion);
+    return ret;
+}
+
+static int batch_param(void *const arg, amiss_arena_st *const arena)
+{
+    lsystem_batch_arg_st const *const batch_arg = arg;
+    return plsystem_gen(*batch_arg->job->pls, *batch_arg->job->draw_params,
+                        batch_arg->job->backend, batch_arg->job->path_prefix,
+                        arena);
+}
+
+static int batch_frames(void *const arg, amiss_arena_st *const arena)
+{
+    lsystem_batch_arg_st const *const batch_arg = arg;
+    return lsystem_gen_frames(*batch_arg->job->ls,
+                              *batch_arg->job->draw_params,
+                              batch_arg->job->backend,
+                              batch_arg->job->path_prefix, arena);
+}
+
+/**
+ * @brief Generate many images concurrently. Words are expanded once per
+ * distinct L-system, then every job draws its word in parallel. Frame jobs
+ * and parametric L-systems grow their word themselves so they don't share it.
+ * Every job declares its word and segments to the budget of the pool, and an
+ * expanded word stays held against the budget until its last job is done. So
+ * words don't pile up, they are expanded in rounds whose estimated words fit
+ * in the budget together, each round drawn before the next is expanded.
+ * @param jobs Images to generate.
+ * @param job_count Number of jobs.
+ * @param pool Pool to run the jobs on, its memory budget bounds how many
+ * words are held and how many images are drawn at once.
+ * @param arena Where the bookkeeping of the batch is allocated from.
+ * @return 0 if all jobs succeeded, 1 if any failed.
+ */
+uint8_t lsystem_gen_batch(lsystem_job_st const *const jobs,
+                          uint32_t const job_count,
+                          amiss_job_pool_st *const pool,
+                          amiss_arena_st *const arena)
+{
+    PROF_SCOPE("lsystem_gen_batch");
+    lsystem_expansion_st *const expansions =
+        amiss_arena_alloc(arena, job_count * sizeof(expansions[0U]));
+    lsystem_batch_arg_st *const args =
+        amiss_arena_alloc(arena, job_count * sizeof(args[0U]));
+    amiss_job_st *const expand_jobs =
+        amiss_arena_alloc(arena, job_count * sizeof(expand_jobs[0U]));
+    amiss_job_st *const pool_jobs =
+        amiss_arena_alloc(arena, job_count * sizeof(pool_jobs[0U]));
+    if (expansions == NULL || args == NULL || expand_jobs == NULL ||
+        pool_jobs == NULL)
+    {
+        log_err("MAIN", "Failed to allocate batch\n");
+        return 1U;
+    }
+
+    /* Find the distinct L-systems. */
+    uint8_t ret = 0U;
+    uint32_t expansion_count = 0U;
+    for (uint32_t job_idx = 0U; job_idx < job_count && ret == 0U; ++job_idx)
+    {
+        args[job_idx] = (lsystem_batch_arg_st){.job = &jobs[job_idx],
+                                               .expansion = NULL};
+        if (jobs[job_idx].frames == true || jobs[job_idx].pls != NULL)
+        {
+            continue;
+        }
+        uint32_t expansion_idx = 0U;
+        while (expansion_idx < expansion_count &&
+               ls_same(expansions[expansion_idx].ls, jobs[job_idx].ls) ==
+                   false)
+        {
+            expansion_idx++;
+        }
+        lsystem_expansion_st *const expansion = &expansions[expansion_idx];
+        if (expansion_idx == expansion_count)
+        {
+            expansion->ls = jobs[job_idx].ls;
+            expansion->mem = 0U;
+            atomic_init(&expansion->users, 0U);
+            expansion->pool = pool;
+            if (amiss_arena_init(&expansion->arena, arena->chunk_size,
+                                 AMISS_ARENA_FLAG_NONE) != 0)
+            {
+                ret = 1U;
+                break;
+            }
+            expand_jobs[expansion_idx] = (amiss_job_st){
+                .fn = batch_expand,
+                .arg = expansion,
+                .mem = word_mem(ls_wlen_estimate(expansion->ls), false),
+                .ret = 0,
+            };
+            expansion_count++;
+        }
+        atomic_fetch_add(&expansion->users, 1U);
+        args[job_idx].expansion = expansion;
+    }
+    log_info("MAIN", "%u jobs share %u expansions\n", job_count,
+             expansion_count);
+
+    /**
+     * Jobs growing their own word are drawn along with the first round. A
+     * failed drawing doesn't keep the next rounds from being drawn, a failed
+     * expansion does.
+     */
+    uint32_t round_first = ret == 0U ? 0U : expansion_count;
+    bool round_own = ret == 0U;
+    while (round_first < expansion_count || round_own == true)
+    {
+        uint32_t round_end = round_first;
+        size_t round_mem = 0U;
+        while (round_end < expansion_count &&
+               (round_end == round_first || pool->mem_budget == 0U ||
+                round_mem + expand_jobs[round_end].mem <= pool->mem_budget))
+        {
+            round_mem += expand_jobs[round_end++].mem;
+        }
+        if (round_end > round_first &&
+            amiss_job_pool_run(pool, &expand_jobs[round_first],
+                               round_end - round_first) != 0)
+        {
+            ret = 1U;
+            break;
+        }
+        for (uint32_t expansion_idx = round_first; expansion_idx < round_end;
+             ++expansion_idx)
+        {
+            lsystem_expansion_st *const expansion = &expansions[expansion_idx];
+            expansion->mem = expansion->word.blen;
+            amiss_job_pool_hold(pool, expansion->mem);
+        }
+
+        uint32_t pool_job_count = 0U;
+        for (uint32_t job_idx = 0U; job_idx < job_count; ++job_idx)
+        {
+            lsystem_expansion_st const *const expansion =
+                args[job_idx].expansion;
+            if (expansion == NULL ? round_own == false
+                                  : expansion < &expansions[round_first] ||
+                                        expansion >= &expansions[round_end])
+            {
+                continue;
+            }
+            amiss_backend_kind_et const backend = jobs[job_idx].backend;
+            amiss_job_st *const pool_job = &pool_jobs[pool_job_count++];
+            *pool_job = (amiss_job_st){
+                .fn = batch_render, .arg = &args[job_idx], .mem = 0U, .ret = 0};
+            if (jobs[job_idx].pls != NULL)
+            {
+                pool_job->fn = batch_param;
+                pool_job->mem = param_mem(backend, jobs[job_idx].pls);
+            }
+            else if (expansion == NULL)
+            {
+                pool_job->fn = batch_frames;
+                pool_job->mem = frames_mem(backend, jobs[job_idx].ls);
+            }
+            else if (jobs[job_idx].view_count > 0U)
+            {
+                pool_job->mem = render_views_mem(backend, expansion->word.wlen);
+            }
+            else
+            {
+                pool_job->mem = render_mem(backend, expansion->word.wlen);
+            }
+        }
+        if (amiss_job_pool_run(pool, pool_jobs, pool_job_count) != 0)
+        {
+            ret = 1U;
+        }
+
+        /* Words whose jobs didn't all run are let go of here. */
+        for (uint32_t expansion_idx = round_first; expansion_idx < round_end;
+             ++expansion_idx)
+        {
+            lsystem_expansion_st *const expansion = &expansions[expansion_idx];
+            if (atomic_exchange(&expansion->users, 0U) > 0U)
+            {
+                amiss_arena_free(&expansion->arena);
+                amiss_job_pool_release(pool, expansion->mem);
+            }
+        }
+        round_first = round_end;
+        round_own = false;
+    }
+
+    for (uint32_t expansion_idx = 0U; expansion_idx < expansion_count;
+         ++expansion_idx)
+    {
+        amiss_arena_free(&expansions[expansion_idx].arena);
+    }
+    return ret;
+}
+
+/* One pass of a progressive render. */
+typedef struct lsystem_preview_stage_s
+{
+    uint8_t iters_less; /* Iterations fewer than the L-system has. */
+    uint8_t size_div;   /* What the side of the canvas is divided by. */
+} lsystem_preview_stage_st;
+
+/* Passes of a progressive render, coarsest first. The last one is the final. */
+static lsystem_preview_stage_st const preview_stages[] = {
+    {.iters_less = 2U, .size_div = 4U},
+    {.iters_less = 1U, .size_div = 2U},
+    {.iters_less = 0U, .size_div = 1U},
+};
+#define PREVIEW_STAGE_COUNT                                                    \
+    (sizeof(preview_stages) / sizeof(preview_stages[0U]))
+
+typedef struct lsystem_preview_arg_s
+{
+    lsystem_st const *ls;
+    lsystem_draw_params_st const *draw_params;
+    amiss_backend_kind_et backend;
+    char const *path_prefix;
+    amiss_preview_st *preview;
+    uint32_t stage;
+} lsystem_preview_arg_st;
+
+/**
+ * @brief Measure how far segments reach i.e. the longer side of their bounds.
+ * @param segs Segments to measure.
+ * @return The extent, 0 if there are no segments.
+ */
+static double_t segs_extent(lsystem_segs_st const *const segs)
+{
+    if (segs->count == 0U)
+    {
+        return 0.0;
+    }
+    uint32_t min[2U] = {UINT32_MAX, UINT32_MAX};
+    uint32_t max[2U] = {0U, 0U};
+    for (uint32_t seg_idx = 0U; seg_idx < segs->count; ++seg_idx)
+    {
+        vec2u32_st const ends[2U] = {segs->s[seg_idx].start,
+                                     segs->s[seg_idx].end};
+        for (uint32_t end_idx = 0U; end_idx < 2U; ++end_idx)
+        {
+            for (uint32_t axis = 0U; axis < 2U; ++axis)
+            {
+                uint32_t const coord = ends[end_idx].a[axis];
+                min[axis] = coord < min[axis] ? coord : min[axis];
+                max[axis] = coord > max[axis] ? coord : max[axis];
+            }
+        }
+    }
+    uint32_t const w = max[0U] - min[0U];
+    uint32_t const h = max[1U] - min[1U];
+    return w > h ? w : h;
+}
+
+/**
+ * @brief Draw a coarse pass of a progressive render: fewer iterations on a
+ * smaller raster canvas. The line length in the draw params is the one of the
+ * last iteration, so the drawing is scaled up by how much the L-system grew
+ * over the last iteration drawn, once per iteration left out. It's only an
+ * estimate but it keeps the preview about the size of the final image.
+ * @param arg The L-system, draw params, preview and stage.
+ * @param arena Where the canvas, words and segments are allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+static int preview_coarse(void *const arg, amiss_arena_st *const arena)
+{
+    lsystem_preview_arg_st const *const preview_arg = arg;
+    lsystem_st const ls = *preview_arg->ls;
+    lsystem_draw_params_st const draw_params = *preview_arg->draw_params;
+    lsystem_preview_stage_st const stage = preview_stages[preview_arg->stage];
+    if (ls.iters <= stage.iters_less)
+    {
+        return 0; /* Not enough iterations to leave any out. */
+    }
+
+    /* Words before and after the last rewrite, to see how much it grew. */
+    lsystem_st const ls_prev = {.alph = ls.alph,
+                                .axiom = ls.axiom,
+                                /* Safe cast, iters is larger. */
+                                .iters = (uint8_t)(ls.iters -
+                                                   stage.iters_less - 1U),
+                                .pr_count = ls.pr_count,
+                                .pr = ls.pr,
+                                .rewrite = ls.rewrite};
+    lsystem_vword_st word;
+    if (lsystem_expand(ls_prev, &word, arena) != 0U)
+    {
+        return 1;
+    }
+    lsystem_segs_st segs = {.cap = 0U, .count = 0U, .s = NULL, .arena = arena};
+    if (lsystem_interpret(word, draw_params, &segs) != 0U)
+    {
+        log_err("MAIN", "Failed to interpret word\n");
+        return 1;
+    }
+    double_t const extent_prev = segs_extent(&segs);
+    uint64_t const t_expand = amiss_stage_now();
+    uint8_t const rewrite_ret = lsystem_rewrite(ls, &word);
+    amiss_stage_end(AMISS_STAGE_EXPAND, t_expand);
+    if (rewrite_ret != 0U)
+    {
+        log_err("MAIN", "Failed to rewrite word\n");
+        return 1;
+    }
+    segs.count = 0U;
+    if (lsystem_interpret(word, draw_params, &segs) != 0U)
+    {
+        log_err("MAIN", "Failed to interpret word\n");
+        return 1;
+    }
+    double_t const extent = segs_extent(&segs);
+    double_t const growth =
+        extent_prev > 0.0 && extent > extent_prev ? extent / extent_prev : 1.0;
+    double_t const zoom = pow(growth, stage.iters_less);
+
+    /* The view keeps the start of the turtle where it is on the canvas. */
+    double_t const view_size = IMG_SIZE / zoom;
+    double_t const view_x0 = draw_params.x_start * (1.0 - (1.0 / zoom));
+    double_t const view_y0 = draw_params.y_start * (1.0 - (1.0 / zoom));
+    /* Safe casts, the view is inside of the canvas as zoom is at least 1. */
+    amiss_box_st const view = {
+        .x0 = (uint32_t)lround(view_x0),
+        .y0 = (uint32_t)lround(view_y0),
+        .x1 = (uint32_t)lround(view_x0 + view_size) - 1U,
+        .y1 = (uint32_t)lround(view_y0 + view_size) - 1U,
+    };
+    lsystem_canvas_st canvas;
+    if (canvas_create(&canvas, AMISS_BACKEND_RASTER, &draw_params, false,
+                      IMG_SIZE / stage.size_div, arena) != 0U)
+    {
+        return 1;
+    }
+    segs_draw_view(segs.s, NULL, segs.count, view, draw_params,
+                   &canvas.backend);
+    int const ret = amiss_preview_show(preview_arg->preview,
+                                       &canvas.backend.img, preview_arg->stage);
+    log_info("MAIN", "%s: stage %u, %u iterations at %u px, zoom %.2f\n",
+             preview_arg->path_prefix, preview_arg->stage,
+             ls.iters - stage.iters_less, canvas.backend.w, zoom);
+    amiss_backend_destroy(&canvas.backend);
+    return ret == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Draw the last pass of a progressive render, the same image as
+ * lsystem_gen, save it and show it in the preview when the backend has pixels.
+ * Nothing is saved or shown if the word fails to draw.
+ * @param arg The L-system, draw params, preview and stage.
+ * @param arena Where the canvas, word and segments are allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+static int preview_final(void *const arg, amiss_arena_st *const arena)
+{
+    lsystem_preview_arg_st const *const preview_arg = arg;
+    lsystem_vword_st word;
+    if (lsystem_expand(*preview_arg->ls, &word, arena) != 0U)
+    {
+        return 1;
+    }
+    lsystem_canvas_st canvas;
+    if (canvas_create(&canvas, preview_arg->backend, preview_arg->draw_params,
+                      false, IMG_SIZE, arena) != 0U)
+    {
+        return 1;
+    }
+    /* An incomplete drawing is neither saved nor shown. */
+    uint8_t ret =
+        lsystem_draw(word, *preview_arg->draw_params, &canvas.backend, arena);
+    if (ret == 0U)
+    {
+        ret = canvas_save(&canvas, preview_arg->path_prefix, -1);
+    }
+    if (ret == 0U && canvas.backend.img.b != NULL &&
+        amiss_preview_show(preview_arg->preview, &canvas.backend.img,
+                           preview_arg->stage) != 0)
+    {
+        ret = 1U;
+    }
+    log_info("MAIN", "%s: stage %u, final\n", preview_arg->path_prefix,
+             preview_arg->stage);
+    amiss_backend_destroy(&canvas.backend);
+    return ret;
+}
+
+/**
+ * @brief Render an L-system progressively. A coarse pass with fewer iterations
+ * on a small canvas shows up in the preview file within milliseconds, finer
+ * passes overwrite it as they finish and the last one draws and saves the
+ * same image as lsystem_gen. Passes run on the pool at once, a pass finishing
+ * late never covers a finer one.
+ * @param ls The L-system to use.
+ * @param draw_params How to draw the words.
+ * @param backend Backend drawing the last pass, the others are rasterized.
+ * @param path_prefix Where to save the last pass, the file extension of the
+ * backend gets appended to it. The preview is saved next to it with
+ * _preview.ppm appended instead.
+ * @param pool Pool to run the passes on.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lsystem_gen_preview(lsystem_st const *const ls,
+                            lsystem_draw_params_st const *const draw_params,
+                            amiss_backend_kind_et const backend,
+                            char const *const path_prefix,
+                            amiss_job_pool_st *const pool)
+{
+    PROF_SCOPE("lsystem_gen_preview");
+    char path_preview[512U];
+    int const path_len = snprintf(path_preview, sizeof(path_preview),
+                                  "%s_preview.ppm", path_prefix);
+    if (path_len < 0 || (uint32_t)path_len >= sizeof(path_preview))
+    {
+        log_err("MAIN", "Output path is too long\n");
+        return 1U;
+    }
+    amiss_preview_st preview;
+    if (amiss_preview_open(&preview, path_preview, IMG_SIZE, IMG_SIZE) != 0)
+    {
+        return 1U;
+    }
+
+    /**
+     * Workers take their newest job first, so passes are queued finest first
+     * for the coarse ones to start first even with a single worker.
+     */
+    lsystem_preview_arg_st args[PREVIEW_STAGE_COUNT];
+    amiss_job_st pool_jobs[PREVIEW_STAGE_COUNT];
+    for (uint32_t job_idx = 0U; job_idx < PREVIEW_STAGE_COUNT; ++job_idx)
+    {
+        uint32_t const stage = PREVIEW_STAGE_COUNT - job_idx - 1U;
+        bool const final = stage == PREVIEW_STAGE_COUNT - 1U;
+        args[job_idx] = (lsystem_preview_arg_st){.ls = ls,
+                                                 .draw_params = draw_params,
+                                                 .backend = backend,
+                                                 .path_prefix = path_prefix,
+                                                 .preview = &preview,
+                                                 .stage = stage};
+        pool_jobs[job_idx] = (amiss_job_st){
+            .fn = final == true ? preview_final : preview_coarse,
+            .arg = &args[job_idx],
+            .mem = render_mem(final == true ? backend : AMISS_BACKEND_RASTER,
+                              0U),
+            .ret = 0,
+        };
+    }
+    uint8_t ret = 0U;
+    if (amiss_job_pool_run(pool, pool_jobs, PREVIEW_STAGE_COUNT) != 0)
+    {
+        ret = 1U;
+    }
+    amiss_preview_close(&preview);
+    return ret;
+}
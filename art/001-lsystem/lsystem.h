@@ -0,0 +1,193 @@
+#pragma once
+
+#include "amiss.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * How the rewritten word should grow on overflow. Growing geometrically keeps
+ * the space left behind in the arena by words that can't grow in place small.
+ */
+#define WLEN_SIZE_INIT 1024U
+#define WLEN_SIZE_GROWTH 2U
+
+/* How the segment buffer should grow on overflow. */
+#define SEGS_SIZE_INIT 1024U
+
+/* Size of the image (it's a square). */
+#define IMG_SIZE 1000U
+
+typedef struct lsystem_draw_params_s
+{
+    double_t const angle_delta;
+    double_t const angle_start;
+    double_t const line_width_start;
+    double_t const line_width_delta;
+    double_t const line_width_min;
+    double_t const line_len;
+    uint32_t const x_start;
+    uint32_t const y_start;
+
+    color_st const color_branch;
+    color_st const color_gradient[3];
+} lsystem_draw_params_st;
+
+typedef struct lsystem_prule_s
+{
+    char const *const l;
+    char const *const r;
+} lsystem_prule_st;
+
+typedef struct lsystem_cword_s
+{
+    uint32_t const wlen;
+    char const *const w;
+} lsystem_cword_st;
+
+typedef struct lsystem_vword_s
+{
+    uint32_t blen; /* Length of the allocated buffer. */
+    /**
+     * Length of the word contained in the buffer.
+     * Should be <=blen.
+     */
+    uint32_t wlen;
+    char *w;
+    /**
+     * Generation of every symbol in the word i.e. the rewrite iteration that
+     * produced it, NULL when not tracked. Has the same length as the word.
+     */
+    uint8_t *g;
+    uint8_t gen; /* How many rewrites have been applied to the word. */
+    amiss_arena_st *arena; /* Where the buffers are allocated from. */
+} lsystem_vword_st;
+
+/**
+ * Rewrite of a word specialized to one grammar, generated from its description
+ * by lsysc. It gives the same word as lsystem_rewrite with the rules of the
+ * grammar, without looking the rules up for every symbol.
+ */
+typedef uint8_t lsystem_rewrite_ft(lsystem_vword_st *const word);
+
+typedef struct lsystem_s
+{
+    lsystem_cword_st const alph;
+    lsystem_cword_st const axiom;
+    uint8_t iters;
+
+    /* Production rules. */
+    uint32_t const pr_count;
+    lsystem_prule_st const (*const pr)[];
+    /* Generated rewrite of the rules, NULL to have them interpreted. */
+    lsystem_rewrite_ft *const rewrite;
+} lsystem_st;
+
+/* A line segment traced by the turtle while interpreting a word. */
+typedef struct lsystem_seg_s
+{
+    vec2u32_st start;
+    vec2u32_st end;
+    double_t width;
+    uint8_t gen; /* Generation of the symbol that produced the segment. */
+} lsystem_seg_st;
+
+typedef struct lsystem_segs_s
+{
+    uint32_t cap; /* Number of segments the buffer can hold. */
+    uint32_t count;
+    lsystem_seg_st *s;
+    amiss_arena_st *arena; /* Where the buffer is allocated from. */
+} lsystem_segs_st;
+
+struct plsystem_s;
+
+/* One image generated by a batch. */
+typedef struct lsystem_job_s
+{
+    lsystem_st const *ls;
+    /* Parametric L-system drawn instead of ls when not NULL, see plsystem.h. */
+    struct plsystem_s const *pls;
+    lsystem_draw_params_st const *draw_params;
+    /**
+     * Start of the output path, the file extension of the backend (and the
+     * frame index when drawing frames) get appended to it.
+     */
+    char const *path_prefix;
+    /* Each job picks its own e.g. raster for previews, vector for finals. */
+    amiss_backend_kind_et backend;
+    bool frames; /* Draw every iteration as a separate frame, not for pls. */
+    /**
+     * Close-ups to draw instead of the whole scene, each is scaled to fill the
+     * canvas and saved with _view and its index appended to the path. NULL for
+     * none, frames and pls are always drawn whole.
+     */
+    amiss_box_st const *views;
+    uint32_t view_count;
+} lsystem_job_st;
+
+bool lsystem_prule_check(lsystem_prule_st const prule,
+                         lsystem_vword_st *const word, uint32_t const word_idx);
+
+uint8_t lsystem_word_reserve(lsystem_vword_st *const word, uint32_t const wlen);
+
+uint8_t lsystem_rewrite(lsystem_st const grammar, lsystem_vword_st *const word);
+
+bool lsystem_grows_in_place(lsystem_st const ls);
+
+uint8_t lsystem_segs_push(lsystem_segs_st *const segs,
+                          lsystem_seg_st const seg);
+
+uint8_t lsystem_interpret(lsystem_vword_st const word,
+                          lsystem_draw_params_st const draw_params,
+                          lsystem_segs_st *const segs);
+
+uint8_t lsystem_draw(lsystem_vword_st const word,
+                     lsystem_draw_params_st const draw_params,
+                     amiss_backend_st *const backend,
+                     amiss_arena_st *const arena);
+
+uint8_t lsystem_expand(lsystem_st const ls, lsystem_vword_st *const word,
+                       amiss_arena_st *const arena);
+
+uint8_t lsystem_render(lsystem_vword_st const word,
+                       lsystem_draw_params_st const draw_params,
+                       amiss_backend_kind_et const backend,
+                       char const *const path_prefix,
+                       amiss_arena_st *const arena);
+
+uint8_t lsystem_render_segs(lsystem_segs_st const *const segs,
+                            lsystem_draw_params_st const draw_params,
+                            amiss_backend_kind_et const backend,
+                            char const *const path_prefix,
+                            amiss_arena_st *const arena);
+
+uint8_t lsystem_render_views(lsystem_vword_st const word,
+                             lsystem_draw_params_st const draw_params,
+                             amiss_backend_kind_et const backend,
+                             char const *const path_prefix,
+                             amiss_box_st const *const views,
+                             uint32_t const view_count,
+                             amiss_arena_st *const arena);
+
+uint8_t lsystem_gen(lsystem_st const ls,
+                    lsystem_draw_params_st const draw_params,
+                    amiss_backend_kind_et const backend,
+                    char const *const path_prefix, amiss_arena_st *const arena);
+
+uint8_t lsystem_gen_frames(lsystem_st const ls,
+                           lsystem_draw_params_st const draw_params,
+                           amiss_backend_kind_et const backend,
+                           char const *const path_prefix,
+                           amiss_arena_st *const arena);
+
+uint8_t lsystem_gen_batch(lsystem_job_st const *const jobs,
+                          uint32_t const job_count,
+                          amiss_job_pool_st *const pool,
+                          amiss_arena_st *const arena);
+
+uint8_t lsystem_gen_preview(lsystem_st const *const ls,
+                            lsystem_draw_params_st const *const draw_params,
+                            amiss_backend_kind_et const backend,
+                            char const *const path_prefix,
+                            amiss_job_pool_st *const pool);
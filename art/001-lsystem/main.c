@@ -1,440 +1,178 @@
-#include "amiss.h"
-#include "plutovg.h"
-#include <math.h>
-#include <stdbool.h>
+#include "grammars.h"
+#include "lsystem.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define PROJ_NAME "001-lsystem"
 
-/* How the rewritten word should grow on overflow. */
-#define WLEN_SIZE_INIT 1024U
-#define WLEN_SIZE_REALLOC 1024U
+/* Size of chunks the arenas of the workers allocate. */
+#define ARENA_CHUNK_SIZE (64U * 1024U * 1024U)
 
-/* 0U for raster, 1U for vector. */
-#define RASTER_OR_VECTOR 1U
+/* Number of workers drawing at once, 0U for one per CPU. */
+#define WORKER_COUNT 0U
 
-/* Size of the image (it's a square). */
-#define IMG_SIZE 1000U
+/* Memory the words and images being drawn at once may take. */
+#define MEM_BUDGET ((size_t)1024U * 1024U * 1024U)
 
-typedef struct lsystem_draw_params_s
-{
-    double_t const angle_delta;
-    double_t const angle_start;
-    double_t const line_width_start;
-    double_t const line_width_delta;
-    double_t const line_width_min;
-    double_t const line_len;
-    uint32_t const x_start;
-    uint32_t const y_start;
-
-    color_st const color_branch;
-    color_st const color_gradient[3];
-} lsystem_draw_params_st;
-
-typedef struct lsystem_prule_s
-{
-    char const *const l;
-    char const *const r;
-} lsystem_prule_st;
+/* 1U to also draw every iteration of each L-system as a separate frame. */
+#define FRAMES 0U
 
-typedef struct lsystem_cword_s
-{
-    uint32_t const wlen;
-    char const *const w;
-} lsystem_cword_st;
-
-typedef struct lsystem_vword_s
-{
-    uint32_t blen; /* Length of the allocated buffer. */
-    /**
-     * Length of the word contained in the buffer.
-     * Should be <=blen.
-     */
-    uint32_t wlen;
-    char *w;
-} lsystem_vword_st;
+/* 1U to also draw close-ups of parts of the L-systems. */
+#define VIEWS 0U
 
-typedef struct lsystem_s
-{
-    lsystem_cword_st const alph;
-    lsystem_cword_st const axiom;
-    uint8_t iters;
+/* Backend used unless another one is named by the first argument. */
+#define BACKEND AMISS_BACKEND_VECTOR
 
-    /* Production rules. */
-    uint32_t const pr_count;
-    lsystem_prule_st const (*const pr)[];
-} lsystem_st;
+/* Largest scale display lists can be replayed at. */
+#define REPLAY_SCALE_MAX 16.0
 
 /**
- * @brief Determine if a production rule is applicable at given position in a
- * word.
- * @param prule Production rule to check.
- * @param word Word to check applicability of rule for.
- * @param word_idx Position in the word where to check if production rule
- * applies.
- * @return True if rule can be applied, false if not.
- */
-bool lsystem_prule_check(lsystem_prule_st const prule,
-                         lsystem_vword_st *const word, uint32_t const word_idx)
-{
-    uint32_t const llen = (uint32_t)strlen(prule.l);
-    if (word_idx + llen <= word->wlen &&
-        memcmp(&word->w[word_idx], prule.l, llen) == 0)
-    {
-        return true;
-    }
-    else
-    {
-        return false;
-    }
-}
-
-/**
- * @brief Perform one rewrite iteration of the given word using a grammar.
- * @param grammar What L-System grammar to use for generation.
- * @param word Where the generated word will be stored.
+ * @brief Draw the display lists saved by an earlier run with the record
+ * backend, without generating the L-systems again.
+ * @param jobs Jobs whose display lists to draw, frames and views are skipped.
+ * @param job_count Number of jobs.
+ * @param scale How much larger to draw than recorded.
+ * @param backend Backend to draw with. Raster images are drawn in parallel
+ * strips by the pool, the other backends draw on this thread.
+ * @param pool Workers drawing raster strips.
+ * @param arena Where to allocate the canvases from.
  * @return 0 on success, 1 on failure.
  */
-uint8_t lsystem_rewrite(lsystem_st const grammar, lsystem_vword_st *const word)
+static uint8_t replay(lsystem_job_st const *const jobs,
+                      uint32_t const job_count, double_t const scale,
+                      amiss_backend_kind_et const backend,
+                      amiss_job_pool_st *const pool,
+                      amiss_arena_st *const arena)
 {
-    /* Nothing to rewrite. */
-    if (word->wlen == 0)
-    {
-        return 1;
-    }
-    uint32_t prules_applied_total = 0U;
-    for (uint32_t word_idx = 0U; word_idx < word->wlen; ++word_idx)
+    for (uint32_t job_idx = 0U; job_idx < job_count; ++job_idx)
     {
-        uint32_t prules_applied = 0U;
-        for (uint32_t prule_idx = 0U; prule_idx < grammar.pr_count; ++prule_idx)
+        if (jobs[job_idx].frames == true || jobs[job_idx].view_count > 0U)
         {
-            lsystem_prule_st const prule = (*grammar.pr)[prule_idx];
-            uint32_t const llen = (uint32_t)strlen(prule.l);
-            uint32_t const rlen = (uint32_t)strlen(prule.r);
-
-            if (lsystem_prule_check(prule, word, word_idx) == true)
-            {
-                log_dbg("RWR",
-                        // clang-format off
-                        "Applying rule %.*s->%.*s"
-                        CLR_TXT(CLR_YEL, " = ")
-                        "%.*s"
-                        CLR_TXT(CLR_BLU, "%.*s")
-                        "%.*s"
-                        " to...\n",
-                        // clang-format on
-                        llen, prule.l, rlen, prule.r, word_idx, &word->w[0U],
-                        llen, &word->w[word_idx], word->wlen - word_idx - llen,
-                        &word->w[word_idx + llen]);
-
-                int64_t const wlen_delta = rlen - llen;
-                /**
-                 * Safe cast because it is not possible for word length to
-                 * become negative here.
-                 */
-                uint32_t const wlen_after = (uint32_t)(word->wlen + wlen_delta);
-
-                /**
-                 * Allocate extra memory for word if rewrite rule leads to
-                 * overflow of current word buffer.
-                 */
-                if (wlen_after > word->blen)
-                {
-                    uint32_t const blen_need = wlen_after;
-                    uint32_t const blen_new =
-                        word->blen + WLEN_SIZE_REALLOC > blen_need
-                            ? word->blen + WLEN_SIZE_REALLOC
-                            : blen_need;
-                    char *w_new = realloc(word->w, blen_new);
-                    if (w_new == NULL)
-                    {
-                        log_err(
-                            "RWR",
-                            "Failed to realloc buffer for rewritten word\n");
-                        return 1U;
-                    }
-                    log_dbg("RWR", "Reallocated word buffer from %u to %u\n",
-                            word->blen, blen_new);
-                    word->w = w_new;
-                    word->blen = blen_new;
-                }
-
-                /**
-                 * In order to rewrite, might have to move parts of the current
-                 * word to not overwrite them.
-                 */
-                if (wlen_delta != 0)
-                {
-                    memmove(&word->w[word_idx + (rlen - llen) + 1U],
-                            &word->w[word_idx + llen],
-                            word->wlen - word_idx - llen);
-                }
-
-                /**
-                 * Write RHS of production rule where LHS is located in the
-                 * word.
-                 */
-                if (rlen > 0)
-                {
-                    memcpy(&word->w[word_idx], prule.r, rlen);
-                }
-
-                log_dbg("RWR", "%.*s" CLR_TXT(CLR_BLU, "%.*s") "%.*s\n",
-                        word_idx, &word->w[0U], rlen, &word->w[word_idx],
-                        word->wlen - word_idx - rlen,
-                        &word->w[word_idx + rlen]);
-
-                int64_t const word_idx_new = word_idx + wlen_delta;
-                if (word_idx_new < 0 || word_idx_new > UINT32_MAX)
-                {
-                    log_dbg("RWR", "Word index cannot become negative\n");
-                    return 1U;
-                }
-                word_idx =
-                    (uint32_t)(word_idx +
-                               wlen_delta); /* Safe cast due to bound check. */
-                word->wlen = wlen_after;
-                prules_applied++;
-            }
+            continue; /* Only whole scenes are replayed. */
         }
-        prules_applied_total += prules_applied;
-    }
-    if (prules_applied_total == 0U)
-    {
-        return 1;
+        char path_in[256U];
+        char path_out[256U];
+        snprintf(path_in, sizeof(path_in), "%s.%s", jobs[job_idx].path_prefix,
+                 amiss_backend_ext(AMISS_BACKEND_RECORD));
+        snprintf(path_out, sizeof(path_out), "%s_replay.%s",
+                 jobs[job_idx].path_prefix, amiss_backend_ext(backend));
+        amiss_dlist_st dlist;
+        if (amiss_dlist_open(&dlist, path_in) != 0)
+        {
+            log_err("MAIN", "Failed to open %s, record it first\n", path_in);
+            return 1U;
+        }
+        /* Safe casts, the recorded size and scale are small. */
+        uint32_t const w = (uint32_t)lround(dlist.w * scale);
+        uint32_t const h = (uint32_t)lround(dlist.h * scale);
+        amiss_backend_st canvas;
+        if (amiss_backend_create(&canvas, backend, arena, w, h) != 0)
+        {
+            log_err("MAIN", "Failed to allocate image\n");
+            amiss_dlist_close(&dlist);
+            return 1U;
+        }
+        uint64_t const t_begin = amiss_stage_now();
+        int const ret = backend == AMISS_BACKEND_RASTER
+                            ? amiss_dlist_render(&dlist, &canvas.img, scale,
+                                                 pool)
+                            : amiss_dlist_replay(&dlist, &canvas, scale);
+        amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
+        if (ret != 0 || amiss_backend_save(&canvas, path_out) != 0)
+        {
+            log_err("MAIN", "Failed to replay %s\n", path_in);
+            amiss_backend_destroy(&canvas);
+            amiss_dlist_close(&dlist);
+            return 1U;
+        }
+        log_info("MAIN", "%s: %u ops replayed at %gx by the %s backend\n",
+                 path_in, dlist.op_count, scale, canvas.ops->name);
+        amiss_backend_destroy(&canvas);
+        amiss_dlist_close(&dlist);
+        amiss_arena_reset(arena);
     }
     return 0U;
 }
 
 /**
- * @brief Draw a word generated using an L-System (F,+,-,[,]).
- * @param word The word to draw.
- * @param draw_params How to draw the word.
- * @param img Image to rasterize word on.
- * @param pluto Context for when using vector library.
+ * @brief Render L-systems progressively, one after the other. Each shows up
+ * coarse in a preview file right away and gets refined in place, see
+ * lsystem_gen_preview.
+ * @param jobs Jobs to render, frames, views and parametric L-systems are
+ * skipped.
+ * @param job_count Number of jobs.
+ * @param backend Backend drawing the final pass of each job.
+ * @param pool Workers drawing the passes.
  * @return 0 on success, 1 on failure.
  */
-uint8_t lsystem_draw(lsystem_vword_st const word,
-                     lsystem_draw_params_st const draw_params,
-#if RASTER_OR_VECTOR == 1U
-                     plutovg_t *const pluto
-#else
-                     amiss_img_st const img
-#endif
-)
+static uint8_t preview(lsystem_job_st const *const jobs,
+                       uint32_t const job_count,
+                       amiss_backend_kind_et const backend,
+                       amiss_job_pool_st *const pool)
 {
-    uint32_t const stack_size = 1024U;
-    double_t const line_width = draw_params.line_width_min;
-    double_t const line_len = draw_params.line_len;
-    double_t const angle_delta = draw_params.angle_delta;
-    vec2u32_st *pos_stack = malloc(stack_size * sizeof(vec2u32_st));
-    double_t *angle_stack = malloc(stack_size * sizeof(double_t));
-    double_t *width_delta_stack = malloc(stack_size * sizeof(double_t));
-    uint32_t sp = 0U;
-
-    pos_stack[0U].x = draw_params.x_start;
-    pos_stack[0U].y = draw_params.y_start;
-    angle_stack[0U] = 180.0 + 90.0 + draw_params.angle_start; /* Degrees. */
-    width_delta_stack[0U] = draw_params.line_width_start;
-
-    for (uint32_t word_idx = 0; word_idx < word.wlen; ++word_idx)
+    for (uint32_t job_idx = 0U; job_idx < job_count; ++job_idx)
     {
-        switch (word.w[word_idx])
+        if (jobs[job_idx].frames == true || jobs[job_idx].view_count > 0U ||
+            jobs[job_idx].pls != NULL)
         {
-        case 'F': {
-            vec2u32_st const start = {.x = pos_stack[sp].x,
-                                      .y = pos_stack[sp].y};
-            int64_t endx =
-                pos_stack[sp].x +
-                llround(cos(angle_stack[sp] * (M_PI / 180.0)) * line_len);
-            int64_t endy =
-                pos_stack[sp].y +
-                llround(sin(angle_stack[sp] * (M_PI / 180.0)) * line_len);
-            if (endx < 0)
-            {
-                endx = 0;
-            }
-            if (endy < 0)
-            {
-                endy = 0;
-            }
-            vec2u32_st const end = {
-                .x = (uint32_t)endx,
-                .y = (uint32_t)endy}; /* Safe cast thanks to bound checks. */
-#if RASTER_OR_VECTOR == 1U
-            plutovg_move_to(pluto, start.x, start.y);
-            plutovg_line_to(pluto, end.x, end.y);
-            plutovg_set_source_rgb(pluto, draw_params.color_branch.r / 255.0,
-                                   draw_params.color_branch.g / 255.0,
-                                   draw_params.color_branch.b / 255.0);
-            plutovg_set_line_width(pluto, width_delta_stack[sp] > line_width
-                                              ? width_delta_stack[sp]
-                                              : line_width);
-            plutovg_stroke(pluto);
-#else
-            amiss_draw_line(&img, draw_params.color_branch, line_width, false,
-                            start, end);
-#endif
-            width_delta_stack[sp] -= draw_params.line_width_delta;
-            pos_stack[sp].x = end.x;
-            pos_stack[sp].y = end.y;
-            break;
-        }
-        case '+': {
-            angle_stack[sp] = fmod(angle_stack[sp] + angle_delta, 365.0);
-            break;
+            continue; /* Only whole scenes of plain L-systems are previewed. */
         }
-        case '-': {
-            double_t const angle_next = angle_stack[sp] - angle_delta;
-            angle_stack[sp] =
-                angle_next < 0.0 ? 365.0 - angle_next : angle_next;
-            break;
-        }
-        case '[': {
-            if (sp + 1U >= stack_size)
-            {
-                log_err("DRAW", "Stack too small\n");
-                free(pos_stack);
-                free(angle_stack);
-                free(width_delta_stack);
-                return 1;
-            }
-            memcpy(&pos_stack[sp + 1U], &pos_stack[sp], sizeof(pos_stack[0U]));
-            memcpy(&angle_stack[sp + 1U], &angle_stack[sp],
-                   sizeof(angle_stack[0U]));
-            memcpy(&width_delta_stack[sp + 1U], &width_delta_stack[sp],
-                   sizeof(width_delta_stack[0U]));
-            sp += 1;
-            break;
-        }
-        case ']': {
-            if ((int64_t)sp - 1 < 0)
-            {
-                log_err("DRAW", "Stack too small\n");
-                free(pos_stack);
-                free(angle_stack);
-                free(width_delta_stack);
-                return 1U;
-            }
-            sp -= 1;
-            break;
-        }
-
-        default:
-            break;
+        if (lsystem_gen_preview(jobs[job_idx].ls, jobs[job_idx].draw_params,
+                                backend, jobs[job_idx].path_prefix,
+                                pool) != 0U)
+        {
+            log_err("MAIN", "Failed to preview %s\n",
+                    jobs[job_idx].path_prefix);
+            return 1U;
         }
     }
-    free(pos_stack);
-    free(angle_stack);
-    free(width_delta_stack);
     return 0U;
 }
 
-/**
- * @brief Generate a word using an L-system definition and draw it according to
- * drawing params.
- * @param ls The L-system to use.
- * @param draw_params How to draw the word after it is generated.
- * @param path_out Where to save the drawn word.
- * @return 0 on success, 1 on failure.
- */
-uint8_t lsystem_gen(lsystem_st const ls,
-                    lsystem_draw_params_st const draw_params,
-                    char const *const path_out)
+int main(int const argc, char const *const argv[])
 {
-    /* Gradient details. */
-    double_t stops[] = {0.0, 0.5, 1.0};
-
-#if RASTER_OR_VECTOR == 1U
-    plutovg_surface_t *const pluto_surface =
-        plutovg_surface_create(IMG_SIZE, IMG_SIZE);
-    plutovg_t *const pluto = plutovg_create(pluto_surface);
-
-    /* Add background to image. */
-    plutovg_gradient_t *const gradient = plutovg_gradient_create_linear(
-        IMG_SIZE / 2U, 0U, IMG_SIZE / 2U, IMG_SIZE);
-    for (uint8_t stop_idx = 0U; stop_idx < sizeof(stops) / sizeof(stops[0]);
-         ++stop_idx)
-    {
-        plutovg_gradient_add_stop_rgb(
-            gradient, stops[stop_idx],
-            draw_params.color_gradient[stop_idx].r / 255.0,
-            draw_params.color_gradient[stop_idx].g / 255.0,
-            draw_params.color_gradient[stop_idx].b / 255.0);
-    }
-    plutovg_rect(pluto, 0U, 0U, IMG_SIZE, IMG_SIZE);
-    plutovg_set_source_gradient(pluto, gradient);
-    plutovg_fill(pluto);
-#else
-    uint32_t img_buf_len = IMG_SIZE * IMG_SIZE * 3U /* RGB */;
-    uint8_t *img_buf = malloc(img_buf_len);
-    amiss_img_st img = {
-        .b = img_buf,
-        .blen = img_buf_len,
-        .fmt = AMISS_IMG_FMT_PPM,
-        .h = IMG_SIZE,
-        .w = IMG_SIZE,
-    };
-
-    /* Add background to image. */
-    gradient_st gradient = {
-        .count = 3U, .colors = draw_params.color_gradient, .stops = stops};
-    amiss_draw_bg_gradient(&img, gradient);
-#endif
-
-    lsystem_vword_st word = {.w = malloc(WLEN_SIZE_INIT),
-                             .wlen = ls.axiom.wlen,
-                             .blen = WLEN_SIZE_INIT};
-    if (word.w == NULL)
-    {
-        log_err("MAIN", "Failed to allocate word\n");
-        return 1U;
-    }
-    memcpy(word.w, ls.axiom.w, ls.axiom.wlen);
-
-    uint32_t const iter_max = ls.iters;
-    for (uint32_t iter = 0U; iter <= iter_max + 1; ++iter)
+    amiss_backend_kind_et backend = BACKEND;
+    bool const replaying = argc > 1 && strcmp(argv[1], "replay") == 0;
+    bool const previewing = argc > 1 && strcmp(argv[1], "preview") == 0;
+    double_t scale = 1.0;
+    if (replaying == true)
     {
-        /* Do something with intermediate word. */
-        log_info("MAIN", "[%u] '%.*s'\n\n", iter, word.wlen, word.w);
-        if (iter + 1 > iter_max + 1)
-        {
-            break;
-        }
-
-        int ret = lsystem_rewrite(ls, &word);
-        if (ret > 0)
+        /* Replays rasterize unless told otherwise. */
+        backend = AMISS_BACKEND_RASTER;
+        char *scale_end = NULL;
+        scale = argc > 2 ? strtod(argv[2], &scale_end) : 0.0;
+        if (argc < 3 || argc > 4 || *scale_end != '\0' || !(scale > 0.0) ||
+            scale > REPLAY_SCALE_MAX ||
+            (argc > 3 && amiss_backend_kind_parse(argv[3], &backend) != 0))
         {
-            log_info("MAIN", "No more rules can be applied\n");
-            break;
+            fprintf(stderr, "Usage: %s replay SCALE [BACKEND]\n", argv[0]);
+            return EXIT_FAILURE;
         }
-        else if (ret < 0)
+    }
+    else if (previewing == true)
+    {
+        if (argc > 3 ||
+            (argc > 2 && amiss_backend_kind_parse(argv[2], &backend) != 0))
         {
-            log_err("MAIN", "An error occurred\n");
-            return 1U;
+            fprintf(stderr, "Usage: %s preview [BACKEND]\n", argv[0]);
+            return EXIT_FAILURE;
         }
     }
-#if RASTER_OR_VECTOR == 1U
-    lsystem_draw(word, draw_params, pluto);
-    plutovg_surface_write_to_png(pluto_surface, path_out);
-    plutovg_gradient_destroy(gradient);
-    plutovg_surface_destroy(pluto_surface);
-    plutovg_destroy(pluto);
-#else
-    lsystem_draw(word, draw_params, img);
-    if (amiss_img_save(&img, path_out) != 0)
+    else if (argc > 2)
     {
-        log_err("MAIN", "Failed to save image to disk\n");
+        fprintf(stderr,
+                "Usage: %s [raster|vector|hybrid|supersample|record|null]\n"
+                "       %s replay SCALE [BACKEND]\n"
+                "       %s preview [BACKEND]\n",
+                argv[0], argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    else if (argc > 1 && amiss_backend_kind_parse(argv[1], &backend) != 0)
+    {
+        return EXIT_FAILURE;
     }
-    free(img.b);
-#endif
-    free(word.w);
-    return 0U;
-}
 
-int main()
-{
     /* Generate L-system. */
     lsystem_draw_params_st const draw_params[] = {
         {
@@ -507,131 +245,89 @@ int main()
                     {.a = {22U, 36U, 63U}},
                 },
         },
-    };
-    lsystem_prule_st const prule[][5U] = {
-        {
-            {
-                .l = "X",
-                .r = "F+[[X]-X]-F[-FX]+X",
-            },
-            {
-                .l = "F",
-                .r = "FF",
-            },
-        },
-        {
-            {
-                .l = "F",
-                .r = "FF-[-F+F+F]+[+F-F-F]",
-            },
-        },
-        {
-            {
-                .l = "X",
-                .r = "F[+X]F[-X]+X",
-            },
-            {
-                .l = "F",
-                .r = "FF",
-            },
-        },
         {
-            {
-                .l = "V",
-                .r = "[+++W][---W]YV",
-            },
-            {
-                .l = "W",
-                .r = "+X[-W]Z",
-            },
-            {
-                .l = "X",
-                .r = "-W[+X]Z",
-            },
-            {
-                .l = "Y",
-                .r = "YZ",
-            },
-            {
-                .l = "Z",
-                .r = "[-FFF][+FFF]F",
-            },
-        },
-    };
-    lsystem_st const ls[] = {
-        {
-            .alph =
-                {
-                    .w = "XF+-[]",
-                    .wlen = 6U,
-                },
-            .axiom =
-                {
-                    .w = "X",
-                    .wlen = 1U,
-                },
-            .iters = 6U,
-            .pr_count = 2U,
-            .pr = &prule[0U],
-        },
-        {
-            .alph =
-                {
-                    .w = "F+-[]",
-                    .wlen = 5U,
-                },
-            .axiom =
-                {
-                    .w = "F",
-                    .wlen = 1U,
-                },
-            .iters = 4U,
-            .pr_count = 1U,
-            .pr = &prule[1U],
-        },
-        {
-            .alph =
-                {
-                    .w = "XF+-[]",
-                    .wlen = 6U,
-                },
-            .axiom =
-                {
-                    .w = "X",
-                    .wlen = 1U,
-                },
-            .iters = 5U,
-            .pr_count = 2U,
-            .pr = &prule[2U],
-        },
-        {
-            .alph =
-                {
-                    .w = "FVWXYZ+-[]",
-                    .wlen = 6U,
-                },
-            .axiom =
+            /* Angles and widths come from the parameters of the modules. */
+            .angle_delta = 25.0,
+            .angle_start = 0.0,
+            .line_width_delta = 0.0,
+            .line_width_start = 12.0,
+            .line_width_min = 1.0,
+            .line_len = 1.0,
+            .x_start = IMG_SIZE / 2U,
+            .y_start = IMG_SIZE - 1U,
+            .color_branch = {.a = {88U, 60U, 40U}},
+            .color_gradient =
                 {
-                    .w = "VZFFF",
-                    .wlen = 5U,
+                    {.a = {247U, 244U, 234U}},
+                    {.a = {229U, 221U, 196U}},
+                    {.a = {238U, 232U, 214U}},
                 },
-            .iters = 7U,
-            .pr_count = 5U,
-            .pr = &prule[3U],
         },
     };
+    /* Grammars are described in grammars.lsys and compiled by lsysc. */
+    lsystem_st const *const ls = lsystem_grammars;
+    plsystem_st const *const pls = plsystem_grammars;
+
+#if VIEWS == 1U
+    /* Close-ups of the dense bush of rule 1, scaled up to the whole canvas. */
+    amiss_box_st const views[] = {
+        {.x0 = 150U, .y0 = 500U, .x1 = 349U, .y1 = 699U},
+        {.x0 = 400U, .y0 = 100U, .x1 = 599U, .y1 = 299U},
+        {.x0 = 500U, .y0 = 850U, .x1 = 649U, .y1 = 999U},
+    };
+#endif
 
-#if RASTER_OR_VECTOR == 1U
-    lsystem_gen(ls[0U], draw_params[0U], PROJ_NAME "_rule0.png");
-    lsystem_gen(ls[1U], draw_params[1U], PROJ_NAME "_rule1.png");
-    lsystem_gen(ls[2U], draw_params[2U], PROJ_NAME "_rule2.png");
-    lsystem_gen(ls[3U], draw_params[3U], PROJ_NAME "_rule3.png");
-#else
-    lsystem_gen(ls[0U], draw_params[0U], PROJ_NAME "_rule0.ppm");
-    lsystem_gen(ls[1U], draw_params[1U], PROJ_NAME "_rule1.ppm");
-    lsystem_gen(ls[2U], draw_params[2U], PROJ_NAME "_rule2.ppm");
-    lsystem_gen(ls[3U], draw_params[3U], PROJ_NAME "_rule3.ppm");
+    lsystem_job_st const jobs[] = {
+        {&ls[0U], NULL, &draw_params[0U], PROJ_NAME "_rule0", backend,
+         false, NULL, 0U},
+        {&ls[1U], NULL, &draw_params[1U], PROJ_NAME "_rule1", backend,
+         false, NULL, 0U},
+        {&ls[2U], NULL, &draw_params[2U], PROJ_NAME "_rule2", backend,
+         false, NULL, 0U},
+        {&ls[3U], NULL, &draw_params[3U], PROJ_NAME "_rule3", backend,
+         false, NULL, 0U},
+        {NULL, &pls[PLSYSTEM_GRAMMAR_PTREE], &draw_params[4U],
+         PROJ_NAME "_ptree", backend, false, NULL, 0U},
+#if VIEWS == 1U
+        {&ls[1U], NULL, &draw_params[1U], PROJ_NAME "_rule1", backend,
+         false, views, sizeof(views) / sizeof(views[0U])},
 #endif
+#if FRAMES == 1U
+        {&ls[0U], NULL, &draw_params[0U], PROJ_NAME "_rule0", backend,
+         true, NULL, 0U},
+        {&ls[1U], NULL, &draw_params[1U], PROJ_NAME "_rule1", backend,
+         true, NULL, 0U},
+        {&ls[2U], NULL, &draw_params[2U], PROJ_NAME "_rule2", backend,
+         true, NULL, 0U},
+        {&ls[3U], NULL, &draw_params[3U], PROJ_NAME "_rule3", backend,
+         true, NULL, 0U},
+#endif
+    };
+
+    /* Every worker allocates from its own arena which is reset after a job. */
+    amiss_job_pool_st pool;
+    if (amiss_job_pool_init(&pool, WORKER_COUNT, MEM_BUDGET, ARENA_CHUNK_SIZE,
+                            AMISS_ARENA_FLAG_HUGE) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    amiss_arena_st arena;
+    if (amiss_arena_init(&arena, ARENA_CHUNK_SIZE, AMISS_ARENA_FLAG_NONE) != 0)
+    {
+        amiss_job_pool_free(&pool);
+        return EXIT_FAILURE;
+    }
 
-    return EXIT_SUCCESS;
+    uint8_t const ret =
+        replaying == true
+            ? replay(jobs, sizeof(jobs) / sizeof(jobs[0U]), scale, backend,
+                     &pool, &arena)
+        : previewing == true
+            ? preview(jobs, sizeof(jobs) / sizeof(jobs[0U]), backend, &pool)
+            : lsystem_gen_batch(jobs, sizeof(jobs) / sizeof(jobs[0U]), &pool,
+                                &arena);
+
+    amiss_arena_free(&arena);
+    amiss_job_pool_free(&pool);
+    return ret == 0U ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,503 @@
+#include "plsystem.h"
+#include <string.h>
+
+/* Turtle stack depth, i.e. how deeply brackets can nest. */
+#define TURTLE_STACK_SIZE 1024U
+
+/* Where the turtle is, kept in floating point as parameters are fractional. */
+typedef struct turtle_s
+{
+    double_t x;
+    double_t y;
+    double_t angle; /* Degrees. */
+    double_t width;
+} turtle_st;
+
+/**
+ * @brief Round a coordinate of the turtle to a pixel, the plane ends at 0 like
+ * it does for lsystem_interpret.
+ */
+static uint32_t coord_px(double_t const coord)
+{
+    int64_t const px = llround(coord);
+    /* Safe cast thanks to bound checks. */
+    return px < 0 ? 0U : (px > UINT32_MAX ? UINT32_MAX : (uint32_t)px);
+}
+
+/**
+ * @brief Make sure a word can hold a number of modules. Its modules are not
+ * kept when the arrays have to grow, so it's meant for words about to be
+ * written.
+ * @param word Word to grow.
+ * @param len Number of modules it must hold.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t plsystem_word_reserve(plsystem_word_st *const word, uint32_t const len)
+{
+    if (len <= word->cap)
+    {
+        return 0U;
+    }
+    uint64_t cap_new = word->cap == 0U ? WLEN_SIZE_INIT : word->cap;
+    while (cap_new < len)
+    {
+        cap_new *= WLEN_SIZE_GROWTH;
+    }
+    cap_new = cap_new > UINT32_MAX ? UINT32_MAX : cap_new;
+    word->sym = amiss_arena_alloc(word->arena, cap_new);
+    word->pick = amiss_arena_alloc(word->arena, cap_new);
+    bool params_ok = true;
+    for (uint32_t param_idx = 0U; param_idx < PLSYSTEM_PARAM_MAX; ++param_idx)
+    {
+        word->param[param_idx] =
+            amiss_arena_alloc(word->arena, cap_new * sizeof(float));
+        params_ok = params_ok && word->param[param_idx] != NULL;
+    }
+    if (word->sym == NULL || word->pick == NULL || params_ok == false)
+    {
+        log_err("MAIN", "Failed to allocate word\n");
+        word->cap = 0U;
+        return 1U;
+    }
+    word->cap = (uint32_t)cap_new; /* Safe cast, clamped above. */
+    return 0U;
+}
+
+/**
+ * @brief Pick the rule rewriting every module of a batch. Conditions are
+ * evaluated over the whole batch one rule at a time, then a rule is drawn for
+ * every module among the ones whose condition holds, weighted by their odds.
+ * The random number of a module only depends on the seed, the iteration and
+ * the index of the module, so batches can be picked in any order.
+ * @param ls L-system to pick rules from.
+ * @param key Key of the counter-based generator for this iteration.
+ * @param batch Modules to pick rules for.
+ * @param pick Set to the rule picked for every module of the batch.
+ * @return Number of modules the batch gets rewritten to.
+ */
+static uint64_t batch_pick(plsystem_st const ls, uint64_t const key,
+                           plsystem_batch_st const *const batch,
+                           uint8_t *const pick)
+{
+    static uint8_t const ok_none[PLSYSTEM_BATCH] = {0U};
+    uint8_t ok[PLSYSTEM_PRULE_MAX][PLSYSTEM_BATCH];
+    uint8_t const *prule_ok[PLSYSTEM_PRULE_MAX];
+    float weight_sum[PLSYSTEM_BATCH] = {0.0f};
+    for (uint32_t prule_idx = 0U; prule_idx < ls.pr_count; ++prule_idx)
+    {
+        plsystem_prule_st const *const prule = &ls.pr[prule_idx];
+        uint32_t match_count = 0U;
+        for (uint32_t idx = 0U; idx < batch->count; ++idx)
+        {
+            ok[prule_idx][idx] = batch->sym[idx] == prule->l;
+            match_count += ok[prule_idx][idx];
+        }
+        if (match_count == 0U)
+        {
+            prule_ok[prule_idx] = ok_none;
+            continue; /* Not worth evaluating the condition. */
+        }
+        prule_ok[prule_idx] = ok[prule_idx];
+        if (prule->cond != NULL)
+        {
+            prule->cond(batch, ok[prule_idx]);
+        }
+        for (uint32_t idx = 0U; idx < batch->count; ++idx)
+        {
+            weight_sum[idx] += ok[prule_idx][idx] != 0U ? prule->weight : 0.0f;
+        }
+    }
+
+    uint64_t len = 0U;
+    for (uint32_t idx = 0U; idx < batch->count; ++idx)
+    {
+        pick[idx] = PLSYSTEM_PICK_NONE;
+        if (weight_sum[idx] > 0.0f)
+        {
+            double_t odds =
+                amiss_rng_at_f64(key, batch->first + idx) * weight_sum[idx];
+            for (uint32_t prule_idx = 0U; prule_idx < ls.pr_count; ++prule_idx)
+            {
+                if (prule_ok[prule_idx][idx] == 0U)
+                {
+                    continue;
+                }
+                /* The last rule that applies takes what rounding leaves. */
+                pick[idx] = (uint8_t)prule_idx; /* Safe, rules are few. */
+                odds -= ls.pr[prule_idx].weight;
+                if (odds < 0.0)
+                {
+                    break;
+                }
+            }
+        }
+        len += pick[idx] == PLSYSTEM_PICK_NONE ? 1U : ls.pr[pick[idx]].rlen;
+    }
+    return len;
+}
+
+/**
+ * @brief Write the successors of a batch whose rules were picked. Modules no
+ * rule applies to are copied, the others are written by the successor of their
+ * rule which runs once over the whole batch.
+ * @param ls L-system the rules were picked from.
+ * @param batch Modules to rewrite.
+ * @param pick Rule picked for every module of the batch.
+ * @param dst_first Where the successor of the first module starts in out.
+ * @param out Word to write the successors to, large enough to hold them.
+ */
+static void batch_write(plsystem_st const ls,
+                        plsystem_batch_st const *const batch,
+                        uint8_t const *const pick, uint32_t const dst_first,
+                        plsystem_word_st *const out)
+{
+    uint32_t dst[PLSYSTEM_BATCH];
+    uint32_t prules_used = 0U;
+    uint32_t at = dst_first;
+    for (uint32_t idx = 0U; idx < batch->count; ++idx)
+    {
+        dst[idx] = at;
+        if (pick[idx] == PLSYSTEM_PICK_NONE)
+        {
+            out->sym[at] = batch->sym[idx];
+            for (uint32_t param_idx = 0U; param_idx < PLSYSTEM_PARAM_MAX;
+                 ++param_idx)
+            {
+                out->param[param_idx][at] = batch->param[param_idx][idx];
+            }
+            at++;
+        }
+        else
+        {
+            prules_used |= 1U << pick[idx];
+            at += ls.pr[pick[idx]].rlen;
+        }
+    }
+    while (prules_used != 0U)
+    {
+        uint8_t const prule_idx = (uint8_t)__builtin_ctz(prules_used);
+        ls.pr[prule_idx].succ(batch, pick, prule_idx, dst, out);
+        prules_used &= prules_used - 1U;
+    }
+}
+
+/**
+ * @brief Batch of a word starting at a module.
+ * @param word Word the batch is part of.
+ * @param first Index of the first module of the batch.
+ * @return The batch, PLSYSTEM_BATCH modules long or up to the end of the word.
+ */
+static plsystem_batch_st word_batch(plsystem_word_st const *const word,
+                                    uint32_t const first)
+{
+    plsystem_batch_st batch = {
+        .first = first,
+        .count = word->len - first < PLSYSTEM_BATCH ? word->len - first
+                                                    : PLSYSTEM_BATCH,
+        .sym = &word->sym[first],
+    };
+    for (uint32_t param_idx = 0U; param_idx < PLSYSTEM_PARAM_MAX; ++param_idx)
+    {
+        batch.param[param_idx] = &word->param[param_idx][first];
+    }
+    return batch;
+}
+
+/**
+ * @brief Perform one rewrite iteration of a parametric L-system. A first pass
+ * picks the rule of every module and counts the modules of the new word, a
+ * second one writes it. Both go batch by batch and batches only share the
+ * running count of modules, so they could be spread over workers.
+ * @param ls L-system whose rules to apply.
+ * @param iter Index of the iteration, picks differ from one to the next.
+ * @param in Word to rewrite, the rule picked for every module is kept in it.
+ * @param out Where to write the new word, can't be the same as in.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t plsystem_rewrite(plsystem_st const ls, uint32_t const iter,
+                         plsystem_word_st *const in,
+                         plsystem_word_st *const out)
+{
+    PROF_SCOPE("plsystem_rewrite");
+    uint64_t const key = amiss_rng_at(ls.seed, iter);
+    uint64_t len = 0U;
+    for (uint32_t first = 0U; first < in->len; first += PLSYSTEM_BATCH)
+    {
+        plsystem_batch_st const batch = word_batch(in, first);
+        len += batch_pick(ls, key, &batch, &in->pick[first]);
+    }
+    if (len > UINT32_MAX)
+    {
+        log_err("MAIN", "Word is too long\n");
+        return 1U;
+    }
+    if (plsystem_word_reserve(out, (uint32_t)len) != 0U) /* Safe cast. */
+    {
+        return 1U;
+    }
+
+    uint32_t dst_first = 0U;
+    for (uint32_t first = 0U; first < in->len; first += PLSYSTEM_BATCH)
+    {
+        plsystem_batch_st const batch = word_batch(in, first);
+        batch_write(ls, &batch, &in->pick[first], dst_first, out);
+        for (uint32_t idx = 0U; idx < batch.count; ++idx)
+        {
+            uint8_t const pick = in->pick[first + idx];
+            dst_first += pick == PLSYSTEM_PICK_NONE ? 1U : ls.pr[pick].rlen;
+        }
+    }
+    out->len = (uint32_t)len;
+    return 0U;
+}
+
+/**
+ * @brief Bound the number of modules an L-system generates without generating
+ * it. Every module is counted as making the most of every symbol any of its
+ * rules makes, conditions aside, so the bound is loose for words whose
+ * conditions stop their growth.
+ * @param ls The L-system.
+ * @return Most modules the word can have, at most UINT32_MAX.
+ */
+uint32_t plsystem_len_bound(plsystem_st const ls)
+{
+    double_t counts[2U][UINT8_MAX + 1U] = {{0.0}};
+    for (uint32_t module_idx = 0U; module_idx < ls.axiom_len; ++module_idx)
+    {
+        counts[0U][(uint8_t)ls.axiom_sym[module_idx]] += 1.0;
+    }
+    for (uint32_t iter = 0U; iter < ls.iters; ++iter)
+    {
+        double_t const *const cur = counts[iter % 2U];
+        double_t *const next = counts[(iter + 1U) % 2U];
+        memset(next, 0, sizeof(counts[0U]));
+        for (uint32_t sym = 0U; sym <= UINT8_MAX; ++sym)
+        {
+            if (cur[sym] == 0.0)
+            {
+                continue;
+            }
+            /* A module no rule applies to is kept. */
+            uint32_t most[UINT8_MAX + 1U] = {0U};
+            bool always = false;
+            for (uint32_t prule_idx = 0U; prule_idx < ls.pr_count; ++prule_idx)
+            {
+                plsystem_prule_st const *const prule = &ls.pr[prule_idx];
+                if ((uint8_t)prule->l != sym)
+                {
+                    continue;
+                }
+                uint32_t made[UINT8_MAX + 1U] = {0U};
+                for (uint32_t r_idx = 0U; r_idx < prule->rlen; ++r_idx)
+                {
+                    uint8_t const r_sym = (uint8_t)prule->r[r_idx];
+                    made[r_sym]++;
+                    most[r_sym] = made[r_sym] > most[r_sym] ? made[r_sym]
+                                                            : most[r_sym];
+                }
+                always = always || prule->cond == NULL;
+            }
+            if (always == false && most[sym] == 0U)
+            {
+                most[sym] = 1U;
+            }
+            for (uint32_t made_sym = 0U; made_sym <= UINT8_MAX; ++made_sym)
+            {
+                next[made_sym] += cur[sym] * most[made_sym];
+            }
+        }
+    }
+    double_t len = 0.0;
+    for (uint32_t sym = 0U; sym <= UINT8_MAX; ++sym)
+    {
+        len += counts[ls.iters % 2U][sym];
+    }
+    return len < UINT32_MAX ? (uint32_t)len : UINT32_MAX;
+}
+
+/**
+ * @brief Generate the word of a parametric L-system by rewriting its axiom
+ * iters times. Words are rewritten back and forth between two buffers.
+ * @param ls The L-system to use.
+ * @param word Set to the generated word.
+ * @param arena Where the words are allocated from.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t plsystem_expand(plsystem_st const ls, plsystem_word_st *const word,
+                        amiss_arena_st *const arena)
+{
+    PROF_SCOPE("plsystem_expand");
+    uint64_t const t_expand = amiss_stage_now();
+    plsystem_word_st words[2U] = {{.len = 0U, .cap = 0U, .arena = arena},
+                                  {.len = 0U, .cap = 0U, .arena = arena}};
+    if (plsystem_word_reserve(&words[0U], ls.axiom_len) != 0U)
+    {
+        amiss_stage_end(AMISS_STAGE_EXPAND, t_expand);
+        return 1U;
+    }
+    memcpy(words[0U].sym, ls.axiom_sym, ls.axiom_len);
+    for (uint32_t module_idx = 0U; module_idx < ls.axiom_len; ++module_idx)
+    {
+        for (uint32_t param_idx = 0U; param_idx < PLSYSTEM_PARAM_MAX;
+             ++param_idx)
+        {
+            words[0U].param[param_idx][module_idx] =
+                ls.axiom_param[module_idx][param_idx];
+        }
+    }
+    words[0U].len = ls.axiom_len;
+
+    uint8_t ret = 0U;
+    for (uint32_t iter = 0U; iter < ls.iters && ret == 0U; ++iter)
+    {
+        ret = plsystem_rewrite(ls, iter, &words[iter % 2U],
+                               &words[(iter + 1U) % 2U]);
+        log_info("MAIN", "[%u] %u modules\n", iter + 1U,
+                 words[(iter + 1U) % 2U].len);
+    }
+    *word = words[ls.iters % 2U];
+    amiss_stage_end(AMISS_STAGE_EXPAND, t_expand);
+    return ret;
+}
+
+/**
+ * @brief Interpret a word of a parametric L-system as turtle commands and
+ * collect the segments it traces. Parameters take the place of the draw
+ * params where a module has them:
+ * - F(len, width) draws a line, f(len) moves without drawing,
+ * - +(angle) and -(angle) turn, !(width) sets the width of the next lines,
+ * - [ and ] push and pop the turtle, anything else is skipped.
+ * @param ls L-system the word was generated by, for the arity of symbols.
+ * @param word The word to interpret.
+ * @param draw_params Where the turtle starts and what modules without
+ * parameters do.
+ * @param segs Where the segments get appended. On failure it holds the segments
+ * traced up to the point of failure. The turtle stack is allocated from its
+ * arena too.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t plsystem_interpret(plsystem_st const ls,
+                           plsystem_word_st const *const word,
+                           lsystem_draw_params_st const draw_params,
+                           lsystem_segs_st *const segs)
+{
+    PROF_SCOPE("plsystem_interpret");
+    uint64_t const t_begin = amiss_stage_now();
+    turtle_st *const stack =
+        amiss_arena_alloc(segs->arena, TURTLE_STACK_SIZE * sizeof(stack[0U]));
+    if (stack == NULL)
+    {
+        log_err("DRAW", "Failed to allocate stack\n");
+        amiss_stage_end(AMISS_STAGE_INTERPRET, t_begin);
+        return 1U;
+    }
+    uint32_t sp = 0U;
+    stack[0U] = (turtle_st){.x = draw_params.x_start,
+                            .y = draw_params.y_start,
+                            .angle = 180.0 + 90.0 + draw_params.angle_start,
+                            .width = draw_params.line_width_start};
+
+    uint8_t ret = 0U;
+    for (uint32_t module_idx = 0U; module_idx < word->len && ret == 0U;
+         ++module_idx)
+    {
+        char const sym = word->sym[module_idx];
+        uint8_t const arity = ls.arity[(unsigned char)sym];
+        double_t const p0 = arity > 0U ? word->param[0U][module_idx] : NAN;
+        turtle_st *const turtle = &stack[sp];
+        switch (sym)
+        {
+        case 'F':
+        case 'f': {
+            double_t const len = arity > 0U ? p0 : draw_params.line_len;
+            double_t const angle = turtle->angle * (M_PI / 180.0);
+            double_t const x_end = turtle->x + (cos(angle) * len);
+            double_t const y_end = turtle->y + (sin(angle) * len);
+            if (sym == 'F')
+            {
+                double_t const width =
+                    arity > 1U ? word->param[1U][module_idx] : turtle->width;
+                ret = lsystem_segs_push(
+                    segs, (lsystem_seg_st){
+                              .start = {.x = coord_px(turtle->x),
+                                        .y = coord_px(turtle->y)},
+                              .end = {.x = coord_px(x_end),
+                                      .y = coord_px(y_end)},
+                              .width = width > draw_params.line_width_min
+                                           ? width
+                                           : draw_params.line_width_min,
+                              .gen = 0U,
+                          });
+            }
+            turtle->x = x_end;
+            turtle->y = y_end;
+            break;
+        }
+        case '+':
+            turtle->angle += arity > 0U ? p0 : draw_params.angle_delta;
+            break;
+        case '-':
+            turtle->angle -= arity > 0U ? p0 : draw_params.angle_delta;
+            break;
+        case '!':
+            turtle->width = arity > 0U ? p0 : draw_params.line_width_start;
+            break;
+        case '[':
+            if (sp + 1U >= TURTLE_STACK_SIZE)
+            {
+                log_err("DRAW", "Stack too small\n");
+                ret = 1U;
+                break;
+            }
+            stack[sp + 1U] = stack[sp];
+            sp++;
+            break;
+        case ']':
+            if (sp == 0U)
+            {
+                log_err("DRAW", "Unbalanced brackets\n");
+                ret = 1U;
+                break;
+            }
+            sp--;
+            break;
+        default:
+            break;
+        }
+    }
+    amiss_stage_end(AMISS_STAGE_INTERPRET, t_begin);
+    return ret;
+}
+
+/**
+ * @brief Generate the word of a parametric L-system and draw it.
+ * @param ls The L-system to use.
+ * @param draw_params How to draw the word.
+ * @param backend Backend to draw with.
+ * @param path_prefix Where to save the drawn word, the file extension of the
+ * backend gets appended to it.
+ * @param arena Where the image, words and segments are allocated from.
+ * Everything stays allocated until the caller resets the arena.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t plsystem_gen(plsystem_st const ls,
+                     lsystem_draw_params_st const draw_params,
+                     amiss_backend_kind_et const backend,
+                     char const *const path_prefix,
+                     amiss_arena_st *const arena)
+{
+    PROF_SCOPE("plsystem_gen");
+    plsystem_word_st word;
+    if (plsystem_expand(ls, &word, arena) != 0U)
+    {
+        return 1U;
+    }
+    lsystem_segs_st segs = {.cap = 0U, .count = 0U, .s = NULL, .arena = arena};
+    uint8_t const ret = plsystem_interpret(ls, &word, draw_params, &segs);
+    if (lsystem_render_segs(&segs, draw_params, backend, path_prefix, arena) !=
+        0U)
+    {
+        return 1U;
+    }
+    return ret;
+}
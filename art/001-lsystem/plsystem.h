@@ -0,0 +1,119 @@
+#pragma once
+
+#include "lsystem.h"
+
+/* Most parameters a module can have. */
+#define PLSYSTEM_PARAM_MAX 3U
+
+/* Most rules a parametric L-system can have. */
+#define PLSYSTEM_PRULE_MAX 32U
+
+/**
+ * Modules rules are evaluated over at once. Every batch is rewritten on its
+ * own once the batches before it are counted, so they could be spread over
+ * workers.
+ */
+#define PLSYSTEM_BATCH 256U
+
+/* Rule picked for a module no rule applies to, it's copied as is. */
+#define PLSYSTEM_PICK_NONE UINT8_MAX
+
+/**
+ * Word of a parametric L-system, a module is a symbol and up to
+ * PLSYSTEM_PARAM_MAX parameters. Modules are kept as a structure of arrays so
+ * rules evaluate a parameter of many modules with a single loop.
+ */
+typedef struct plsystem_word_s
+{
+    uint32_t len; /* Number of modules. */
+    uint32_t cap; /* Number of modules the arrays can hold. */
+    char *sym;
+    /**
+     * Parameter i of every module, undefined for modules with fewer
+     * parameters. How many a symbol takes is given by the L-system.
+     */
+    float *param[PLSYSTEM_PARAM_MAX];
+    uint8_t *pick; /* Rule picked for every module by the last rewrite. */
+    amiss_arena_st *arena; /* Where the arrays are allocated from. */
+} plsystem_word_st;
+
+/* Consecutive modules of a word rules are evaluated over. */
+typedef struct plsystem_batch_s
+{
+    uint32_t first; /* Index of the first module in the word. */
+    uint32_t count;
+    char const *sym;
+    float const *param[PLSYSTEM_PARAM_MAX];
+} plsystem_batch_st;
+
+/**
+ * Condition of a rule, generated by lsysc.
+ * @param batch Modules to evaluate the condition for.
+ * @param ok Cleared for every module the condition is false for.
+ */
+typedef void plsystem_cond_ft(plsystem_batch_st const *const batch,
+                              uint8_t *const ok);
+
+/**
+ * Successor of a rule, generated by lsysc.
+ * @param batch Modules being rewritten.
+ * @param pick Rule picked for every module of the batch.
+ * @param prule Index of the rule, only modules that picked it are rewritten.
+ * @param dst Where the successor of every module of the batch starts.
+ * @param out Word to write the successors to.
+ */
+typedef void plsystem_succ_ft(plsystem_batch_st const *const batch,
+                              uint8_t const *const pick, uint8_t const prule,
+                              uint32_t const *const dst,
+                              plsystem_word_st *const out);
+
+typedef struct plsystem_prule_s
+{
+    char const l; /* Symbol of the module rewritten. */
+    /**
+     * Odds of the rule being picked relative to the other rules whose
+     * condition holds for the module.
+     */
+    float const weight;
+    uint32_t const rlen; /* Number of modules of the successor. */
+    char const *const r; /* Symbols of the successor, rlen of them. */
+    plsystem_cond_ft *const cond; /* NULL if the rule always applies. */
+    plsystem_succ_ft *const succ;
+} plsystem_prule_st;
+
+typedef struct plsystem_s
+{
+    uint32_t const axiom_len;
+    char const *const axiom_sym;
+    float const (*const axiom_param)[PLSYSTEM_PARAM_MAX];
+    uint8_t const *const arity; /* Parameters of every symbol. */
+    uint8_t iters;
+    /* Rules are picked from a sequence of this seed, equal seeds draw alike. */
+    uint64_t const seed;
+
+    /* Production rules, several for a symbol are picked between at random. */
+    uint32_t const pr_count;
+    plsystem_prule_st const *const pr;
+} plsystem_st;
+
+uint8_t plsystem_word_reserve(plsystem_word_st *const word, uint32_t const len);
+
+uint8_t plsystem_rewrite(plsystem_st const ls, uint32_t const iter,
+                         plsystem_word_st *const in,
+                         plsystem_word_st *const out);
+
+uint32_t plsystem_len_bound(plsystem_st const ls);
+
+uint8_t plsystem_expand(plsystem_st const ls, plsystem_word_st *const word,
+                        amiss_arena_st *const arena);
+
+uint8_t plsystem_interpret(plsystem_st const ls,
+                           plsystem_word_st const *const word,
+                           lsystem_draw_params_st const draw_params,
+                           lsystem_segs_st *const segs);
+
+uint8_t plsystem_gen(plsystem_st const ls,
+                     lsystem_draw_params_st const draw_params,
+                     amiss_backend_kind_et const backend,
+                     char const *const path_prefix,
+                     amiss_arena_st *const arena);
@@ -3,76 +3,219 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define IMG_SIZE 1080
+/* Defaults, they can be overridden by the arguments. */
+#define IMG_SIZE 1080U
+#define GRID_SIZE 20U
 
-int main()
+#define SEED 0x6C6F7665U
+#define ARENA_CHUNK_SIZE (64U * 1024U * 1024U)
+
+typedef struct hitomezashi_s
 {
-    uint32_t const buf_size = IMG_SIZE * IMG_SIZE * 3U /* RGB */;
-    uint8_t *buf = malloc(buf_size);
-    if (buf == NULL)
-    {
-        return 1;
-    }
-    amiss_img_st img = {
-        .b = buf,
-        .blen = buf_size,
-        .fmt = AMISS_IMG_FMT_PPM,
-        .h = IMG_SIZE,
-        .w = IMG_SIZE,
-    };
+    uint32_t grid_size;
+    uint32_t margin_size;
+    uint32_t row_count; /* Lines of horizontal stitches. */
+    uint32_t col_count; /* Lines of vertical stitches. */
+    /* Bit i is set when line i starts one grid cell later. */
+    uint64_t *row_bits;
+    uint64_t *col_bits;
+} hitomezashi_st;
 
-    color_st color_bg = {.r = 27, .g = 11, .b = 9};
-    for (uint32_t y = 0U; y < img.h; ++y)
+static color_st const color_bg = {.r = 27, .g = 11, .b = 9};
+static color_st const color_fill = {.r = 72, .g = 33, .b = 28};
+static color_st const color_stitch = {.r = 180, .g = 90, .b = 80};
+
+static uint32_t bit_get(uint64_t const *const bits, uint32_t const idx)
+{
+    return (uint32_t)(bits[idx / 64U] >> (idx % 64U)) & 1U;
+}
+
+/**
+ * @brief Draw all horizontal stitches. Each one is 2 pixels thick.
+ * @param img Image to draw on.
+ * @param pattern Pattern to draw.
+ */
+static void stitches_h_draw(amiss_img_st const *const img,
+                            hitomezashi_st const *const pattern)
+{
+    uint32_t const grid_size = pattern->grid_size;
+    for (uint32_t row_idx = 0U; row_idx < pattern->row_count; ++row_idx)
     {
-        for (uint32_t x = 0U; x < img.w; ++x)
+        uint32_t const y = pattern->margin_size + (grid_size * row_idx);
+        uint32_t x = (pattern->margin_size / 2U) +
+                     (grid_size * (1U + bit_get(pattern->row_bits, row_idx)));
+        for (; x < img->w - pattern->margin_size; x += grid_size * 2U)
         {
-            amiss_draw_px_set(&img, color_bg, x, y);
+            amiss_draw_span_h(img, color_stitch, x, x + grid_size, y);
+            amiss_draw_span_h(img, color_stitch, x, x + grid_size, y + 1U);
         }
     }
+}
 
-    /* Init seed for RNG. */
-    srand(0x6C6F7665);
-
-    uint16_t const grid_size = 20U;
-    color_st const color_stitch = {.r = 180, .g = 90, .b = 80};
-    uint32_t const margin_size = grid_size * 2U;
-
-    /* Vertical stitches. */
-    for (uint32_t y = margin_size; y < img.h - (margin_size / 2U);
-         y += grid_size)
+/**
+ * @brief Draw all vertical stitches, 2 pixels thick with the second line one
+ * pixel longer. They are drawn one band of two grid cells at a time so the
+ * rows being written stay in cache, instead of walking down whole columns.
+ * @param img Image to draw on.
+ * @param pattern Pattern to draw.
+ */
+static void stitches_v_draw(amiss_img_st const *const img,
+                            hitomezashi_st const *const pattern)
+{
+    uint32_t const grid_size = pattern->grid_size;
+    uint32_t const y_end = img->h - pattern->margin_size;
+    for (uint32_t y_band = (pattern->margin_size / 2U) + grid_size;
+         y_band < y_end; y_band += grid_size * 2U)
     {
-        vec2u32_st start = {.x = (uint32_t)rand() > (RAND_MAX / 2U)
-                                     ? (margin_size / 2U) + (grid_size * 2U)
-                                     : (margin_size / 2U) + grid_size,
-                            .y = y};
-        while (start.x < img.w - margin_size)
+        for (uint32_t col_idx = 0U; col_idx < pattern->col_count; ++col_idx)
         {
-            vec2u32_st end = {.x = start.x + grid_size, .y = start.y};
-            amiss_draw_line(&img, color_stitch, 1.0, false, start, end);
-            amiss_draw_line(&img, color_stitch, 1.0, false,
-                            (vec2u32_st){.x = start.x, .y = start.y + 1U},
-                            (vec2u32_st){.x = end.x, .y = end.y + 1U});
-            start.x += grid_size * 2U;
+            uint32_t const x = pattern->margin_size + (grid_size * col_idx);
+            uint32_t const y =
+                y_band + (grid_size * bit_get(pattern->col_bits, col_idx));
+            if (y < y_end)
+            {
+                amiss_draw_span_v(img, color_stitch, x, y, y + grid_size);
+                amiss_draw_span_v(img, color_stitch, x + 1U, y,
+                                  y + grid_size + 1U);
+            }
         }
     }
+}
 
-    for (uint32_t x = margin_size; x < img.w - (margin_size / 2U);
-         x += grid_size)
+/**
+ * @brief Color the regions enclosed by the stitches in two alternating colors.
+ * Crossing a line where it's stitched moves into the other region, so the
+ * color of a cell is the parity of stitches crossed on the way from the first
+ * cell. A row of cells is drawn once and copied to the rest of its pixel rows.
+ * @param img Image to draw on.
+ * @param pattern Pattern to fill.
+ */
+static void regions_fill(amiss_img_st const *const img,
+                         hitomezashi_st const *const pattern)
+{
+    uint32_t const grid_size = pattern->grid_size;
+    uint8_t const depth = amiss_img_depth(img);
+    uint32_t const x_start = pattern->margin_size;
+    uint32_t const x_end =
+        pattern->margin_size + (grid_size * (pattern->col_count - 1U));
+    uint32_t parity_row = 0U;
+    for (uint32_t row_idx = 0U; row_idx + 1U < pattern->row_count; ++row_idx)
     {
-        vec2u32_st start = {.x = x,
-                            .y = (uint32_t)rand() > (RAND_MAX / 2U)
-                                     ? (margin_size / 2U) + (grid_size * 2U)
-                                     : (margin_size / 2U) + grid_size};
-        while (start.y < img.h - margin_size)
+        /* Line row_idx is stitched above the first cell when it's unshifted. */
+        if (row_idx > 0U)
         {
-            vec2u32_st end = {.x = start.x, .y = start.y + grid_size};
-            amiss_draw_line(&img, color_stitch, 1.0, false, start, end);
-            amiss_draw_line(&img, color_stitch, 1.0, false,
-                            (vec2u32_st){.x = start.x + 1U, .y = start.y},
-                            (vec2u32_st){.x = end.x + 1U, .y = end.y + 1U});
-            start.y += grid_size * 2U;
+            parity_row ^= bit_get(pattern->row_bits, row_idx) ^ 1U;
         }
+        uint32_t const y = pattern->margin_size + (grid_size * row_idx);
+
+        uint32_t parity = parity_row;
+        uint32_t x_run = x_start;
+        for (uint32_t col_idx = 1U; col_idx < pattern->col_count; ++col_idx)
+        {
+            uint32_t const x = pattern->margin_size + (grid_size * col_idx);
+            /* Line col_idx is stitched next to this row of cells. */
+            uint32_t const toggle =
+                bit_get(pattern->col_bits, col_idx) == (row_idx & 1U) ? 1U
+                                                                       : 0U;
+            if (toggle == 1U || col_idx + 1U == pattern->col_count)
+            {
+                amiss_draw_span_h(img, parity == 1U ? color_fill : color_bg,
+                                  x_run, x - 1U, y);
+                x_run = x;
+                parity ^= toggle;
+            }
+        }
+        for (uint32_t y_copy = y + 1U; y_copy < y + grid_size; ++y_copy)
+        {
+            memcpy(&img->b[amiss_img_xy2idx(img, depth, x_start, y_copy)],
+                   &img->b[amiss_img_xy2idx(img, depth, x_start, y)],
+                   (size_t)(x_end - x_start) * depth);
+        }
+    }
+}
+
+int main(int const argc, char const *const argv[])
+{
+    uint32_t img_size = IMG_SIZE;
+    uint32_t grid_size = GRID_SIZE;
+    bool fill = false;
+    if (argc > 4)
+    {
+        fprintf(stderr, "Usage: %s [size [grid_size [fill]]]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 1)
+    {
+        img_size = (uint32_t)strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2)
+    {
+        grid_size = (uint32_t)strtoul(argv[2], NULL, 10);
+    }
+    if (argc > 3)
+    {
+        fill = strtoul(argv[3], NULL, 10) != 0U;
+    }
+    if (grid_size == 0U || img_size / 4U < grid_size)
+    {
+        fprintf(stderr, "Grid size has to be between 1 and a quarter of the "
+                        "image size\n");
+        return 1;
+    }
+
+    amiss_arena_st arena;
+    if (amiss_arena_init(&arena, ARENA_CHUNK_SIZE, AMISS_ARENA_FLAG_HUGE) != 0)
+    {
+        return 1;
+    }
+    amiss_img_st img;
+    if (amiss_img_create(&img, &arena, img_size, img_size, AMISS_IMG_FMT_PPM) !=
+        0)
+    {
+        amiss_arena_free(&arena);
+        return 1;
+    }
+    uint64_t const t_begin = amiss_stage_now();
+    for (uint32_t y = 0U; y < img.h; ++y)
+    {
+        amiss_draw_span_h(&img, color_bg, 0U, img.w - 1U, y);
+    }
+
+    /* Lines stop a grid cell before the edge, stitches two before it. */
+    uint32_t const margin_size = grid_size * 2U;
+    hitomezashi_st pattern = {
+        .grid_size = grid_size,
+        .margin_size = margin_size,
+        .row_count = (img.h - margin_size - 1U) / grid_size,
+        .col_count = (img.w - margin_size - 1U) / grid_size,
+    };
+    uint32_t const row_words = (pattern.row_count + 63U) / 64U;
+    uint32_t const col_words = (pattern.col_count + 63U) / 64U;
+    pattern.row_bits = amiss_arena_alloc(&arena, row_words * sizeof(uint64_t));
+    pattern.col_bits = amiss_arena_alloc(&arena, col_words * sizeof(uint64_t));
+    if (pattern.row_bits == NULL || pattern.col_bits == NULL)
+    {
+        amiss_arena_free(&arena);
+        return 1;
+    }
+
+    /* Init seed for RNG. */
+    amiss_rng_st rng;
+    amiss_rng_seed(&rng, SEED);
+    amiss_rng4_st rng4;
+    amiss_rng4_init(&rng4, &rng);
+    amiss_rng4_fill_bits(&rng4, pattern.row_bits, row_words, 0.5);
+    amiss_rng4_fill_bits(&rng4, pattern.col_bits, col_words, 0.5);
+
+    if (fill == true)
+    {
+        regions_fill(&img, &pattern);
     }
+    stitches_h_draw(&img, &pattern);
+    stitches_v_draw(&img, &pattern);
+    amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
 
-    return amiss_img_save(&img, "002-hitomezashi.ppm");
+    int const ret = amiss_img_save(&img, "002-hitomezashi.ppm");
+    amiss_arena_free(&arena);
+    return ret == 0 ? 0 : 1;
 }
@@ -0,0 +1,416 @@
+#include "amiss.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* Limits on how much gets recorded per art. */
+#define RESULT_COUNT_MAX 128U
+#define KEY_LEN_MAX 256U
+#define VAL_LEN_MAX 32U
+
+/* Default number of runs per art, the fastest one is kept. */
+#define RUNS_DEFAULT 3U
+/* Default slowdown relative to the baseline that is tolerated. */
+#define TOLERANCE_DEFAULT 0.10
+
+typedef struct result_s
+{
+    char art[KEY_LEN_MAX];
+    char key[KEY_LEN_MAX];
+    char val[VAL_LEN_MAX];
+} result_st;
+
+typedef struct results_s
+{
+    uint32_t count;
+    result_st r[RESULT_COUNT_MAX];
+} results_st;
+
+static void results_add(results_st *const results, char const *const art,
+                        char const *const key, char const *const val)
+{
+    if (results->count >= RESULT_COUNT_MAX)
+    {
+        fprintf(stderr, "Too many results, dropping %s %s\n", art, key);
+        return;
+    }
+    result_st *const result = &results->r[results->count++];
+    snprintf(result->art, sizeof(result->art), "%s", art);
+    snprintf(result->key, sizeof(result->key), "%s", key);
+    snprintf(result->val, sizeof(result->val), "%s", val);
+}
+
+static result_st const *results_find(results_st const *const results,
+                                     char const *const art,
+                                     char const *const key)
+{
+    for (uint32_t result_idx = 0U; result_idx < results->count; ++result_idx)
+    {
+        if (strcmp(results->r[result_idx].art, art) == 0 &&
+            strcmp(results->r[result_idx].key, key) == 0)
+        {
+            return &results->r[result_idx];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Load results from a tab separated file with one art, key and value per
+ * line.
+ * @param results Where to load the results.
+ * @param path File to load.
+ * @return 0 on success, -1 if the file can't be read.
+ */
+static int results_load(results_st *const results, char const *const path)
+{
+    results->count = 0U;
+    FILE *const f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    char line[KEY_LEN_MAX * 3U];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (line[0U] == '#')
+        {
+            continue;
+        }
+        char *const art = strtok(line, "\t\n");
+        char *const key = strtok(NULL, "\t\n");
+        char *const val = strtok(NULL, "\t\n");
+        if (art != NULL && key != NULL && val != NULL)
+        {
+            results_add(results, art, key, val);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static int results_store(results_st const *const results,
+                         char const *const path)
+{
+    FILE *const f = fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Failed to write baseline %s\n", path);
+        return -1;
+    }
+    fprintf(f, "# art\tkey\tvalue\n");
+    for (uint32_t result_idx = 0U; result_idx < results->count; ++result_idx)
+    {
+        fprintf(f, "%s\t%s\t%s\n", results->r[result_idx].art,
+                results->r[result_idx].key, results->r[result_idx].val);
+    }
+    fclose(f);
+    return 0;
+}
+
+#if !defined(_WIN32)
+/**
+ * @brief Run an art once, collecting its wall time, peak RSS, stage timings and
+ * output hashes.
+ * @param program Path of the art binary.
+ * @param art Name of the art.
+ * @param run Results of the run are stored here.
+ * @return 0 on success, -1 on failure.
+ */
+static int art_run(char const *const program, char const *const art,
+                   results_st *const run)
+{
+    char stage_path[KEY_LEN_MAX + sizeof(".stages")];
+    snprintf(stage_path, sizeof(stage_path), "%s.stages", art);
+    remove(stage_path);
+
+    struct timespec ts_begin;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_begin);
+    pid_t const pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "Failed to fork\n");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        setenv(AMISS_STAGE_ENV, stage_path, 1);
+        /* Keep the output of the art from cluttering the report. */
+        if (freopen("/dev/null", "w", stdout) == NULL)
+        {
+            _exit(EXIT_FAILURE);
+        }
+        execl(program, program, (char *)NULL);
+        _exit(EXIT_FAILURE);
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0)
+    {
+        fprintf(stderr, "Failed to wait for %s\n", art);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "%s failed\n", art);
+        return -1;
+    }
+
+    char val[VAL_LEN_MAX];
+    run->count = 0U;
+    snprintf(val, sizeof(val), "%.6f",
+             (double)(ts_end.tv_sec - ts_begin.tv_sec) +
+                 ((double)(ts_end.tv_nsec - ts_begin.tv_nsec) * 1e-9));
+    results_add(run, art, "wall_s", val);
+    /* Linux reports kilobytes. */
+    snprintf(val, sizeof(val), "%ld", usage.ru_maxrss);
+    results_add(run, art, "rss_kb", val);
+
+    FILE *const f = fopen(stage_path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s did not write stages\n", art);
+        return -1;
+    }
+    char line[KEY_LEN_MAX * 2U];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char *const kind = strtok(line, "\t\n");
+        char *const name = strtok(NULL, "\t\n");
+        char *const value = strtok(NULL, "\t\n");
+        if (kind == NULL || name == NULL || value == NULL)
+        {
+            continue;
+        }
+        char key[KEY_LEN_MAX];
+        snprintf(key, sizeof(key), "%s.%s",
+                 strcmp(kind, "output") == 0 ? "hash" : kind, name);
+        results_add(run, art, key, value);
+    }
+    fclose(f);
+    remove(stage_path);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Compare results against the baseline and print a report.
+ * @param results Results of this run.
+ * @param baseline Baseline to compare against.
+ * @param tolerance Tolerated relative slowdown.
+ * @param strict Treat slowdowns as failures.
+ * @return Number of failures.
+ */
+static uint32_t results_compare(results_st const *const results,
+                                results_st const *const baseline,
+                                double const tolerance, bool const strict)
+{
+    uint32_t failures = 0U;
+    printf("%-20s %-32s %18s %18s %8s  %s\n", "art", "key", "baseline",
+           "current", "ratio", "status");
+    for (uint32_t result_idx = 0U; result_idx < results->count; ++result_idx)
+    {
+        result_st const *const cur = &results->r[result_idx];
+        result_st const *const base = results_find(baseline, cur->art, cur->key);
+        bool const is_hash = strncmp(cur->key, "hash.", 5U) == 0;
+        char const *status = "ok";
+        char ratio_str[16U] = "-";
+        if (base == NULL)
+        {
+            status = "new";
+        }
+        else if (is_hash == true)
+        {
+            if (strcmp(cur->val, base->val) != 0)
+            {
+                status = "MISMATCH";
+                failures++;
+            }
+        }
+        else
+        {
+            double const v_base = strtod(base->val, NULL);
+            double const v_cur = strtod(cur->val, NULL);
+            if (v_base > 0.0)
+            {
+                double const ratio = v_cur / v_base;
+                snprintf(ratio_str, sizeof(ratio_str), "%.3f", ratio);
+                if (ratio > 1.0 + tolerance)
+                {
+                    status = strict == true ? "SLOWER" : "slower";
+                    failures += strict == true ? 1U : 0U;
+                }
+                else if (ratio < 1.0 - tolerance)
+                {
+                    status = "faster";
+                }
+            }
+        }
+        printf("%-20s %-32s %18s %18s %8s  %s\n", cur->art, cur->key,
+               base == NULL ? "-" : base->val, cur->val, ratio_str, status);
+    }
+
+    /* Outputs that disappeared are failures too. */
+    for (uint32_t base_idx = 0U; base_idx < baseline->count; ++base_idx)
+    {
+        result_st const *const base = &baseline->r[base_idx];
+        if (strncmp(base->key, "hash.", 5U) == 0 &&
+            results_find(results, base->art, base->key) == NULL)
+        {
+            bool art_ran = false;
+            for (uint32_t result_idx = 0U; result_idx < results->count;
+                 ++result_idx)
+            {
+                art_ran |= strcmp(results->r[result_idx].art, base->art) == 0;
+            }
+            if (art_ran == true)
+            {
+                printf("%-20s %-32s %18s %18s %8s  %s\n", base->art, base->key,
+                       base->val, "-", "-", "MISSING");
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+int main(int const argc, char const *const argv[])
+{
+#if defined(_WIN32)
+    fprintf(stderr, "The harness needs fork and wait4\n");
+    return EXIT_FAILURE;
+#else
+    bool update = false;
+    bool strict = false;
+    uint32_t runs = RUNS_DEFAULT;
+    double tolerance = TOLERANCE_DEFAULT;
+    int arg_idx = 1;
+    for (; arg_idx < argc && argv[arg_idx][0U] == '-'; ++arg_idx)
+    {
+        if (strcmp(argv[arg_idx], "--update") == 0)
+        {
+            update = true;
+        }
+        else if (strcmp(argv[arg_idx], "--strict") == 0)
+        {
+            strict = true;
+        }
+        else if (strcmp(argv[arg_idx], "--runs") == 0 && arg_idx + 1 < argc)
+        {
+            runs = (uint32_t)strtoul(argv[++arg_idx], NULL, 10);
+        }
+        else if (strcmp(argv[arg_idx], "--tolerance") == 0 &&
+                 arg_idx + 1 < argc)
+        {
+            tolerance = strtod(argv[++arg_idx], NULL);
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (arg_idx + 2 > argc || runs == 0U)
+    {
+        fprintf(stderr,
+                "Usage: %s [--update] [--strict] [--runs N] [--tolerance X] "
+                "<baseline> <art binary>...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    char const *const baseline_path = argv[arg_idx++];
+
+    static results_st results;
+    static results_st run;
+    results.count = 0U;
+    bool failed = false;
+    for (; arg_idx < argc; ++arg_idx)
+    {
+        char const *const program = argv[arg_idx];
+        /* Name of the art is the binary name without directory or extension. */
+        char art[KEY_LEN_MAX];
+        char const *const slash = strrchr(program, '/');
+        snprintf(art, sizeof(art), "%s", slash == NULL ? program : slash + 1);
+        char *const dot = strchr(art, '.');
+        if (dot != NULL)
+        {
+            *dot = '\0';
+        }
+
+        /* Keep the fastest run, all runs must produce the same pixels. */
+        uint32_t const results_first = results.count;
+        double wall_best = 0.0;
+        for (uint32_t run_idx = 0U; run_idx < runs; ++run_idx)
+        {
+            if (art_run(program, art, &run) != 0)
+            {
+                failed = true;
+                break;
+            }
+            double const wall = strtod(results_find(&run, art, "wall_s")->val,
+                                       NULL);
+            for (uint32_t r_idx = 0U; r_idx < run.count && run_idx > 0U;
+                 ++r_idx)
+            {
+                if (strncmp(run.r[r_idx].key, "hash.", 5U) != 0)
+                {
+                    continue;
+                }
+                result_st const *const prev =
+                    results_find(&results, art, run.r[r_idx].key);
+                if (prev == NULL || strcmp(prev->val, run.r[r_idx].val) != 0)
+                {
+                    fprintf(stderr, "%s: %s differs between runs\n", art,
+                            run.r[r_idx].key);
+                    failed = true;
+                }
+            }
+            if (run_idx == 0U || wall < wall_best)
+            {
+                wall_best = wall;
+                results.count = results_first;
+                for (uint32_t r_idx = 0U; r_idx < run.count; ++r_idx)
+                {
+                    results_add(&results, art, run.r[r_idx].key,
+                                run.r[r_idx].val);
+                }
+            }
+        }
+    }
+
+    if (update == true)
+    {
+        if (failed == true || results_store(&results, baseline_path) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        printf("Baseline written to %s\n", baseline_path);
+        return EXIT_SUCCESS;
+    }
+
+    static results_st baseline;
+    if (results_load(&baseline, baseline_path) != 0)
+    {
+        printf("No baseline at %s, run with --update to create it\n",
+               baseline_path);
+    }
+    uint32_t const failures =
+        results_compare(&results, &baseline, tolerance, strict);
+    if (failures > 0U || failed == true)
+    {
+        printf("%u check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+#endif
+}
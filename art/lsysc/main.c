@@ -0,0 +1,1587 @@
+#include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Limits of grammar descriptions. */
+#define GRAMMAR_COUNT_MAX 32U
+#define PRULE_COUNT_MAX 32U
+#define NAME_LEN_MAX 64U
+#define WORD_LEN_MAX 256U
+#define LINE_LEN_MAX 1024U
+#define PATH_LEN_MAX 512U
+
+/* Symbols are bytes, the length tables have an entry for every one of them. */
+#define SYM_COUNT 256U
+
+/**
+ * Limits of parametric grammars. PARAM_MAX can't be more than
+ * PLSYSTEM_PARAM_MAX, the generated source checks it.
+ */
+#define PARAM_MAX 3U
+#define MODULE_COUNT_MAX 32U
+#define EXPR_LEN_MAX 48U
+/* Arity of symbols a parametric grammar doesn't use. */
+#define ARITY_UNSET UINT8_MAX
+
+typedef struct prule_s
+{
+    char l[WORD_LEN_MAX];
+    char r[WORD_LEN_MAX];
+} prule_st;
+
+/* A symbol and its parameters, names in a LHS and expressions elsewhere. */
+typedef struct module_s
+{
+    char sym;
+    uint32_t param_count;
+    char param[PARAM_MAX][EXPR_LEN_MAX];
+} module_st;
+
+/* Rule of a parametric grammar. */
+typedef struct pprule_s
+{
+    double weight;
+    module_st l;
+    char cond[LINE_LEN_MAX]; /* Empty when the rule always applies. */
+    uint32_t r_count;
+    module_st r[MODULE_COUNT_MAX];
+} pprule_st;
+
+typedef struct grammar_s
+{
+    char name[NAME_LEN_MAX];
+    char alph[WORD_LEN_MAX];
+    char axiom[WORD_LEN_MAX];
+    uint32_t iters;
+    bool iters_set;
+    uint32_t pr_count;
+    prule_st pr[PRULE_COUNT_MAX];
+
+    /* Declared with pgrammar, the fields below are used instead of pr. */
+    bool parametric;
+    uint64_t seed;
+    uint32_t axiom_count;
+    module_st axiom_modules[MODULE_COUNT_MAX];
+    uint32_t ppr_count;
+    pprule_st ppr[PRULE_COUNT_MAX];
+    uint8_t arity[SYM_COUNT]; /* Parameters of every symbol. */
+} grammar_st;
+
+typedef struct grammars_s
+{
+    uint32_t count;
+    grammar_st g[GRAMMAR_COUNT_MAX];
+} grammars_st;
+
+/* Symbols written by one rule of a cascade, see sym_expand. */
+typedef struct piece_s
+{
+    prule_st const *prule;
+    uint32_t len; /* Leading symbols of the RHS written. */
+    bool gen_kept; /* Tagged with the generation of the rewritten symbol. */
+} piece_st;
+
+/* What one symbol gets rewritten to in a single pass over the word. */
+typedef struct expansion_s
+{
+    uint32_t piece_count;
+    piece_st pieces[PRULE_COUNT_MAX];
+    uint32_t len; /* 0 if no rule rewrites the symbol. */
+} expansion_st;
+
+/**
+ * @brief Check if a rule only makes F longer, mirrors prule_stretches of
+ * 001-lsystem which decides how symbols are tagged with generations.
+ */
+static bool prule_stretches(prule_st const *const prule)
+{
+    if (strcmp(prule->l, "F") != 0 || prule->r[0U] == '\0')
+    {
+        return false;
+    }
+    return strspn(prule->r, "F") == strlen(prule->r);
+}
+
+/**
+ * @brief Check if the generated rewrite can stand in for the rules of a
+ * grammar. It expands every symbol on its own, so every rule must rewrite a
+ * single symbol and can't erase it.
+ */
+static bool grammar_compilable(grammar_st const *const grammar)
+{
+    for (uint32_t prule_idx = 0U; prule_idx < grammar->pr_count; ++prule_idx)
+    {
+        prule_st const *const prule = &grammar->pr[prule_idx];
+        if (strlen(prule->l) != 1U || prule->r[0U] == '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Work out what a symbol expands to. lsystem_rewrite tries the rules in
+ * order at every position, and once a rule applies the rules after it are
+ * tried on the last symbol of its RHS. So a rule whose RHS ends with the LHS of
+ * a later rule has that symbol rewritten again in the same pass, these
+ * cascades are resolved here once instead of for every symbol of the word.
+ * @param grammar Grammar whose rules to apply.
+ * @param sym Symbol to expand.
+ * @param expansion Set to the pieces the symbol expands to.
+ */
+static void sym_expand(grammar_st const *const grammar, char const sym,
+                       expansion_st *const expansion)
+{
+    expansion->piece_count = 0U;
+    expansion->len = 0U;
+    char sym_cur = sym;
+    bool gen_kept = true;
+    for (uint32_t prule_idx = 0U; prule_idx < grammar->pr_count; ++prule_idx)
+    {
+        prule_st const *const prule = &grammar->pr[prule_idx];
+        if (prule->l[0U] != sym_cur)
+        {
+            continue;
+        }
+        if (expansion->piece_count > 0U)
+        {
+            /* The last symbol of the piece before gets rewritten. */
+            expansion->pieces[expansion->piece_count - 1U].len--;
+            expansion->len--;
+        }
+        /* Stretches keep the generation of the symbol they rewrite. */
+        gen_kept = gen_kept && prule_stretches(prule);
+        uint32_t const rlen = (uint32_t)strlen(prule->r);
+        expansion->pieces[expansion->piece_count++] =
+            (piece_st){.prule = prule, .len = rlen, .gen_kept = gen_kept};
+        expansion->len += rlen;
+        sym_cur = prule->r[rlen - 1U];
+    }
+}
+
+/* Write a symbol escaped for C string and character literals. */
+static void sym_emit(FILE *const f, char const sym)
+{
+    if (sym == '\\' || sym == '\'' || sym == '"' || sym == '?')
+    {
+        fputc('\\', f);
+    }
+    fputc(sym, f);
+}
+
+static void str_emit(FILE *const f, char const *const str, uint32_t const len)
+{
+    fputc('"', f);
+    for (uint32_t str_idx = 0U; str_idx < len; ++str_idx)
+    {
+        sym_emit(f, str[str_idx]);
+    }
+    fputc('"', f);
+}
+
+/**
+ * Name of a grammar in capitals, as used by lsystem_grammar_et or
+ * plsystem_grammar_et.
+ */
+static void enum_emit(FILE *const f, grammar_st const *const grammar)
+{
+    char const *const name = grammar->name;
+    fputs(grammar->parametric == true ? "PLSYSTEM_" : "LSYSTEM_", f);
+    fputs("GRAMMAR_", f);
+    for (uint32_t name_idx = 0U; name[name_idx] != '\0'; ++name_idx)
+    {
+        fputc(toupper((unsigned char)name[name_idx]), f);
+    }
+}
+
+/**
+ * @brief Write the copy of part of an expansion.
+ * @param f Where to write.
+ * @param run Symbols to copy.
+ * @param run_len Number of symbols.
+ * @param offset Where the symbols go in the expansion.
+ * @param gen_kept Tag the symbols with the generation of the rewritten symbol
+ * rather than the new one.
+ */
+static void run_emit(FILE *const f, char const *const run,
+                     uint32_t const run_len, uint32_t const offset,
+                     bool const gen_kept)
+{
+    char pos[32U];
+    if (offset == 0U)
+    {
+        snprintf(pos, sizeof(pos), "dst");
+    }
+    else
+    {
+        snprintf(pos, sizeof(pos), "dst + %uU", offset);
+    }
+    fprintf(f, "            memcpy(&w[%s], ", pos);
+    str_emit(f, run, run_len);
+    fprintf(f,
+            ", %uU);\n"
+            "            if (g != NULL)\n"
+            "            {\n"
+            "                memset(&g[%s], %s, %uU);\n"
+            "            }\n",
+            run_len, pos, gen_kept == true ? "gen" : "gen_new", run_len);
+}
+
+/**
+ * @brief Write the rewrite of a grammar: a pass summing up the length of the
+ * new word from a table of expansion lengths, then a pass writing the word in
+ * place from its end with every expansion copied as a constant. Cascades
+ * are fused into a single copy.
+ */
+static void rewrite_emit(FILE *const f, grammar_st const *const grammar)
+{
+    static expansion_st expansions[SYM_COUNT];
+    for (uint32_t sym = 0U; sym < SYM_COUNT; ++sym)
+    {
+        sym_expand(grammar, (char)sym, &expansions[sym]);
+    }
+
+    char const *const name = grammar->name;
+    fprintf(f,
+            "/* Length of what every symbol expands to, 0 if it's kept. */\n"
+            "static uint32_t const %s_lens[%uU] = {\n",
+            name, SYM_COUNT);
+    for (uint32_t sym = 0U; sym < SYM_COUNT; ++sym)
+    {
+        if (expansions[sym].len > 0U)
+        {
+            fputs("    ['", f);
+            sym_emit(f, (char)sym);
+            fprintf(f, "'] = %uU,\n", expansions[sym].len);
+        }
+    }
+    fputs("};\n\n", f);
+
+    fprintf(
+        f,
+        "/**\n"
+        " * @brief Rewrite a word with the rules of %s, see lsystem_rewrite.\n"
+        " * @param word Word to rewrite.\n"
+        " * @return 0 on success, 1 if no rule applies or on failure.\n"
+        " */\n"
+        "static uint8_t %s_rewrite(lsystem_vword_st *const word)\n"
+        "{\n"
+        "    PROF_SCOPE(\"%s_rewrite\");\n"
+        "    uint64_t wlen_new = 0U;\n"
+        "    uint32_t rewritten = 0U;\n"
+        "    for (uint32_t w_idx = 0U; w_idx < word->wlen; ++w_idx)\n"
+        "    {\n"
+        "        uint32_t const len = %s_lens[(uint8_t)word->w[w_idx]];\n"
+        "        wlen_new += len == 0U ? 1U : len;\n"
+        "        rewritten |= len;\n"
+        "    }\n"
+        "    if (rewritten == 0U)\n"
+        "    {\n"
+        "        return 1U;\n"
+        "    }\n"
+        "    if (wlen_new > UINT32_MAX)\n"
+        "    {\n"
+        "        log_err(\"RWR\", \"Rewritten word is too long\\n\");\n"
+        "        return 1U;\n"
+        "    }\n"
+        "    if (lsystem_word_reserve(word, (uint32_t)wlen_new) != 0U)\n"
+        "    {\n"
+        "        return 1U;\n"
+        "    }\n"
+        "\n"
+        "    /* Symbols only move right, so the word is rewritten from its "
+        "end. */\n"
+        "    char *const w = word->w;\n"
+        "    uint8_t *const g = word->g;\n"
+        "    uint8_t const gen_new = (uint8_t)(word->gen + 1U);\n"
+        "    uint32_t dst = (uint32_t)wlen_new;\n"
+        "    for (uint32_t src = word->wlen; src-- > 0U;)\n"
+        "    {\n"
+        "        char const sym = w[src];\n"
+        "        uint8_t const gen = g == NULL ? 0U : g[src];\n"
+        "        switch (sym)\n"
+        "        {\n",
+        name, name, name, name);
+    for (uint32_t sym = 0U; sym < SYM_COUNT; ++sym)
+    {
+        expansion_st const *const expansion = &expansions[sym];
+        if (expansion->len == 0U)
+        {
+            continue;
+        }
+        fputs("        case '", f);
+        sym_emit(f, (char)sym);
+        fputs("':", f);
+        if (expansion->piece_count > 1U)
+        {
+            fputs(" /* Cascade of", f);
+            for (uint32_t piece_idx = 0U; piece_idx < expansion->piece_count;
+                 ++piece_idx)
+            {
+                fprintf(f, " %s->%s", expansion->pieces[piece_idx].prule->l,
+                        expansion->pieces[piece_idx].prule->r);
+            }
+            fputs(". */", f);
+        }
+        fprintf(f, "\n            dst -= %uU;\n", expansion->len);
+        /* Pieces tagged alike are copied at once. */
+        static char run[WORD_LEN_MAX * PRULE_COUNT_MAX];
+        uint32_t run_len = 0U;
+        uint32_t offset = 0U;
+        for (uint32_t piece_idx = 0U; piece_idx < expansion->piece_count;
+             ++piece_idx)
+        {
+            piece_st const *const piece = &expansion->pieces[piece_idx];
+            memcpy(&run[run_len], piece->prule->r, piece->len);
+            run_len += piece->len;
+            if (run_len > 0U &&
+                (piece_idx + 1U == expansion->piece_count ||
+                 expansion->pieces[piece_idx + 1U].gen_kept != piece->gen_kept))
+            {
+                run_emit(f, run, run_len, offset, piece->gen_kept);
+                offset += run_len;
+                run_len = 0U;
+            }
+        }
+        fputs("            break;\n", f);
+    }
+    fputs("        default:\n"
+          "            w[--dst] = sym;\n"
+          "            if (g != NULL)\n"
+          "            {\n"
+          "                g[dst] = gen;\n"
+          "            }\n"
+          "            break;\n"
+          "        }\n"
+          "    }\n"
+          "    word->wlen = (uint32_t)wlen_new;\n"
+          "    PROF_COUNT(AMISS_PROF_COUNTER_SYMBOLS, word->wlen);\n"
+          "    word->gen++;\n"
+          "    return 0U;\n"
+          "}\n\n",
+          f);
+}
+
+/* A float literal, with a fraction so it isn't read as an integer. */
+static void float_emit(FILE *const f, double const value)
+{
+    char lit[32U];
+    snprintf(lit, sizeof(lit), "%.9g", value);
+    fprintf(f, "%s%sf", lit, strpbrk(lit, ".e") == NULL ? ".0" : "");
+}
+
+/* Where a parser is in an expression and what it translates it for. */
+typedef struct expr_s
+{
+    char const *at;
+    module_st const *lhs;
+    FILE *f;
+    uint32_t *used;
+} expr_st;
+
+/* Skip blanks, keeping them in the translation. */
+static void expr_space(expr_st *const expr)
+{
+    while (isspace((unsigned char)*expr->at) != 0)
+    {
+        if (expr->f != NULL)
+        {
+            fputc(*expr->at, expr->f);
+        }
+        expr->at++;
+    }
+}
+
+/* Write part of the translation, if there is one. */
+static void expr_emit(expr_st const *const expr, char const *const text)
+{
+    if (expr->f != NULL)
+    {
+        fputs(text, expr->f);
+    }
+}
+
+/* Consume an operator if it comes next, not mistaking "<=" for '<'. */
+static bool expr_op(expr_st *const expr, char const *const op)
+{
+    expr_space(expr);
+    size_t const len = strlen(op);
+    if (strncmp(expr->at, op, len) != 0 ||
+        (len == 1U && expr->at[1U] == '=' && strchr("<>!", *op) != NULL))
+    {
+        return false;
+    }
+    expr->at += len;
+    if (expr->f != NULL)
+    {
+        fputs(op, expr->f);
+        /* "a--b" and "- -a" must not turn into decrements. */
+        if (strchr("+-", op[len - 1U]) != NULL && *expr->at != '\0' &&
+            strchr("+-", *expr->at) != NULL)
+        {
+            fputc(' ', expr->f);
+        }
+    }
+    return true;
+}
+
+static char const *expr_or(expr_st *const expr);
+
+/* A number, a parameter of the LHS or a parenthesized expression. */
+static char const *expr_primary(expr_st *const expr)
+{
+    expr_space(expr);
+    char const *const start = expr->at;
+    if (isdigit((unsigned char)*expr->at) != 0 ||
+        (*expr->at == '.' && isdigit((unsigned char)expr->at[1U]) != 0))
+    {
+        while (isdigit((unsigned char)*expr->at) != 0)
+        {
+            expr->at++;
+        }
+        bool fraction = false;
+        if (*expr->at == '.')
+        {
+            fraction = true;
+            expr->at++;
+            while (isdigit((unsigned char)*expr->at) != 0)
+            {
+                expr->at++;
+            }
+        }
+        if (*expr->at == 'e' || *expr->at == 'E')
+        {
+            fraction = true;
+            expr->at++;
+            expr->at += *expr->at == '+' || *expr->at == '-';
+            if (isdigit((unsigned char)*expr->at) == 0)
+            {
+                return "malformed number in expression";
+            }
+            while (isdigit((unsigned char)*expr->at) != 0)
+            {
+                expr->at++;
+            }
+        }
+        if (*expr->at == '.' || isalnum((unsigned char)*expr->at) != 0 ||
+            *expr->at == '_')
+        {
+            return "malformed number in expression";
+        }
+        if (expr->f != NULL)
+        {
+            fprintf(expr->f, "%.*s%sf", (int)(expr->at - start), start,
+                    fraction == true ? "" : ".0");
+        }
+    }
+    else if (isalpha((unsigned char)*expr->at) != 0 || *expr->at == '_')
+    {
+        while (isalnum((unsigned char)*expr->at) != 0 || *expr->at == '_')
+        {
+            expr->at++;
+        }
+        size_t const len = (size_t)(expr->at - start);
+        uint32_t param_idx = 0U;
+        while (param_idx < expr->lhs->param_count &&
+               (strlen(expr->lhs->param[param_idx]) != len ||
+                strncmp(expr->lhs->param[param_idx], start, len) != 0))
+        {
+            param_idx++;
+        }
+        if (param_idx == expr->lhs->param_count)
+        {
+            return "expression uses a name the LHS doesn't have";
+        }
+        if (expr->used != NULL)
+        {
+            *expr->used |= 1U << param_idx;
+        }
+        if (expr->f != NULL)
+        {
+            fprintf(expr->f, "p_%.*s[idx]", (int)len, start);
+        }
+    }
+    else if (expr_op(expr, "(") == true)
+    {
+        char const *const err = expr_or(expr);
+        if (err != NULL)
+        {
+            return err;
+        }
+        if (expr_op(expr, ")") == false)
+        {
+            return "unbalanced parentheses in expression";
+        }
+    }
+    else
+    {
+        return "missing operand in expression";
+    }
+    return NULL;
+}
+
+static char const *expr_unary(expr_st *const expr)
+{
+    expr_space(expr);
+    /* C warns of "!a < b" unless the negation is parenthesized. */
+    if (expr->at[0U] == '!' && expr->at[1U] != '=')
+    {
+        expr_emit(expr, "(");
+        expr_op(expr, "!");
+        char const *const err = expr_unary(expr);
+        expr_emit(expr, ")");
+        return err;
+    }
+    if (expr_op(expr, "-") == true || expr_op(expr, "+") == true)
+    {
+        return expr_unary(expr);
+    }
+    return expr_primary(expr);
+}
+
+/**
+ * @brief Parse operands joined by any of some operators of the same
+ * precedence, left to right.
+ * @param expr Parser.
+ * @param operand Parser of the operands, binding tighter.
+ * @param ops Operators, NULL terminated.
+ * @param chain If more than 2 operands may be joined.
+ * @param wrap If operands are parenthesized in the translation.
+ * @return NULL on success, what's wrong otherwise.
+ */
+static char const *expr_binary(expr_st *const expr,
+                               char const *(*const operand)(expr_st *),
+                               char const *const *const ops, bool const chain,
+                               bool const wrap)
+{
+    for (uint32_t joined = 0U;; ++joined)
+    {
+        expr_space(expr);
+        expr_emit(expr, wrap == true ? "(" : "");
+        char const *const err = operand(expr);
+        expr_emit(expr, wrap == true ? ")" : "");
+        if (err != NULL)
+        {
+            return err;
+        }
+        uint32_t op_idx = 0U;
+        while (ops[op_idx] != NULL && expr_op(expr, ops[op_idx]) == false)
+        {
+            op_idx++;
+        }
+        if (ops[op_idx] == NULL)
+        {
+            return NULL;
+        }
+        if (joined > 0U && chain == false)
+        {
+            return "chained comparison in expression";
+        }
+    }
+}
+
+static char const *expr_prod(expr_st *const expr)
+{
+    static char const *const ops[] = {"*", "/", NULL};
+    return expr_binary(expr, expr_unary, ops, true, false);
+}
+
+static char const *expr_sum(expr_st *const expr)
+{
+    static char const *const ops[] = {"+", "-", NULL};
+    return expr_binary(expr, expr_prod, ops, true, false);
+}
+
+static char const *expr_cmp(expr_st *const expr)
+{
+    static char const *const ops[] = {"<=", ">=", "==", "!=",
+                                      "<",  ">",  NULL};
+    return expr_binary(expr, expr_sum, ops, false, false);
+}
+
+static char const *expr_and(expr_st *const expr)
+{
+    static char const *const ops[] = {"&&", NULL};
+    return expr_binary(expr, expr_cmp, ops, true, false);
+}
+
+static char const *expr_or(expr_st *const expr)
+{
+    static char const *const ops[] = {"||", NULL};
+    /* C warns of "a && b || c" unless the conjunctions are parenthesized. */
+    return expr_binary(expr, expr_and, ops, true,
+                       strstr(expr->at, "||") != NULL);
+}
+
+/**
+ * @brief Translate an expression over the parameters of a LHS into C, or only
+ * check it. Numbers become float literals and parameters reads of the batch.
+ * Expressions are arithmetic, comparisons and logic as in C, parsed by
+ * recursive descent so malformed ones fail here rather than in the C compiler.
+ * @param expr Expression to translate.
+ * @param lhs Module whose parameter names the expression may use.
+ * @param f Where to write the C expression, NULL to only check it.
+ * @param used Bits of the parameters used get set, may be NULL.
+ * @return NULL on success, what's wrong otherwise.
+ */
+static char const *expr_translate(char const *expr, module_st const *const lhs,
+                                  FILE *const f, uint32_t *const used)
+{
+    /* Kernels are written with the grammar in comments. */
+    if (strstr(expr, "/*") != NULL || strstr(expr, "*/") != NULL)
+    {
+        return "comment in expression";
+    }
+    expr_st parser = {.at = expr, .lhs = lhs, .f = f, .used = used};
+    char const *const err = expr_or(&parser);
+    if (err != NULL)
+    {
+        return err;
+    }
+    expr_space(&parser);
+    if (*parser.at == ')')
+    {
+        return "unbalanced parentheses in expression";
+    }
+    if (*parser.at != '\0')
+    {
+        return "unexpected character in expression";
+    }
+    return NULL;
+}
+
+/* Declare the parameters of a LHS an expression uses. */
+static void params_emit(FILE *const f, module_st const *const lhs,
+                        uint32_t const used)
+{
+    for (uint32_t param_idx = 0U; param_idx < lhs->param_count; ++param_idx)
+    {
+        if ((used & (1U << param_idx)) != 0U)
+        {
+            fprintf(f, "    float const *const p_%s = batch->param[%uU];\n",
+                    lhs->param[param_idx], param_idx);
+        }
+    }
+}
+
+/* A module as written in the grammar, for comments. */
+static void module_emit(FILE *const f, module_st const *const module)
+{
+    sym_emit(f, module->sym);
+    for (uint32_t param_idx = 0U; param_idx < module->param_count;
+         ++param_idx)
+    {
+        fprintf(f, "%s%s", param_idx == 0U ? "(" : ",",
+                module->param[param_idx]);
+    }
+    fputs(module->param_count > 0U ? ")" : "", f);
+}
+
+/**
+ * @brief Write the kernels of a parametric grammar: a condition and a
+ * successor for every rule, each a loop over a batch of modules with its
+ * expressions inlined, followed by the tables plsystem_st points to.
+ */
+static void pgrammar_emit(FILE *const f, grammar_st const *const grammar)
+{
+    char const *const name = grammar->name;
+    uint32_t arity_max = 0U;
+    for (uint32_t sym = 0U; sym < SYM_COUNT; ++sym)
+    {
+        if (grammar->arity[sym] != ARITY_UNSET &&
+            grammar->arity[sym] > arity_max)
+        {
+            arity_max = grammar->arity[sym];
+        }
+    }
+    fprintf(f,
+            "_Static_assert(PLSYSTEM_PARAM_MAX >= %uU,\n"
+            "               \"%s has more parameters than modules hold\");\n"
+            "\n"
+            "static char const %s_axiom_sym[] = \"",
+            arity_max, name, name);
+    for (uint32_t module_idx = 0U; module_idx < grammar->axiom_count;
+         ++module_idx)
+    {
+        sym_emit(f, grammar->axiom_modules[module_idx].sym);
+    }
+    fprintf(f,
+            "\";\n"
+            "static float const %s_axiom_param[][PLSYSTEM_PARAM_MAX] = {\n",
+            name);
+    for (uint32_t module_idx = 0U; module_idx < grammar->axiom_count;
+         ++module_idx)
+    {
+        module_st const *const module = &grammar->axiom_modules[module_idx];
+        fputs("    {", f);
+        for (uint32_t param_idx = 0U; param_idx < module->param_count;
+             ++param_idx)
+        {
+            fputs(param_idx == 0U ? "" : ", ", f);
+            float_emit(f, strtod(module->param[param_idx], NULL));
+        }
+        /* Initializers can't be empty. */
+        fputs(module->param_count == 0U ? "0.0f},\n" : "},\n", f);
+    }
+    fprintf(f, "};\n\nstatic uint8_t const %s_arity[%uU] = {\n", name,
+            SYM_COUNT);
+    for (uint32_t sym = 0U; sym < SYM_COUNT; ++sym)
+    {
+        if (grammar->arity[sym] != ARITY_UNSET && grammar->arity[sym] > 0U)
+        {
+            fputs("    ['", f);
+            sym_emit(f, (char)sym);
+            fprintf(f, "'] = %uU,\n", grammar->arity[sym]);
+        }
+    }
+    fputs("};\n\n", f);
+
+    /* Start of the signature of a kernel, its parameters are aligned to it. */
+    char head[NAME_LEN_MAX + 32U];
+    for (uint32_t prule_idx = 0U; prule_idx < grammar->ppr_count; ++prule_idx)
+    {
+        pprule_st const *const prule = &grammar->ppr[prule_idx];
+        if (prule->cond[0U] != '\0')
+        {
+            uint32_t used = 0U;
+            expr_translate(prule->cond, &prule->l, NULL, &used);
+            fputs("/* ", f);
+            module_emit(f, &prule->l);
+            int const head_len = snprintf(head, sizeof(head),
+                                          "static void %s_cond%u(", name,
+                                          prule_idx);
+            fprintf(f,
+                    " : %s */\n"
+                    "%splsystem_batch_st const *const batch,\n"
+                    "%*suint8_t *const ok)\n"
+                    "{\n",
+                    prule->cond, head, head_len, "");
+            params_emit(f, &prule->l, used);
+            fputs("    for (uint32_t idx = 0U; idx < batch->count; ++idx)\n"
+                  "    {\n"
+                  "        ok[idx] &= (uint8_t)(",
+                  f);
+            expr_translate(prule->cond, &prule->l, f, NULL);
+            fputs(");\n"
+                  "    }\n"
+                  "}\n\n",
+                  f);
+        }
+
+        uint32_t used = 0U;
+        for (uint32_t module_idx = 0U; module_idx < prule->r_count;
+             ++module_idx)
+        {
+            module_st const *const module = &prule->r[module_idx];
+            for (uint32_t param_idx = 0U; param_idx < module->param_count;
+                 ++param_idx)
+            {
+                expr_translate(module->param[param_idx], &prule->l, NULL,
+                               &used);
+            }
+        }
+        fputs("/* ", f);
+        module_emit(f, &prule->l);
+        fputs(" -> ", f);
+        for (uint32_t module_idx = 0U; module_idx < prule->r_count;
+             ++module_idx)
+        {
+            module_emit(f, &prule->r[module_idx]);
+        }
+        int const head_len = snprintf(head, sizeof(head),
+                                      "static void %s_succ%u(", name,
+                                      prule_idx);
+        fprintf(f,
+                " */\n"
+                "%splsystem_batch_st const *const batch,\n"
+                "%*suint8_t const *const pick, uint8_t const prule,\n"
+                "%*suint32_t const *const dst,\n"
+                "%*splsystem_word_st *const out)\n"
+                "{\n",
+                head, head_len, "", head_len, "", head_len, "");
+        if (prule->r_count == 0U)
+        {
+            fputs("    /* Modules picking the rule are erased. */\n}\n\n", f);
+            continue;
+        }
+        params_emit(f, &prule->l, used);
+        fputs("    for (uint32_t idx = 0U; idx < batch->count; ++idx)\n"
+              "    {\n"
+              "        if (pick[idx] != prule)\n"
+              "        {\n"
+              "            continue;\n"
+              "        }\n"
+              "        uint32_t const at = dst[idx];\n"
+              "        memcpy(&out->sym[at], \"",
+              f);
+        for (uint32_t module_idx = 0U; module_idx < prule->r_count;
+             ++module_idx)
+        {
+            sym_emit(f, prule->r[module_idx].sym);
+        }
+        fprintf(f, "\", %uU);\n", prule->r_count);
+        for (uint32_t module_idx = 0U; module_idx < prule->r_count;
+             ++module_idx)
+        {
+            module_st const *const module = &prule->r[module_idx];
+            for (uint32_t param_idx = 0U; param_idx < module->param_count;
+                 ++param_idx)
+            {
+                fprintf(f, "        out->param[%uU][at", param_idx);
+                if (module_idx > 0U)
+                {
+                    fprintf(f, " + %uU", module_idx);
+                }
+                fputs("] = (float)(", f);
+                expr_translate(module->param[param_idx], &prule->l, f, NULL);
+                fputs(");\n", f);
+            }
+        }
+        fputs("    }\n"
+              "}\n\n",
+              f);
+    }
+
+    fprintf(f, "static plsystem_prule_st const %s_prules[] = {\n", name);
+    for (uint32_t prule_idx = 0U; prule_idx < grammar->ppr_count; ++prule_idx)
+    {
+        pprule_st const *const prule = &grammar->ppr[prule_idx];
+        fputs("    {.l = '", f);
+        sym_emit(f, prule->l.sym);
+        fputs("', .weight = ", f);
+        float_emit(f, prule->weight);
+        fprintf(f, ", .rlen = %uU, .r = \"", prule->r_count);
+        for (uint32_t module_idx = 0U; module_idx < prule->r_count;
+             ++module_idx)
+        {
+            sym_emit(f, prule->r[module_idx].sym);
+        }
+        fputs("\",\n     .cond = ", f);
+        if (prule->cond[0U] != '\0')
+        {
+            fprintf(f, "%s_cond%u", name, prule_idx);
+        }
+        else
+        {
+            fputs("NULL", f);
+        }
+        fprintf(f, ", .succ = %s_succ%u},\n", name, prule_idx);
+    }
+    fputs("};\n\n", f);
+}
+
+/**
+ * @brief Write the header declaring the grammars.
+ * @return 0 on success, -1 on failure.
+ */
+static int header_emit(char const *const path, char const *const path_in,
+                       grammars_st const *const grammars)
+{
+    FILE *const f = fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    fprintf(f,
+            "/* Generated by lsysc from %s, edit that instead. */\n"
+            "#pragma once\n"
+            "\n"
+            "#include \"plsystem.h\"\n",
+            path_in);
+    for (uint32_t parametric = 0U; parametric < 2U; ++parametric)
+    {
+        /* Every kind gets its own enum and table, if it has grammars. */
+        char const *const kind = parametric == 1U ? "plsystem" : "lsystem";
+        char const *const kind_caps = parametric == 1U ? "PLSYSTEM" : "LSYSTEM";
+        uint32_t count = 0U;
+        for (uint32_t grammar_idx = 0U; grammar_idx < grammars->count;
+             ++grammar_idx)
+        {
+            grammar_st const *const grammar = &grammars->g[grammar_idx];
+            if (grammar->parametric != (parametric == 1U))
+            {
+                continue;
+            }
+            if (count++ == 0U)
+            {
+                fprintf(f, "\ntypedef enum %s_grammar_e\n{\n", kind);
+            }
+            fputs("    ", f);
+            enum_emit(f, grammar);
+            fputs(",\n", f);
+        }
+        if (count > 0U)
+        {
+            fprintf(f,
+                    "    %s_GRAMMAR_COUNT,\n"
+                    "} %s_grammar_et;\n"
+                    "\n"
+                    "extern %s_st const %s_grammars[%s_GRAMMAR_COUNT];\n",
+                    kind_caps, kind, kind, kind, kind_caps);
+        }
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Write the source defining the grammars and their rewrites.
+ * @return 0 on success, -1 on failure.
+ */
+static int source_emit(char const *const path, char const *const path_in,
+                       char const *const header,
+                       grammars_st const *const grammars)
+{
+    FILE *const f = fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    fprintf(f,
+            "/* Generated by lsysc from %s, edit that instead. */\n"
+            "#include \"%s\"\n"
+            "#include <string.h>\n"
+            "\n",
+            path_in, header);
+    for (uint32_t grammar_idx = 0U; grammar_idx < grammars->count;
+         ++grammar_idx)
+    {
+        grammar_st const *const grammar = &grammars->g[grammar_idx];
+        if (grammar->parametric == true)
+        {
+            pgrammar_emit(f, grammar);
+            continue;
+        }
+        fprintf(f, "static lsystem_prule_st const %s_prules[] = {\n",
+                grammar->name);
+        for (uint32_t prule_idx = 0U; prule_idx < grammar->pr_count;
+             ++prule_idx)
+        {
+            prule_st const *const prule = &grammar->pr[prule_idx];
+            fputs("    {.l = ", f);
+            str_emit(f, prule->l, (uint32_t)strlen(prule->l));
+            fputs(", .r = ", f);
+            str_emit(f, prule->r, (uint32_t)strlen(prule->r));
+            fputs("},\n", f);
+        }
+        fputs("};\n\n", f);
+        if (grammar_compilable(grammar) == true)
+        {
+            rewrite_emit(f, grammar);
+        }
+        else
+        {
+            fprintf(stderr,
+                    "%s: rules rewrite several symbols or erase them, %s is "
+                    "interpreted\n",
+                    path_in, grammar->name);
+        }
+    }
+
+    uint32_t lsystem_count = 0U;
+    uint32_t plsystem_count = 0U;
+    for (uint32_t grammar_idx = 0U; grammar_idx < grammars->count;
+         ++grammar_idx)
+    {
+        grammar_st const *const grammar = &grammars->g[grammar_idx];
+        if (grammar->parametric == false)
+        {
+            lsystem_count++;
+            continue;
+        }
+        if (plsystem_count++ == 0U)
+        {
+            fputs("plsystem_st const plsystem_grammars[PLSYSTEM_GRAMMAR_COUNT] "
+                  "= {\n",
+                  f);
+        }
+        fputs("    [", f);
+        enum_emit(f, grammar);
+        fprintf(f,
+                "] =\n"
+                "        {\n"
+                "            .axiom_len = %uU,\n"
+                "            .axiom_sym = %s_axiom_sym,\n"
+                "            .axiom_param = %s_axiom_param,\n"
+                "            .arity = %s_arity,\n"
+                "            .iters = %uU,\n"
+                "            .seed = %" PRIu64 "ULL,\n"
+                "            .pr_count = %uU,\n"
+                "            .pr = %s_prules,\n"
+                "        },\n",
+                grammar->axiom_count, grammar->name, grammar->name,
+                grammar->name, grammar->iters, grammar->seed,
+                grammar->ppr_count, grammar->name);
+    }
+    if (plsystem_count > 0U)
+    {
+        fputs("};\n\n", f);
+    }
+    if (lsystem_count == 0U)
+    {
+        return fclose(f) == 0 ? 0 : -1;
+    }
+
+    fputs("lsystem_st const lsystem_grammars[LSYSTEM_GRAMMAR_COUNT] = {\n", f);
+    for (uint32_t grammar_idx = 0U; grammar_idx < grammars->count;
+         ++grammar_idx)
+    {
+        grammar_st const *const grammar = &grammars->g[grammar_idx];
+        if (grammar->parametric == true)
+        {
+            continue;
+        }
+        fputs("    [", f);
+        enum_emit(f, grammar);
+        fputs("] =\n        {\n            .alph = {.w = ", f);
+        str_emit(f, grammar->alph, (uint32_t)strlen(grammar->alph));
+        fprintf(f, ", .wlen = %uU},\n            .axiom = {.w = ",
+                (uint32_t)strlen(grammar->alph));
+        str_emit(f, grammar->axiom, (uint32_t)strlen(grammar->axiom));
+        fprintf(f,
+                ", .wlen = %uU},\n"
+                "            .iters = %uU,\n"
+                "            .pr_count = %uU,\n"
+                "            .pr = &%s_prules,\n",
+                (uint32_t)strlen(grammar->axiom), grammar->iters,
+                grammar->pr_count, grammar->name);
+        if (grammar_compilable(grammar) == true)
+        {
+            fprintf(f, "            .rewrite = %s_rewrite,\n", grammar->name);
+        }
+        else
+        {
+            fputs("            .rewrite = NULL,\n", f);
+        }
+        fputs("        },\n", f);
+    }
+    fputs("};\n", f);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static bool name_valid(char const *const name)
+{
+    if (isalpha((unsigned char)name[0U]) == 0 && name[0U] != '_')
+    {
+        return false;
+    }
+    for (uint32_t name_idx = 1U; name[name_idx] != '\0'; ++name_idx)
+    {
+        if (isalnum((unsigned char)name[name_idx]) == 0 &&
+            name[name_idx] != '_')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Copy a token into a field, failing when it doesn't fit or has symbols other
+ * than printable ASCII, which are all that get emitted as literals.
+ */
+static int word_copy(char *const dst, size_t const dst_len,
+                     char const *const token)
+{
+    if (token == NULL || strlen(token) >= dst_len)
+    {
+        return -1;
+    }
+    for (uint32_t token_idx = 0U; token[token_idx] != '\0'; ++token_idx)
+    {
+        if (isgraph((unsigned char)token[token_idx]) == 0 ||
+            (unsigned char)token[token_idx] > 0x7FU)
+        {
+            return -1;
+        }
+    }
+    strcpy(dst, token);
+    return 0;
+}
+
+/* What follows the first token of a line, without the blanks around it. */
+static char *rest_get(char *const line)
+{
+    char *rest = line + strspn(line, " \t\r\n");
+    rest += strcspn(rest, " \t\r\n");
+    rest += strspn(rest, " \t\r\n");
+    size_t len = strlen(rest);
+    while (len > 0U && isspace((unsigned char)rest[len - 1U]) != 0)
+    {
+        rest[--len] = '\0';
+    }
+    return rest;
+}
+
+/**
+ * @brief Parse a run of modules like F(l,w)[+(25)A(l*0.7,w)], a symbol
+ * followed by its parameters, if any, between parentheses.
+ * @param str Text to parse, blanks between modules are skipped.
+ * @param modules Set to the modules.
+ * @param cap Most modules to parse.
+ * @param count Set to the number of modules.
+ * @return NULL on success, what's wrong otherwise.
+ */
+static char const *modules_parse(char const *str, module_st *const modules,
+                                 uint32_t const cap, uint32_t *const count)
+{
+    *count = 0U;
+    for (str += strspn(str, " \t"); *str != '\0'; str += strspn(str, " \t"))
+    {
+        if (*count >= cap)
+        {
+            return "too many modules";
+        }
+        module_st *const module = &modules[(*count)++];
+        memset(module, 0, sizeof(*module));
+        if (isgraph((unsigned char)*str) == 0 ||
+            (unsigned char)*str > 0x7FU || strchr("(),", *str) != NULL)
+        {
+            return "module must start with a printable symbol";
+        }
+        module->sym = *str++;
+        if (*str != '(')
+        {
+            continue;
+        }
+        str++;
+        for (;;)
+        {
+            if (module->param_count >= PARAM_MAX)
+            {
+                return "too many parameters";
+            }
+            char *const param = module->param[module->param_count++];
+            uint32_t len = 0U;
+            uint32_t depth = 0U;
+            /* A parameter ends at a comma or parenthesis outside of nested
+             * ones. */
+            for (str += strspn(str, " \t");
+                 *str != '\0' &&
+                 (depth > 0U || (*str != ',' && *str != ')'));
+                 ++str)
+            {
+                depth += *str == '(' ? 1U : 0U;
+                depth -= *str == ')' ? 1U : 0U;
+                if (len + 1U >= EXPR_LEN_MAX)
+                {
+                    return "parameter too long";
+                }
+                param[len++] = *str;
+            }
+            while (len > 0U && isspace((unsigned char)param[len - 1U]) != 0)
+            {
+                len--;
+            }
+            param[len] = '\0';
+            if (*str == '\0')
+            {
+                return "unclosed parenthesis";
+            }
+            if (len == 0U)
+            {
+                return "empty parameter";
+            }
+            if (*str++ == ')')
+            {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parse the axiom of a parametric grammar, whose parameters must be
+ * numbers.
+ * @return NULL on success, what's wrong otherwise.
+ */
+static char const *paxiom_parse(grammar_st *const grammar,
+                                char const *const rest)
+{
+    char const *const err = modules_parse(rest, grammar->axiom_modules,
+                                          MODULE_COUNT_MAX,
+                                          &grammar->axiom_count);
+    if (err != NULL)
+    {
+        return err;
+    }
+    for (uint32_t module_idx = 0U; module_idx < grammar->axiom_count;
+         ++module_idx)
+    {
+        module_st const *const module = &grammar->axiom_modules[module_idx];
+        for (uint32_t param_idx = 0U; param_idx < module->param_count;
+             ++param_idx)
+        {
+            char *param_end = NULL;
+            double const param = strtod(module->param[param_idx], &param_end);
+            if (*param_end != '\0' || isfinite(param) == 0 ||
+                fabs(param) > FLT_MAX)
+            {
+                return "axiom parameters must be numbers";
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parse a rule of a parametric grammar:
+ * WEIGHT LHS [: CONDITION] -> RHS
+ * @return NULL on success, what's wrong otherwise.
+ */
+static char const *pprule_parse(grammar_st *const grammar, char *const rest)
+{
+    if (grammar->ppr_count >= PRULE_COUNT_MAX)
+    {
+        return "too many rules";
+    }
+    pprule_st *const prule = &grammar->ppr[grammar->ppr_count++];
+    memset(prule, 0, sizeof(*prule));
+    char *weight_end = NULL;
+    prule->weight = strtod(rest, &weight_end);
+    if (weight_end == rest || isspace((unsigned char)*weight_end) == 0 ||
+        !(prule->weight > 0.0) || prule->weight > FLT_MAX)
+    {
+        return "rule must start with a positive weight";
+    }
+    char *const arrow = strstr(weight_end, "->");
+    if (arrow == NULL)
+    {
+        return "rule needs -> between its LHS and RHS";
+    }
+    *arrow = '\0';
+    char *const colon = strchr(weight_end, ':');
+    if (colon != NULL)
+    {
+        *colon = '\0';
+        char *const cond = colon + 1 + strspn(colon + 1, " \t");
+        if (*cond == '\0' || strlen(cond) >= sizeof(prule->cond))
+        {
+            return "condition empty or too long";
+        }
+        strcpy(prule->cond, cond);
+        for (size_t len = strlen(prule->cond);
+             len > 0U && isspace((unsigned char)prule->cond[len - 1U]) != 0;)
+        {
+            prule->cond[--len] = '\0';
+        }
+    }
+
+    module_st lhs[2U];
+    uint32_t lhs_count = 0U;
+    char const *err = modules_parse(weight_end, lhs, 2U, &lhs_count);
+    if (err != NULL || lhs_count != 1U)
+    {
+        return "LHS must be a single module";
+    }
+    prule->l = lhs[0U];
+    for (uint32_t param_idx = 0U; param_idx < prule->l.param_count;
+         ++param_idx)
+    {
+        if (name_valid(prule->l.param[param_idx]) == false)
+        {
+            return "LHS parameters must be C identifiers";
+        }
+        for (uint32_t other_idx = 0U; other_idx < param_idx; ++other_idx)
+        {
+            if (strcmp(prule->l.param[other_idx],
+                       prule->l.param[param_idx]) == 0)
+            {
+                return "LHS parameter named twice";
+            }
+        }
+    }
+    if (prule->cond[0U] != '\0' &&
+        (err = expr_translate(prule->cond, &prule->l, NULL, NULL)) != NULL)
+    {
+        return err;
+    }
+    if ((err = modules_parse(arrow + 2, prule->r, MODULE_COUNT_MAX,
+                             &prule->r_count)) != NULL)
+    {
+        return err;
+    }
+    for (uint32_t module_idx = 0U; module_idx < prule->r_count; ++module_idx)
+    {
+        module_st const *const module = &prule->r[module_idx];
+        for (uint32_t param_idx = 0U; param_idx < module->param_count;
+             ++param_idx)
+        {
+            if ((err = expr_translate(module->param[param_idx], &prule->l,
+                                      NULL, NULL)) != NULL)
+            {
+                return err;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Record how many parameters the modules of a parametric grammar give
+ * their symbols, failing when a symbol is given different numbers.
+ * @return NULL on success, what's wrong otherwise.
+ */
+static char const *arity_set(grammar_st *const grammar,
+                             module_st const *const modules,
+                             uint32_t const count)
+{
+    for (uint32_t module_idx = 0U; module_idx < count; ++module_idx)
+    {
+        uint8_t *const arity =
+            &grammar->arity[(uint8_t)modules[module_idx].sym];
+        uint8_t const param_count = (uint8_t)modules[module_idx].param_count;
+        if (*arity != ARITY_UNSET && *arity != param_count)
+        {
+            return "symbol given different numbers of parameters";
+        }
+        *arity = param_count;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parse a grammar description, see 001-lsystem/grammars.lsys for the
+ * format.
+ * @param grammars Where to store the grammars.
+ * @param path File to parse.
+ * @return 0 on success, -1 on failure.
+ */
+static int grammars_parse(grammars_st *const grammars, char const *const path)
+{
+    FILE *const f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    grammars->count = 0U;
+    grammar_st *grammar = NULL;
+    char line[LINE_LEN_MAX];
+    uint32_t line_no = 0U;
+    char const *err = NULL;
+    while (err == NULL && fgets(line, sizeof(line), f) != NULL)
+    {
+        line_no++;
+        line[strcspn(line, "#")] = '\0';
+        char raw[LINE_LEN_MAX];
+        strcpy(raw, line);
+        char *const rest = rest_get(raw);
+        char const *const key = strtok(line, " \t\r\n");
+        char const *const val = strtok(NULL, " \t\r\n");
+        char const *const val2 = strtok(NULL, " \t\r\n");
+        char const *const extra = strtok(NULL, " \t\r\n");
+        if (key == NULL)
+        {
+            continue;
+        }
+        /**
+         * Rules take a LHS and a RHS, every other field one value. Axioms and
+         * rules of parametric grammars take the rest of the line.
+         */
+        bool const is_rule = strcmp(key, "rule") == 0;
+        bool const parametric = grammar != NULL && grammar->parametric == true;
+        bool const is_rest =
+            parametric == true &&
+            (strcmp(key, "axiom") == 0 || strcmp(key, "prule") == 0);
+        if (val == NULL || (is_rule == true && val2 == NULL))
+        {
+            err = "missing value";
+        }
+        else if (is_rest == false && (is_rule == true ? extra : val2) != NULL)
+        {
+            err = "too many values";
+        }
+        else if (strcmp(key, "grammar") == 0 || strcmp(key, "pgrammar") == 0)
+        {
+            if (grammars->count >= GRAMMAR_COUNT_MAX)
+            {
+                err = "too many grammars";
+                break;
+            }
+            grammar = &grammars->g[grammars->count++];
+            memset(grammar, 0, sizeof(*grammar));
+            grammar->parametric = strcmp(key, "pgrammar") == 0;
+            memset(grammar->arity, ARITY_UNSET, sizeof(grammar->arity));
+            if (word_copy(grammar->name, sizeof(grammar->name), val) != 0 ||
+                name_valid(grammar->name) == false)
+            {
+                err = "name must be a C identifier";
+            }
+            for (uint32_t grammar_idx = 0U; grammar_idx + 1U < grammars->count;
+                 ++grammar_idx)
+            {
+                if (strcmp(grammars->g[grammar_idx].name, val) == 0)
+                {
+                    err = "grammar defined twice";
+                }
+            }
+        }
+        else if (grammar == NULL)
+        {
+            err = "field outside of a grammar";
+        }
+        else if (strcmp(key, "alphabet") == 0 && parametric == false)
+        {
+            err = word_copy(grammar->alph, sizeof(grammar->alph), val) != 0
+                      ? "alphabet too long or not printable"
+                      : NULL;
+        }
+        else if (strcmp(key, "axiom") == 0 && parametric == true)
+        {
+            err = paxiom_parse(grammar, rest);
+        }
+        else if (strcmp(key, "axiom") == 0)
+        {
+            err = word_copy(grammar->axiom, sizeof(grammar->axiom), val) != 0
+                      ? "axiom too long or not printable"
+                      : NULL;
+        }
+        else if (strcmp(key, "iters") == 0)
+        {
+            char *iters_end = NULL;
+            unsigned long const iters = strtoul(val, &iters_end, 10);
+            if (*iters_end != '\0' || iters > UINT8_MAX)
+            {
+                err = "iters must be a number up to 255";
+            }
+            grammar->iters = (uint32_t)iters;
+            grammar->iters_set = true;
+        }
+        else if (strcmp(key, "seed") == 0 && parametric == true)
+        {
+            char *seed_end = NULL;
+            errno = 0;
+            grammar->seed = strtoull(val, &seed_end, 10);
+            if (*seed_end != '\0' || errno != 0 || val[0U] == '-')
+            {
+                err = "seed must be a number up to 2^64-1";
+            }
+        }
+        else if (strcmp(key, "prule") == 0 && parametric == true)
+        {
+            err = pprule_parse(grammar, rest);
+        }
+        else if (is_rule == true && parametric == false)
+        {
+            if (grammar->pr_count >= PRULE_COUNT_MAX)
+            {
+                err = "too many rules";
+                break;
+            }
+            prule_st *const prule = &grammar->pr[grammar->pr_count++];
+            if (word_copy(prule->l, sizeof(prule->l), val) != 0 ||
+                word_copy(prule->r, sizeof(prule->r), val2) != 0)
+            {
+                err = "rule too long or not printable";
+            }
+        }
+        else
+        {
+            err = "unknown field";
+        }
+    }
+    fclose(f);
+    if (err != NULL)
+    {
+        fprintf(stderr, "%s:%u: %s\n", path, line_no, err);
+        return -1;
+    }
+    for (uint32_t grammar_idx = 0U; grammar_idx < grammars->count;
+         ++grammar_idx)
+    {
+        grammar_st *const g = &grammars->g[grammar_idx];
+        if (g->parametric == true)
+        {
+            char const *perr =
+                arity_set(g, g->axiom_modules, g->axiom_count);
+            for (uint32_t prule_idx = 0U;
+                 perr == NULL && prule_idx < g->ppr_count; ++prule_idx)
+            {
+                perr = arity_set(g, &g->ppr[prule_idx].l, 1U);
+                perr = perr != NULL ? perr
+                                    : arity_set(g, g->ppr[prule_idx].r,
+                                                g->ppr[prule_idx].r_count);
+            }
+            if (g->axiom_count == 0U || g->iters_set == false)
+            {
+                perr = "needs an axiom and iters";
+            }
+            if (perr != NULL)
+            {
+                fprintf(stderr, "%s: grammar %s: %s\n", path, g->name, perr);
+                return -1;
+            }
+            continue;
+        }
+        if (g->axiom[0U] == '\0' || g->iters_set == false)
+        {
+            fprintf(stderr, "%s: grammar %s needs an axiom and iters\n", path,
+                    g->name);
+            return -1;
+        }
+    }
+    if (grammars->count == 0U)
+    {
+        fprintf(stderr, "%s: no grammars\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Compile grammar descriptions into C. Every grammar becomes an lsystem_st of
+ * lsystem_grammars whose rewrite is specialized to its rules, see
+ * rewrite_emit, and every parametric one a plsystem_st of plsystem_grammars
+ * whose rules are kernels over batches of modules, see pgrammar_emit.
+ */
+int main(int const argc, char const *const argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <grammars.lsys> <output prefix>\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    char const *const path_in = argv[1];
+    char const *const prefix = argv[2];
+
+    static grammars_st grammars;
+    if (grammars_parse(&grammars, path_in) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* The source includes the header from the same directory. */
+    char path_h[PATH_LEN_MAX];
+    char path_c[PATH_LEN_MAX];
+    int const len_h = snprintf(path_h, sizeof(path_h), "%s.h", prefix);
+    int const len_c = snprintf(path_c, sizeof(path_c), "%s.c", prefix);
+    if (len_h < 0 || (size_t)len_h >= sizeof(path_h) || len_c < 0 ||
+        (size_t)len_c >= sizeof(path_c))
+    {
+        fprintf(stderr, "Output prefix is too long\n");
+        return EXIT_FAILURE;
+    }
+    char const *const slash = strrchr(path_h, '/');
+    char const *const header = slash == NULL ? path_h : slash + 1;
+    if (header_emit(path_h, path_in, &grammars) != 0 ||
+        source_emit(path_c, path_in, header, &grammars) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", prefix);
+        remove(path_h);
+        remove(path_c);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
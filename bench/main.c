@@ -0,0 +1,777 @@
+#include "amiss.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* How long every benchmark should run for at least, per sample. */
+#define SAMPLE_TIME_MIN 0.05
+/* How many samples are taken, the fastest one is reported. */
+#define SAMPLE_COUNT 5U
+
+/* How many random values one run of the RNG benchmarks generates. */
+#define RNG_COUNT (1024U * 1024U)
+
+/* Side of the layers blended together. */
+#define BLEND_SIZE 2048U
+
+/* Vertices of the star and zigzag the fill benchmarks draw. */
+#define SHAPE_COUNT 256U
+
+/* Side of the images canvases get downsampled to. */
+#define DOWNSAMPLE_SIZE 1024U
+
+/* Where amiss_img_save writes to, it gets deleted afterwards. */
+#define SAVE_PATH "bench.ppm"
+
+/* Lines of the display list replayed, a random walk of short steps. */
+#define DLIST_LINE_COUNT (64U * 1024U)
+/* Side of the canvas the display list is recorded on. */
+#define DLIST_SIZE 2048U
+/* Where the display list is recorded to, it gets deleted afterwards. */
+#define DLIST_PATH "bench.amdl"
+
+/* Sides of the views searched for the display list's lines through a grid. */
+#define GRID_VIEW_SIZE_MIN 32U
+#define GRID_VIEW_SIZE_MAX 512U
+
+typedef enum bench_fmt_e
+{
+    BENCH_FMT_TABLE,
+    BENCH_FMT_CSV,
+} bench_fmt_et;
+
+typedef struct bench_ctx_s
+{
+    amiss_img_st img;
+    /* Per benchmark parameters. */
+    vec2u32_st line_start;
+    vec2u32_st line_end;
+    gradient_st gradient;
+    amiss_rng4_st rng4;
+    uint64_t *rng_buf; /* RNG_COUNT values. */
+    amiss_img_st layer; /* Blended onto img. */
+    amiss_img_st const *mask; /* NULL for none. */
+    vec2u32_st const *shape; /* SHAPE_COUNT vertices. */
+    uint32_t radius;
+    amiss_blend_mode_et blend_mode;
+    amiss_img_st small; /* img downsampled. */
+    uint8_t factor;
+    amiss_resample_filter_et filter;
+    amiss_job_pool_st *pool; /* NULL to downsample on this thread. */
+    amiss_dlist_st dlist;
+    amiss_line_st *lines; /* DLIST_LINE_COUNT lines of the display list. */
+    amiss_backend_st backend; /* Raster canvas the display list is drawn on. */
+    double_t scale;
+    amiss_box_st *boxes; /* Bounds of the display list's lines. */
+    amiss_grid_st grid;
+    amiss_arena_st *arena; /* Where the grid is built. */
+    amiss_box_st view;
+    uint32_t *ids; /* Boxes found in the view. */
+    uint64_t px_count; /* Pixels touched by one run. */
+    uint64_t seg_count; /* Segments drawn by one run. */
+    uint64_t byte_count; /* Bytes moved by one run. */
+} bench_ctx_st;
+
+typedef void bench_fn_ft(bench_ctx_st *const ctx);
+
+static bench_fmt_et bench_fmt = BENCH_FMT_TABLE;
+
+static double_t time_now(void)
+{
+    struct timespec ts;
+#if defined(_WIN32)
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (double_t)ts.tv_sec + ((double_t)ts.tv_nsec * 1e-9);
+}
+
+/**
+ * @brief Time a benchmark. It's run enough times to last at least
+ * SAMPLE_TIME_MIN, and this is repeated SAMPLE_COUNT times.
+ * @param fn Benchmark to run.
+ * @param ctx Context passed to the benchmark.
+ * @return Fastest time of a single run, in seconds.
+ */
+static double_t bench_time(bench_fn_ft *const fn, bench_ctx_st *const ctx)
+{
+    /* Warm up caches and find out how many runs fill one sample. */
+    double_t const t_warm = time_now();
+    fn(ctx);
+    double_t const t_once = time_now() - t_warm;
+    uint64_t const runs =
+        t_once >= SAMPLE_TIME_MIN ? 1U
+                                  : (uint64_t)(SAMPLE_TIME_MIN / t_once) + 1U;
+
+    double_t t_best = INFINITY;
+    for (uint32_t sample_idx = 0U; sample_idx < SAMPLE_COUNT; ++sample_idx)
+    {
+        double_t const t_start = time_now();
+        for (uint64_t run_idx = 0U; run_idx < runs; ++run_idx)
+        {
+            fn(ctx);
+        }
+        double_t const t_run = (time_now() - t_start) / (double_t)runs;
+        if (t_run < t_best)
+        {
+            t_best = t_run;
+        }
+    }
+    return t_best;
+}
+
+/**
+ * @brief Print the result of a benchmark. Throughputs that don't apply to it
+ * are left out.
+ * @param name Name of the benchmark.
+ * @param variant What parameters the benchmark ran with.
+ * @param ctx Context holding the amount of work done by one run.
+ * @param t Time of one run in seconds.
+ */
+static void bench_report(char const *const name, char const *const variant,
+                         bench_ctx_st const *const ctx, double_t const t)
+{
+    double_t const mpx_s =
+        ctx->px_count > 0U ? (double_t)ctx->px_count / t * 1e-6 : NAN;
+    double_t const ns_seg =
+        ctx->seg_count > 0U ? t * 1e9 / (double_t)ctx->seg_count : NAN;
+    double_t const gb_s =
+        ctx->byte_count > 0U ? (double_t)ctx->byte_count / t * 1e-9 : NAN;
+    switch (bench_fmt)
+    {
+    case BENCH_FMT_TABLE:
+        printf("%-16s %-20s %12.1f %12.2f %12.2f %12.3f\n", name, variant,
+               t * 1e6, mpx_s, ns_seg, gb_s);
+        break;
+    case BENCH_FMT_CSV:
+        printf("%s,%s,%.9f,%.3f,%.3f,%.4f\n", name, variant, t, mpx_s, ns_seg,
+               gb_s);
+        break;
+    }
+}
+
+static int ctx_img_create(bench_ctx_st *const ctx, amiss_arena_st *const arena,
+                          uint32_t const size)
+{
+    if (amiss_img_create(&ctx->img, arena, size, size, AMISS_IMG_FMT_PPM) != 0)
+    {
+        return -1;
+    }
+    memset(ctx->img.b, 0U, ctx->img.blen);
+    ctx->px_count = 0U;
+    ctx->seg_count = 0U;
+    ctx->byte_count = 0U;
+    return 0;
+}
+
+static void bench_px_set(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    for (uint32_t y = 0U; y < ctx->img.h; ++y)
+    {
+        for (uint32_t x = 0U; x < ctx->img.w; ++x)
+        {
+            amiss_draw_px_set(&ctx->img, color, x, y);
+        }
+    }
+}
+
+static void bench_line(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    for (uint64_t seg_idx = 0U; seg_idx < ctx->seg_count; ++seg_idx)
+    {
+        amiss_draw_line(&ctx->img, color, 1.0, false, ctx->line_start,
+                        ctx->line_end);
+    }
+}
+
+static void bench_polygon(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    amiss_draw_polygon(&ctx->img, color, ctx->shape, SHAPE_COUNT,
+                       AMISS_DRAW_FILL_NONZERO);
+}
+
+static void bench_circle(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    vec2u32_st const center = {.x = ctx->img.w / 2U, .y = ctx->img.h / 2U};
+    amiss_draw_circle(&ctx->img, color, center, ctx->radius);
+}
+
+/* The same circle pixel by pixel, for comparison. */
+static void bench_circle_px(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    int64_t const r = ctx->radius;
+    int64_t const limit = (r * r) + r;
+    for (int64_t dy = -r; dy <= r; ++dy)
+    {
+        for (int64_t dx = -r; dx <= r; ++dx)
+        {
+            if ((dx * dx) + (dy * dy) <= limit)
+            {
+                amiss_draw_px_set(&ctx->img, color,
+                                  (uint32_t)((ctx->img.w / 2U) + dx),
+                                  (uint32_t)((ctx->img.h / 2U) + dy));
+            }
+        }
+    }
+}
+
+static void bench_polyline(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    amiss_draw_polyline(&ctx->img, color, ctx->shape, SHAPE_COUNT, 8.0);
+}
+
+/**
+ * @brief Count the pixels a benchmark draws, by drawing once on a black image.
+ * @return Number of pixels that are no longer black.
+ */
+static uint64_t bench_px_drawn(bench_fn_ft *const fn, bench_ctx_st *const ctx)
+{
+    memset(ctx->img.b, 0U, ctx->img.blen);
+    fn(ctx);
+    uint64_t count = 0U;
+    for (uint32_t px_idx = 0U; px_idx < ctx->img.blen; px_idx += 3U /* RGB */)
+    {
+        count += (ctx->img.b[px_idx] | ctx->img.b[px_idx + 1U] |
+                  ctx->img.b[px_idx + 2U]) != 0U;
+    }
+    return count;
+}
+
+static void bench_bg_gradient(bench_ctx_st *const ctx)
+{
+    amiss_draw_bg_gradient(&ctx->img, ctx->gradient);
+}
+
+static void bench_flip_vert(bench_ctx_st *const ctx)
+{
+    amiss_img_flip_vert(&ctx->img);
+}
+
+static void bench_save(bench_ctx_st *const ctx)
+{
+    if (amiss_img_save(&ctx->img, SAVE_PATH) != 0)
+    {
+        fprintf(stderr, "Failed to save image\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void bench_rng_u64(bench_ctx_st *const ctx)
+{
+    amiss_rng4_fill_u64(&ctx->rng4, ctx->rng_buf, RNG_COUNT);
+}
+
+static void bench_rng_f64(bench_ctx_st *const ctx)
+{
+    amiss_rng4_fill_f64(&ctx->rng4, (double *)ctx->rng_buf, RNG_COUNT);
+}
+
+static void bench_rng_bits(bench_ctx_st *const ctx)
+{
+    amiss_rng4_fill_bits(&ctx->rng4, ctx->rng_buf, RNG_COUNT, 0.3);
+}
+
+static void bench_blend(bench_ctx_st *const ctx)
+{
+    amiss_blend(&ctx->img, &ctx->layer, ctx->blend_mode, 200U, ctx->mask);
+}
+
+static void bench_downsample(bench_ctx_st *const ctx)
+{
+    amiss_img_downsample(&ctx->small, &ctx->img, ctx->factor, ctx->filter,
+                         ctx->pool);
+}
+
+/**
+ * @brief Time downsampling a canvas of random pixels to DOWNSAMPLE_SIZE.
+ * @return 0 on success, -1 on failure.
+ */
+static int bench_downsample_report(bench_ctx_st *const ctx,
+                                   amiss_arena_st *const arena,
+                                   amiss_img_fmt_et const fmt,
+                                   char const *const variant)
+{
+    uint32_t const size = DOWNSAMPLE_SIZE * ctx->factor;
+    if (amiss_img_create(&ctx->img, arena, size, size, fmt) != 0 ||
+        amiss_img_create(&ctx->small, arena, DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE,
+                         fmt) != 0)
+    {
+        return -1;
+    }
+    amiss_rng4_fill_u64(&ctx->rng4, (uint64_t *)ctx->img.b,
+                        ctx->img.blen / sizeof(uint64_t));
+    /* Throughput is of the canvas read and the downsampled image written. */
+    ctx->px_count = (uint64_t)size * size;
+    ctx->seg_count = 0U;
+    ctx->byte_count = ctx->img.blen + ctx->small.blen;
+    bench_report("downsample", variant, ctx, bench_time(bench_downsample, ctx));
+    amiss_arena_reset(arena);
+    return 0;
+}
+
+static void bench_dlist_draw(bench_ctx_st *const ctx)
+{
+    color_st const color = {.r = 200U, .g = 100U, .b = 50U};
+    amiss_backend_lines(&ctx->backend, color, ctx->lines, DLIST_LINE_COUNT);
+}
+
+static void bench_dlist_replay(bench_ctx_st *const ctx)
+{
+    amiss_dlist_replay(&ctx->dlist, &ctx->backend, ctx->scale);
+}
+
+static void bench_dlist_render(bench_ctx_st *const ctx)
+{
+    amiss_dlist_render(&ctx->dlist, &ctx->backend.img, ctx->scale, ctx->pool);
+}
+
+/**
+ * @brief Record a random walk of lines to a display list and time drawing it
+ * again, against drawing the lines straight away.
+ * @return 0 on success, -1 on failure.
+ */
+static int bench_dlist(bench_ctx_st *const ctx, amiss_arena_st *const arena,
+                       amiss_job_pool_st *const pool)
+{
+    ctx->lines =
+        amiss_arena_alloc(arena, DLIST_LINE_COUNT * sizeof(ctx->lines[0U]));
+    if (ctx->lines == NULL)
+    {
+        return -1;
+    }
+    amiss_rng_st rng;
+    amiss_rng_seed(&rng, 1U);
+    vec2u32_st pos = {.a = {DLIST_SIZE / 2U, DLIST_SIZE / 2U}};
+    for (uint32_t line_idx = 0U; line_idx < DLIST_LINE_COUNT; ++line_idx)
+    {
+        vec2u32_st const start = pos;
+        for (uint32_t axis = 0U; axis < 2U; ++axis)
+        {
+            int64_t const step = (int64_t)(amiss_rng_u64(&rng) % 17U) - 8;
+            int64_t const coord = (int64_t)pos.a[axis] + step;
+            pos.a[axis] = coord < 0 || coord >= DLIST_SIZE ? pos.a[axis]
+                                                           : (uint32_t)coord;
+        }
+        ctx->lines[line_idx] =
+            (amiss_line_st){.start = start, .end = pos, .width = 1.0};
+    }
+
+    /* Record the lines and map them back in. */
+    if (amiss_backend_create(&ctx->backend, AMISS_BACKEND_RECORD, arena,
+                             DLIST_SIZE, DLIST_SIZE) != 0)
+    {
+        return -1;
+    }
+    bench_dlist_draw(ctx);
+    int ret = amiss_backend_save(&ctx->backend, DLIST_PATH);
+    amiss_backend_destroy(&ctx->backend);
+    if (ret != 0 || amiss_dlist_open(&ctx->dlist, DLIST_PATH) != 0)
+    {
+        remove(DLIST_PATH);
+        return -1;
+    }
+
+    struct
+    {
+        char const *variant;
+        bench_fn_ft *fn;
+        double_t scale;
+        amiss_job_pool_st *pool;
+    } const runs[] = {
+        {"draw", bench_dlist_draw, 1.0, NULL},
+        {"replay", bench_dlist_replay, 1.0, NULL},
+        {"render", bench_dlist_render, 1.0, NULL},
+        {"render+pool", bench_dlist_render, 1.0, pool},
+        {"render@2x+pool", bench_dlist_render, 2.0, pool},
+    };
+    for (uint32_t run_idx = 0U;
+         ret == 0 && run_idx < sizeof(runs) / sizeof(runs[0U]); ++run_idx)
+    {
+        uint32_t const size =
+            (uint32_t)lround(DLIST_SIZE * runs[run_idx].scale);
+        ret = amiss_backend_create(&ctx->backend, AMISS_BACKEND_RASTER, arena,
+                                   size, size);
+        if (ret != 0)
+        {
+            break;
+        }
+        memset(ctx->backend.img.b, 0U, ctx->backend.img.blen);
+        ctx->scale = runs[run_idx].scale;
+        ctx->pool = runs[run_idx].pool;
+        ctx->px_count = 0U;
+        ctx->seg_count = DLIST_LINE_COUNT;
+        ctx->byte_count = 0U;
+        bench_report("dlist", runs[run_idx].variant, ctx,
+                     bench_time(runs[run_idx].fn, ctx));
+        amiss_backend_destroy(&ctx->backend);
+    }
+    amiss_dlist_close(&ctx->dlist);
+    remove(DLIST_PATH);
+    return ret;
+}
+
+static void bench_grid_build(bench_ctx_st *const ctx)
+{
+    amiss_arena_reset(ctx->arena);
+    amiss_grid_build(&ctx->grid, ctx->arena, ctx->boxes, DLIST_LINE_COUNT);
+}
+
+static void bench_grid_query(bench_ctx_st *const ctx)
+{
+    amiss_grid_query(&ctx->grid, ctx->view, ctx->ids);
+}
+
+/* What the grid saves, going through every box. */
+static void bench_grid_scan(bench_ctx_st *const ctx)
+{
+    uint32_t count = 0U;
+    for (uint32_t box_idx = 0U; box_idx < DLIST_LINE_COUNT; ++box_idx)
+    {
+        amiss_box_st const box = ctx->boxes[box_idx];
+        if (box.x1 >= ctx->view.x0 && box.x0 <= ctx->view.x1 &&
+            box.y1 >= ctx->view.y0 && box.y0 <= ctx->view.y1)
+        {
+            ctx->ids[count++] = box_idx;
+        }
+    }
+}
+
+/**
+ * @brief Index the bounds of the display list's lines in a grid and time
+ * finding the ones in a view, against checking every one of them.
+ * @return 0 on success, -1 on failure.
+ */
+static int bench_grid(bench_ctx_st *const ctx, amiss_arena_st *const arena)
+{
+    ctx->boxes =
+        amiss_arena_alloc(arena, DLIST_LINE_COUNT * sizeof(ctx->boxes[0U]));
+    ctx->ids =
+        amiss_arena_alloc(arena, DLIST_LINE_COUNT * sizeof(ctx->ids[0U]));
+    if (ctx->boxes == NULL || ctx->ids == NULL)
+    {
+        return -1;
+    }
+    for (uint32_t line_idx = 0U; line_idx < DLIST_LINE_COUNT; ++line_idx)
+    {
+        amiss_line_st const line = ctx->lines[line_idx];
+        ctx->boxes[line_idx] = (amiss_box_st){
+            .x0 = line.start.x < line.end.x ? line.start.x : line.end.x,
+            .y0 = line.start.y < line.end.y ? line.start.y : line.end.y,
+            .x1 = line.start.x < line.end.x ? line.end.x : line.start.x,
+            .y1 = line.start.y < line.end.y ? line.end.y : line.start.y,
+        };
+    }
+    /* Grids get their own arena as building one resets it. */
+    amiss_arena_st grid_arena;
+    if (amiss_arena_init(&grid_arena, 1024U * 1024U, AMISS_ARENA_FLAG_NONE) !=
+        0)
+    {
+        return -1;
+    }
+    ctx->arena = &grid_arena;
+    ctx->px_count = 0U;
+    ctx->seg_count = DLIST_LINE_COUNT;
+    ctx->byte_count = 0U;
+    bench_report("grid", "build", ctx, bench_time(bench_grid_build, ctx));
+
+    /* The walk starts in the middle, so views there are never empty. */
+    for (uint32_t size = GRID_VIEW_SIZE_MIN; size <= GRID_VIEW_SIZE_MAX;
+         size *= 4U)
+    {
+        uint32_t const view_start = (DLIST_SIZE - size) / 2U;
+        ctx->view = (amiss_box_st){.x0 = view_start,
+                                   .y0 = view_start,
+                                   .x1 = view_start + size - 1U,
+                                   .y1 = view_start + size - 1U};
+        ctx->seg_count = amiss_grid_query(&ctx->grid, ctx->view, ctx->ids);
+        char variant[32U];
+        snprintf(variant, sizeof(variant), "query@%u", size);
+        bench_report("grid", variant, ctx, bench_time(bench_grid_query, ctx));
+        snprintf(variant, sizeof(variant), "scan@%u", size);
+        bench_report("grid", variant, ctx, bench_time(bench_grid_scan, ctx));
+    }
+    amiss_arena_free(&grid_arena);
+    return 0;
+}
+
+int main(int const argc, char const *const argv[])
+{
+    for (int arg_idx = 1; arg_idx < argc; ++arg_idx)
+    {
+        if (strcmp(argv[arg_idx], "--csv") == 0)
+        {
+            bench_fmt = BENCH_FMT_CSV;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--csv]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    switch (bench_fmt)
+    {
+    case BENCH_FMT_TABLE:
+        printf("%-16s %-20s %12s %12s %12s %12s\n", "name", "variant",
+               "us/run", "Mpx/s", "ns/segment", "GB/s");
+        break;
+    case BENCH_FMT_CSV:
+        printf("name,variant,s_per_run,mpx_per_s,ns_per_segment,gb_per_s\n");
+        break;
+    }
+
+    amiss_arena_st arena;
+    if (amiss_arena_init(&arena, 64U * 1024U * 1024U, AMISS_ARENA_FLAG_NONE) !=
+        0)
+    {
+        return EXIT_FAILURE;
+    }
+    bench_ctx_st ctx;
+    char variant[64U];
+    uint32_t const sizes[] = {256U, 1024U, 4096U};
+
+    for (uint32_t size_idx = 0U; size_idx < sizeof(sizes) / sizeof(sizes[0U]);
+         ++size_idx)
+    {
+        uint32_t const size = sizes[size_idx];
+        snprintf(variant, sizeof(variant), "%ux%u", size, size);
+        if (ctx_img_create(&ctx, &arena, size) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        uint64_t const px_count = (uint64_t)size * size;
+        uint64_t const byte_count = px_count * amiss_img_depth(&ctx.img);
+
+        ctx.px_count = px_count;
+        bench_report("px_set", variant, &ctx, bench_time(bench_px_set, &ctx));
+
+        double_t const stops[] = {0.0, 0.3, 1.0};
+        color_st const colors[] = {
+            {.a = {247U, 248U, 239U}},
+            {.a = {213U, 219U, 173U}},
+            {.a = {4U, 6U, 11U}},
+        };
+        ctx.gradient =
+            (gradient_st){.count = 3U, .stops = stops, .colors = colors};
+        ctx.byte_count = byte_count;
+        bench_report("bg_gradient", variant, &ctx,
+                     bench_time(bench_bg_gradient, &ctx));
+
+        /* Flipping reads and writes every byte once. */
+        ctx.px_count = px_count;
+        ctx.byte_count = byte_count * 2U;
+        bench_report("flip_vert", variant, &ctx,
+                     bench_time(bench_flip_vert, &ctx));
+
+        ctx.px_count = px_count;
+        ctx.byte_count = byte_count;
+        bench_report("save", variant, &ctx, bench_time(bench_save, &ctx));
+        amiss_arena_reset(&arena);
+    }
+    remove(SAVE_PATH);
+
+    /* Lines at various slopes and lengths, all starting in the middle. */
+    uint32_t const line_size = 2048U;
+    if (ctx_img_create(&ctx, &arena, line_size) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    uint32_t const lens[] = {8U, 64U, 512U};
+    double_t const angles[] = {0.0, 15.0, 30.0, 45.0, 60.0, 90.0};
+    for (uint32_t len_idx = 0U; len_idx < sizeof(lens) / sizeof(lens[0U]);
+         ++len_idx)
+    {
+        for (uint32_t angle_idx = 0U;
+             angle_idx < sizeof(angles) / sizeof(angles[0U]); ++angle_idx)
+        {
+            double_t const angle = angles[angle_idx] * (M_PI / 180.0);
+            ctx.line_start =
+                (vec2u32_st){.x = line_size / 2U, .y = line_size / 2U};
+            ctx.line_end = (vec2u32_st){
+                .x = (uint32_t)lround(ctx.line_start.x +
+                                      (cos(angle) * lens[len_idx])),
+                .y = (uint32_t)lround(ctx.line_start.y +
+                                      (sin(angle) * lens[len_idx])),
+            };
+            /* Enough segments per run for the timer to resolve it. */
+            ctx.seg_count = 1024U;
+            ctx.byte_count = 0U;
+            uint32_t const px_per_seg = amiss_draw_line(
+                &ctx.img, (color_st){.a = {0U, 0U, 0U}}, 1.0, false,
+                ctx.line_start, ctx.line_end);
+            ctx.px_count = ctx.seg_count * (px_per_seg + 1U);
+            snprintf(variant, sizeof(variant), "len%u@%.0fdeg", lens[len_idx],
+                     angles[angle_idx]);
+            bench_report("line", variant, &ctx, bench_time(bench_line, &ctx));
+        }
+    }
+
+    /* Filled shapes, throughput is of the pixels inside. */
+    vec2u32_st shape[SHAPE_COUNT];
+    ctx.shape = shape;
+    ctx.seg_count = 0U;
+    ctx.byte_count = 0U;
+    ctx.radius = line_size / 2U - 1U;
+    ctx.px_count = bench_px_drawn(bench_circle, &ctx);
+    snprintf(variant, sizeof(variant), "circle@r%u", ctx.radius);
+    bench_report("fill", variant, &ctx, bench_time(bench_circle, &ctx));
+    snprintf(variant, sizeof(variant), "circle@r%u+px_set", ctx.radius);
+    bench_report("fill", variant, &ctx, bench_time(bench_circle_px, &ctx));
+    /* A concave star, points alternate between two radii. */
+    for (uint32_t pt_idx = 0U; pt_idx < SHAPE_COUNT; ++pt_idx)
+    {
+        double_t const angle = pt_idx * (2.0 * M_PI / SHAPE_COUNT);
+        double_t const r = (pt_idx % 2U == 0U ? 0.48 : 0.2) * line_size;
+        shape[pt_idx] = (vec2u32_st){
+            .x = (uint32_t)lround((line_size / 2.0) + (r * cos(angle))),
+            .y = (uint32_t)lround((line_size / 2.0) + (r * sin(angle))),
+        };
+    }
+    ctx.px_count = bench_px_drawn(bench_polygon, &ctx);
+    snprintf(variant, sizeof(variant), "star%u", SHAPE_COUNT);
+    bench_report("fill", variant, &ctx, bench_time(bench_polygon, &ctx));
+    /* A zigzag across the canvas, joins are as dense as the vertices. */
+    for (uint32_t pt_idx = 0U; pt_idx < SHAPE_COUNT; ++pt_idx)
+    {
+        shape[pt_idx] = (vec2u32_st){
+            .x = 16U + (pt_idx * ((line_size - 32U) / SHAPE_COUNT)),
+            .y = pt_idx % 2U == 0U ? 16U : line_size - 16U,
+        };
+    }
+    ctx.px_count = bench_px_drawn(bench_polyline, &ctx);
+    snprintf(variant, sizeof(variant), "polyline%u@w8", SHAPE_COUNT);
+    bench_report("fill", variant, &ctx, bench_time(bench_polyline, &ctx));
+
+    amiss_arena_reset(&arena);
+
+    /* Bulk random fills, throughput is of the values written. */
+    amiss_rng_st rng;
+    amiss_rng_seed(&rng, 0U);
+    amiss_rng4_init(&ctx.rng4, &rng);
+    ctx.rng_buf = amiss_arena_alloc(&arena, RNG_COUNT * sizeof(uint64_t));
+    if (ctx.rng_buf == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    ctx.px_count = 0U;
+    ctx.seg_count = 0U;
+    ctx.byte_count = RNG_COUNT * sizeof(uint64_t);
+    bench_report("rng_fill", "u64", &ctx, bench_time(bench_rng_u64, &ctx));
+    bench_report("rng_fill", "f64", &ctx, bench_time(bench_rng_f64, &ctx));
+    bench_report("rng_fill", "bits@0.3", &ctx,
+                 bench_time(bench_rng_bits, &ctx));
+
+    amiss_arena_reset(&arena);
+
+    /* Translucent layers, throughput is of both layers read and one written. */
+    amiss_img_st mask;
+    if (amiss_img_create(&ctx.img, &arena, BLEND_SIZE, BLEND_SIZE,
+                         AMISS_IMG_FMT_ARGB32) != 0 ||
+        amiss_img_create(&ctx.layer, &arena, BLEND_SIZE, BLEND_SIZE,
+                         AMISS_IMG_FMT_ARGB32) != 0 ||
+        amiss_img_create(&mask, &arena, BLEND_SIZE, BLEND_SIZE,
+                         AMISS_IMG_FMT_A8) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    amiss_rng4_fill_u64(&ctx.rng4, (uint64_t *)ctx.layer.b,
+                        ctx.layer.blen / sizeof(uint64_t));
+    amiss_rng4_fill_u64(&ctx.rng4, (uint64_t *)mask.b,
+                        mask.blen / sizeof(uint64_t));
+    memset(ctx.img.b, 0x80U, ctx.img.blen);
+    /* Premultiplied colors can't exceed their alpha. */
+    for (uint32_t px_idx = 0U; px_idx < ctx.layer.blen; px_idx += 4U)
+    {
+        uint8_t *const px = &ctx.layer.b[px_idx];
+        px[0U] = px[0U] < px[3U] ? px[0U] : px[3U];
+        px[1U] = px[1U] < px[3U] ? px[1U] : px[3U];
+        px[2U] = px[2U] < px[3U] ? px[2U] : px[3U];
+    }
+    char const *const blend_names[] = {"over", "add", "multiply", "screen"};
+    ctx.px_count = (uint64_t)BLEND_SIZE * BLEND_SIZE;
+    ctx.seg_count = 0U;
+    ctx.byte_count = ctx.px_count * 4U /* ARGB */ * 3U;
+    for (uint32_t mode = 0U;
+         mode < sizeof(blend_names) / sizeof(blend_names[0U]); ++mode)
+    {
+        ctx.blend_mode = (amiss_blend_mode_et)mode;
+        ctx.mask = NULL;
+        bench_report("blend", blend_names[mode], &ctx,
+                     bench_time(bench_blend, &ctx));
+    }
+    ctx.blend_mode = AMISS_BLEND_OVER;
+    ctx.mask = &mask;
+    bench_report("blend", "over+mask", &ctx, bench_time(bench_blend, &ctx));
+
+    amiss_arena_reset(&arena);
+
+    /* Supersampled canvases, by every factor and filter. */
+    char const *const filter_names[] = {"box", "lanczos"};
+    ctx.pool = NULL;
+    for (uint8_t factor = AMISS_RESAMPLE_FACTOR_MIN;
+         factor <= AMISS_RESAMPLE_FACTOR_MAX; ++factor)
+    {
+        for (uint32_t filter = 0U;
+             filter < sizeof(filter_names) / sizeof(filter_names[0U]);
+             ++filter)
+        {
+            ctx.factor = factor;
+            ctx.filter = (amiss_resample_filter_et)filter;
+            snprintf(variant, sizeof(variant), "%s%ux", filter_names[filter],
+                     factor);
+            if (bench_downsample_report(&ctx, &arena, AMISS_IMG_FMT_PPM,
+                                        variant) != 0)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    ctx.factor = 3U;
+    ctx.filter = AMISS_RESAMPLE_LANCZOS;
+    if (bench_downsample_report(&ctx, &arena, AMISS_IMG_FMT_ARGB32,
+                                "lanczos3x+argb") != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    /* Bands spread over a worker per CPU. */
+    amiss_job_pool_st pool;
+    if (amiss_job_pool_init(&pool, 0U, 0U, 1024U * 1024U,
+                            AMISS_ARENA_FLAG_NONE) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    ctx.pool = &pool;
+    if (bench_downsample_report(&ctx, &arena, AMISS_IMG_FMT_PPM,
+                                "lanczos3x+pool") != 0)
+    {
+        amiss_job_pool_free(&pool);
+        return EXIT_FAILURE;
+    }
+    amiss_arena_reset(&arena);
+
+    /* Display lists drawn again, on this thread and in strips by the pool. */
+    if (bench_dlist(&ctx, &arena, &pool) != 0)
+    {
+        amiss_job_pool_free(&pool);
+        return EXIT_FAILURE;
+    }
+    amiss_job_pool_free(&pool);
+
+    /* The same lines found in a view through a grid. */
+    if (bench_grid(&ctx, &arena) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    amiss_arena_free(&arena);
+    return EXIT_SUCCESS;
+}
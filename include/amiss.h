@@ -1,5 +1,15 @@
 #pragma once
 
+#include "amiss/arena.h"
+#include "amiss/backend.h"
+#include "amiss/blend.h"
 #include "amiss/debug.h"
+#include "amiss/dlist.h"
 #include "amiss/draw.h"
+#include "amiss/grid.h"
 #include "amiss/img.h"
+#include "amiss/job.h"
+#include "amiss/preview.h"
+#include "amiss/resample.h"
+#include "amiss/rng.h"
+#include "amiss/stage.h"
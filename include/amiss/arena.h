@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Alignment of every allocation made from an arena. */
+#define AMISS_ARENA_ALIGN 64U
+
+typedef enum amiss_arena_flag_e
+{
+    AMISS_ARENA_FLAG_NONE = 0U,
+    /**
+     * Map chunks directly with mmap and ask for huge pages, falls back to
+     * regular pages (or malloc where mmap is not available).
+     */
+    AMISS_ARENA_FLAG_HUGE = 1U << 0U,
+} amiss_arena_flag_et;
+
+typedef struct amiss_arena_chunk_s amiss_arena_chunk_st;
+struct amiss_arena_chunk_s
+{
+    amiss_arena_chunk_st *next;
+    size_t size;    /* Usable bytes after the header. */
+    size_t used;    /* Bytes handed out so far. */
+    size_t map_len; /* Length of the mapping, 0 if allocated with malloc. */
+};
+
+/**
+ * A linear allocator. Memory is handed out from large chunks by bumping an
+ * offset and is only given back all at once by resetting the arena. Chunks are
+ * kept on reset and reused by the next job.
+ */
+typedef struct amiss_arena_s
+{
+    amiss_arena_chunk_st *head; /* First chunk. */
+    amiss_arena_chunk_st *cur;  /* Chunk allocations are made from. */
+    size_t chunk_size;          /* Default size of a new chunk. */
+    uint32_t flags;
+    void *last; /* Latest allocation, it can grow in place. */
+} amiss_arena_st;
+
+int amiss_arena_init(amiss_arena_st *const arena, size_t const chunk_size,
+                     uint32_t const flags);
+void *amiss_arena_alloc(amiss_arena_st *const arena, size_t const size);
+void *amiss_arena_realloc(amiss_arena_st *const arena, void *const ptr,
+                          size_t const size_old, size_t const size_new);
+void amiss_arena_reset(amiss_arena_st *const arena);
+void amiss_arena_free(amiss_arena_st *const arena);
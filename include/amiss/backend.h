@@ -0,0 +1,128 @@
+#pragma once
+
+#include "amiss/arena.h"
+#include "amiss/draw.h"
+#include "amiss/img.h"
+#include "amiss/resample.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* How much larger the supersample backend draws than the output, 2 to 4. */
+#define AMISS_BACKEND_SS_FACTOR 3U
+/* Filter the supersample backend downsamples with. */
+#define AMISS_BACKEND_SS_FILTER AMISS_RESAMPLE_LANCZOS
+
+/* Declared by plutovg, only pointers are kept so its header isn't needed. */
+struct plutovg_surface;
+struct plutovg;
+/* Declared in amiss/dlist.h, which needs the types declared here. */
+struct amiss_dlist_recorder_s;
+
+typedef enum amiss_backend_kind_e
+{
+    AMISS_BACKEND_RASTER, /* amiss drawing into a PPM image. */
+    AMISS_BACKEND_VECTOR, /* plutovg rendering into a PNG. */
+    /**
+     * Like vector but backgrounds are filled by amiss straight into the
+     * surface, which is quicker than going through plutovg paths.
+     */
+    AMISS_BACKEND_HYBRID,
+    /**
+     * Like raster but drawn AMISS_BACKEND_SS_FACTOR times larger and
+     * downsampled when saved, which antialiases the output.
+     */
+    AMISS_BACKEND_SUPERSAMPLE,
+    /**
+     * Draws nothing, saves what was asked of it as a display list that can be
+     * drawn again later, see amiss/dlist.h.
+     */
+    AMISS_BACKEND_RECORD,
+    AMISS_BACKEND_NULL, /* Draws and saves nothing, only counts calls. */
+    AMISS_BACKEND_COUNT,
+} amiss_backend_kind_et;
+
+typedef struct amiss_line_s
+{
+    vec2u32_st start;
+    vec2u32_st end;
+    double_t width;
+} amiss_line_st;
+
+/* What was asked of a backend, kept up to date by every backend. */
+typedef struct amiss_backend_stats_s
+{
+    uint64_t lines;
+    uint64_t rects;
+    uint64_t gradients;
+    uint64_t saves;
+} amiss_backend_stats_st;
+
+typedef struct amiss_backend_s amiss_backend_st;
+
+typedef struct amiss_backend_ops_s
+{
+    char const *name;
+    char const *ext; /* Extension of the files written by save. */
+    /* Bytes of pixels a canvas of the backend takes per pixel. */
+    uint8_t depth;
+    void (*lines)(amiss_backend_st *const backend, color_st const color,
+                  amiss_line_st const *const lines, uint32_t const count);
+    void (*fill_rect)(amiss_backend_st *const backend, color_st const color,
+                      uint32_t const x, uint32_t const y, uint32_t const w,
+                      uint32_t const h);
+    void (*gradient)(amiss_backend_st *const backend,
+                     gradient_st const gradient);
+    int (*save)(amiss_backend_st *const backend, char const *const path);
+    void (*destroy)(amiss_backend_st *const backend);
+} amiss_backend_ops_st;
+
+/**
+ * Canvas drawn through a table of operations picked at runtime, so the same
+ * code can rasterize a preview, render the final vector image or skip drawing
+ * altogether to time everything else.
+ */
+struct amiss_backend_s
+{
+    amiss_backend_ops_st const *ops;
+    amiss_backend_kind_et kind;
+    uint32_t w;
+    uint32_t h;
+    amiss_backend_stats_st stats;
+    /**
+     * Pixels of the canvas, vector backends share them with their surface.
+     * Drawn larger than the canvas by the supersample backend.
+     */
+    amiss_img_st img;
+    /* Downsampled pixels saved by the supersample backend. */
+    amiss_img_st out;
+    struct
+    {
+        struct plutovg_surface *surface;
+        struct plutovg *pluto;
+    } vector;
+    struct amiss_dlist_recorder_s *recorder; /* Allocated from the arena. */
+};
+
+int amiss_backend_kind_parse(char const *const name,
+                             amiss_backend_kind_et *const kind);
+char const *amiss_backend_ext(amiss_backend_kind_et const kind);
+size_t amiss_backend_mem(amiss_backend_kind_et const kind, uint32_t const w,
+                         uint32_t const h);
+
+int amiss_backend_create(amiss_backend_st *const backend,
+                         amiss_backend_kind_et const kind,
+                         amiss_arena_st *const arena, uint32_t const w,
+                         uint32_t const h);
+void amiss_backend_lines(amiss_backend_st *const backend, color_st const color,
+                         amiss_line_st const *const lines,
+                         uint32_t const count);
+void amiss_backend_fill_rect(amiss_backend_st *const backend,
+                             color_st const color, uint32_t const x,
+                             uint32_t const y, uint32_t const w,
+                             uint32_t const h);
+void amiss_backend_gradient(amiss_backend_st *const backend,
+                            gradient_st const gradient);
+int amiss_backend_save(amiss_backend_st *const backend, char const *const path);
+uint8_t *amiss_backend_pixels(amiss_backend_st const *const backend,
+                              size_t *const len);
+void amiss_backend_destroy(amiss_backend_st *const backend);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "amiss/img.h"
+#include <stdint.h>
+
+/**
+ * How a layer is combined with what's under it. Both are premultiplied, every
+ * mode applies the same formula to the color channels and to alpha.
+ */
+typedef enum amiss_blend_mode_e
+{
+    AMISS_BLEND_OVER,     /* s + d * (1 - sa) */
+    AMISS_BLEND_ADD,      /* s + d, saturated */
+    AMISS_BLEND_MULTIPLY, /* s * d + s * (1 - da) + d * (1 - sa) */
+    AMISS_BLEND_SCREEN,   /* s + d - s * d */
+} amiss_blend_mode_et;
+
+int amiss_blend(amiss_img_st const *const dst, amiss_img_st const *const src,
+                amiss_blend_mode_et const mode, uint8_t const alpha,
+                amiss_img_st const *const mask);
+int amiss_blend_fade(amiss_img_st const *const img, uint8_t const alpha,
+                     amiss_img_st const *const mask);
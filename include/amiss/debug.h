@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -15,12 +16,24 @@
 #define CLR_TXT(clr, txt) clr txt CLR_DEF
 #define CLR_VAR(txt) CLR_CYN txt CLR_DEF
 
+void amiss_log_write(char const *const color, char const *const level_str,
+                     char const *const tag, int const line,
+                     char const *const file, char const *const fmt, ...)
+    __attribute__((format(printf, 6, 7)));
+
+/**
+ * Log calls only capture their arguments into a ring private to the calling
+ * thread, a background thread formats and prints them in the order they were
+ * made. Lines never interleave and strings are truncated to a few hundred
+ * bytes so logging long words stays cheap. All arguments but the variadic ones
+ * have to be string literals.
+ */
 #ifdef DEBUG
 #define LOG_FMT(color, level_str, tag, fmt, ...)                               \
     do                                                                         \
     {                                                                          \
-        printf(color "|%-8s|%-5s|%4d:%-16s|" CLR_DEF fmt, tag, level_str,      \
-               __LINE__, __FILE__, ##__VA_ARGS__);                             \
+        amiss_log_write(color, level_str, tag, __LINE__, __FILE__, fmt,        \
+                        ##__VA_ARGS__);                                        \
     } while (0)
 #else
 #define LOG_FMT(color, level_str, tag, fmt, ...)                               \
@@ -37,3 +50,49 @@
     LOG_FMT(CLR_RED, "ERROR", tag, fmt, ##__VA_ARGS__)
 #define log_dbg(tag, fmt, ...)                                                 \
     LOG_FMT(CLR_GRN, "DEBUG", tag, fmt, ##__VA_ARGS__)
+
+/**
+ * Profiler, compiled in only when AMISS_PROF is defined (see the all-prof
+ * targets). Without it PROF_SCOPE and PROF_COUNT expand to nothing.
+ *
+ * PROF_SCOPE times the rest of the enclosing block, PROF_COUNT adds to one of
+ * the counters. Both record into buffers private to the calling thread. At exit
+ * everything is written as Chrome trace JSON to the file named by
+ * AMISS_PROF_ENV (or AMISS_PROF_PATH_DEFAULT), open it in chrome://tracing or
+ * Perfetto.
+ */
+#define AMISS_PROF_ENV "AMISS_PROF_FILE"
+#define AMISS_PROF_PATH_DEFAULT "amiss_prof.json"
+
+typedef enum amiss_prof_counter_e
+{
+    AMISS_PROF_COUNTER_SEGMENTS, /* Line segments drawn. */
+    AMISS_PROF_COUNTER_PIXELS,   /* Pixels written. */
+    AMISS_PROF_COUNTER_BYTES,    /* Bytes saved to files. */
+    AMISS_PROF_COUNTER_SYMBOLS,  /* Symbols emitted by word rewrites. */
+    AMISS_PROF_COUNTER_COUNT,
+} amiss_prof_counter_et;
+
+typedef struct amiss_prof_scope_s
+{
+    char const *name; /* Has to outlive the program e.g. a string literal. */
+    uint64_t t_begin;
+} amiss_prof_scope_st;
+
+amiss_prof_scope_st amiss_prof_scope_begin(char const *const name);
+void amiss_prof_scope_end(amiss_prof_scope_st const *const scope);
+void amiss_prof_count(amiss_prof_counter_et const counter, uint64_t const n);
+
+#define PROF_CAT_(a, b) a##b
+#define PROF_CAT(a, b) PROF_CAT_(a, b)
+
+#ifdef AMISS_PROF
+#define PROF_SCOPE(name)                                                       \
+    amiss_prof_scope_st const PROF_CAT(prof_scope_, __LINE__)                  \
+        __attribute__((cleanup(amiss_prof_scope_end))) =                       \
+            amiss_prof_scope_begin(name)
+#define PROF_COUNT(counter, n) amiss_prof_count(counter, n)
+#else
+#define PROF_SCOPE(name) (void)0
+#define PROF_COUNT(counter, n) (void)0
+#endif
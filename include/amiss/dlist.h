@@ -0,0 +1,122 @@
+#pragma once
+
+#include "amiss/backend.h"
+#include "amiss/draw.h"
+#include "amiss/img.h"
+#include "amiss/job.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Display lists are files of recorded draw calls, so geometry that is slow to
+ * generate can be drawn again at another scale or by another backend. A file
+ * is a header followed by ops, every op is an amiss_dlist_op_st followed by
+ * count items of its payload. All fields are in the byte order of the machine
+ * that recorded them and ops start on 4 byte boundaries, so the file can be
+ * mapped and read in place.
+ */
+#define AMISS_DLIST_MAGIC "AMDL"
+/* Bumped whenever the layout of the file changes. */
+#define AMISS_DLIST_VERSION 1U
+/* Written as is, it reads back differently on a machine of another endian. */
+#define AMISS_DLIST_BYTE_ORDER 0x01020304U
+
+typedef enum amiss_dlist_op_kind_e
+{
+    AMISS_DLIST_OP_LINES = 1, /* Payload is amiss_dlist_line_st. */
+    AMISS_DLIST_OP_RECT,      /* Payload is one amiss_dlist_rect_st. */
+    AMISS_DLIST_OP_GRADIENT,  /* Payload is amiss_dlist_stop_st. */
+    AMISS_DLIST_OP_END,
+} amiss_dlist_op_kind_et;
+
+typedef struct amiss_dlist_header_s
+{
+    char magic[4U];
+    uint16_t version;
+    uint16_t header_len; /* Bytes before the first op. */
+    uint32_t byte_order; /* AMISS_DLIST_BYTE_ORDER */
+    uint32_t w;          /* Size of the canvas the ops were recorded on. */
+    uint32_t h;
+    uint32_t op_count;
+    uint64_t body_len; /* Bytes of all ops. */
+} amiss_dlist_header_st;
+
+typedef struct amiss_dlist_op_s
+{
+    uint8_t kind;
+    uint8_t rgb[3U];
+    uint32_t count;
+} amiss_dlist_op_st;
+
+typedef struct amiss_dlist_line_s
+{
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+    float width; /* Single precision keeps lines small, plenty for widths. */
+} amiss_dlist_line_st;
+
+typedef struct amiss_dlist_rect_s
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t w;
+    uint32_t h;
+} amiss_dlist_rect_st;
+
+typedef struct amiss_dlist_stop_s
+{
+    double_t pos; /* Copied out, ops are only aligned for 32-bit fields. */
+    uint8_t rgb[3U];
+    uint8_t pad[5U];
+} amiss_dlist_stop_st;
+
+/* Ops being recorded, kept in memory until they are saved. */
+typedef struct amiss_dlist_recorder_s
+{
+    uint32_t w;
+    uint32_t h;
+    uint8_t *b; /* Ops, as they are laid out in the file. */
+    size_t len;
+    size_t cap;
+    uint32_t op_count;
+    bool failed; /* Set when an op couldn't be recorded, saving then fails. */
+} amiss_dlist_recorder_st;
+
+/* A display list file mapped into memory. */
+typedef struct amiss_dlist_s
+{
+    uint8_t const *map;
+    size_t map_len;
+    uint32_t w;
+    uint32_t h;
+    uint32_t op_count;
+    uint8_t const *body; /* First op. */
+    size_t body_len;
+} amiss_dlist_st;
+
+void amiss_dlist_recorder_init(amiss_dlist_recorder_st *const rec,
+                               uint32_t const w, uint32_t const h);
+void amiss_dlist_record_lines(amiss_dlist_recorder_st *const rec,
+                              color_st const color,
+                              amiss_line_st const *const lines,
+                              uint32_t const count);
+void amiss_dlist_record_rect(amiss_dlist_recorder_st *const rec,
+                             color_st const color, uint32_t const x,
+                             uint32_t const y, uint32_t const w,
+                             uint32_t const h);
+void amiss_dlist_record_gradient(amiss_dlist_recorder_st *const rec,
+                                 gradient_st const gradient);
+int amiss_dlist_recorder_save(amiss_dlist_recorder_st const *const rec,
+                              char const *const path);
+void amiss_dlist_recorder_free(amiss_dlist_recorder_st *const rec);
+
+int amiss_dlist_open(amiss_dlist_st *const dlist, char const *const path);
+void amiss_dlist_close(amiss_dlist_st *const dlist);
+int amiss_dlist_replay(amiss_dlist_st const *const dlist,
+                       amiss_backend_st *const backend, double_t const scale);
+int amiss_dlist_render(amiss_dlist_st const *const dlist,
+                       amiss_img_st const *const img, double_t const scale,
+                       amiss_job_pool_st *const pool);
@@ -32,10 +32,25 @@ typedef struct color_s
 typedef struct gradient_st
 {
     uint8_t count;
-    double_t *stops;
-    color_st *colors;
+    double_t const *stops;
+    color_st const *colors;
 } gradient_st;
 
+/* How parts of a polygon that overlap themselves are filled. */
+typedef enum amiss_draw_fill_e
+{
+    AMISS_DRAW_FILL_EVEN_ODD, /* Inside where an odd number of edges enclose. */
+    AMISS_DRAW_FILL_NONZERO,  /* Inside where edges don't cancel out. */
+} amiss_draw_fill_et;
+
+/* Largest radius of circles and ellipses. */
+#define AMISS_DRAW_RADIUS_MAX 16384U
+/**
+ * Polygons and polylines with a coordinate past this are not drawn, which
+ * keeps their fixed point math within 64 bits.
+ */
+#define AMISS_DRAW_COORD_MAX (1U << 20U)
+
 void amiss_draw_px_set(amiss_img_st const *const img, color_st const color,
                        uint32_t const x, uint32_t const y);
 
@@ -46,5 +61,34 @@ uint32_t amiss_draw_line(amiss_img_st const *const img, color_st const color,
                          double_t const thickness, bool const antialias,
                          vec2u32_st const start, vec2u32_st const end);
 
+void amiss_draw_line_window(amiss_img_st const *const img, color_st const color,
+                            vec2u32_st const origin, vec2u32_st const start,
+                            vec2u32_st const end);
+
+void amiss_draw_span_h(amiss_img_st const *const img, color_st const color,
+                       uint32_t const x_start, uint32_t const x_end,
+                       uint32_t const y);
+
+void amiss_draw_span_v(amiss_img_st const *const img, color_st const color,
+                       uint32_t const x, uint32_t const y_start,
+                       uint32_t const y_end);
+
+bool amiss_draw_gradient_valid(gradient_st const gradient);
+
 void amiss_draw_bg_gradient(amiss_img_st const *const img,
                             gradient_st const gradient);
+
+int amiss_draw_polygon(amiss_img_st const *const img, color_st const color,
+                       vec2u32_st const *const pts, uint32_t const count,
+                       amiss_draw_fill_et const fill);
+
+void amiss_draw_ellipse(amiss_img_st const *const img, color_st const color,
+                        vec2u32_st const center, uint32_t const rx,
+                        uint32_t const ry);
+
+void amiss_draw_circle(amiss_img_st const *const img, color_st const color,
+                       vec2u32_st const center, uint32_t const r);
+
+int amiss_draw_polyline(amiss_img_st const *const img, color_st const color,
+                        vec2u32_st const *const pts, uint32_t const count,
+                        double_t const width);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "amiss/arena.h"
+#include <stdint.h>
+
+/* Smallest and largest side of a grid cell, as a power of two. */
+#define AMISS_GRID_CELL_SHIFT_MIN 2U
+#define AMISS_GRID_CELL_SHIFT_MAX 24U
+
+/* Axis aligned box, both corners are inside of it. */
+typedef struct amiss_box_s
+{
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+} amiss_box_st;
+
+/**
+ * Uniform grid of square cells over a set of boxes, e.g. the bounds of
+ * segments, so the ones overlapping a viewport can be found without going
+ * through all of them. Every cell lists the boxes overlapping it, all lists are
+ * packed back to back in one array.
+ */
+typedef struct amiss_grid_s
+{
+    amiss_box_st const *boxes; /* Indexed boxes, they must outlive the grid. */
+    uint32_t box_count;
+    amiss_box_st bounds;  /* Of all boxes, where the first cell starts. */
+    uint8_t cell_shift;   /* Cells are 2^cell_shift pixels wide and high. */
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t *cell_first; /* Per cell, where its list starts in ids. */
+    uint32_t *ids;        /* Indices of boxes, ascending within a cell. */
+} amiss_grid_st;
+
+int amiss_grid_build(amiss_grid_st *const grid, amiss_arena_st *const arena,
+                     amiss_box_st const *const boxes, uint32_t const count);
+uint32_t amiss_grid_query(amiss_grid_st const *const grid,
+                          amiss_box_st const view, uint32_t *const ids);
@@ -1,23 +1,62 @@
 #pragma once
 
+#include "amiss/arena.h"
 #include <stdint.h>
 
+/* Declared by plutovg, only pointers are used so its header isn't needed. */
+struct plutovg_surface;
+
 typedef enum amiss_img_fmt_e
 {
-    AMISS_IMG_FMT_PPM
+    AMISS_IMG_FMT_PPM, /* Packed RGB bytes. */
+    /**
+     * Premultiplied ARGB in native-endian 32-bit words, the layout of plutovg
+     * surfaces, so an image and a surface can share one buffer. Saved to PPM
+     * without alpha i.e. as if composited over black.
+     */
+    AMISS_IMG_FMT_ARGB32,
+    AMISS_IMG_FMT_A8 /* Coverage e.g. of a blend mask, saved as gray. */
 } amiss_img_fmt_et;
 
+/**
+ * Order of rows in the image buffer. Drawing is unaffected by it, with
+ * bottom-up images y simply grows upwards. Writers honor it by emitting rows in
+ * reverse order, so no pixels have to be moved to change the origin.
+ */
+typedef enum amiss_img_orient_e
+{
+    AMISS_IMG_ORIENT_TOP_DOWN, /* First row in the buffer is the top one. */
+    AMISS_IMG_ORIENT_BOTTOM_UP /* First row in the buffer is the bottom one. */
+} amiss_img_orient_et;
+
 typedef struct amiss_img_s
 {
     uint32_t w;
     uint32_t h;
     uint32_t blen;
     uint8_t *b;
+    /**
+     * Bytes from the start of one row to the start of the next, 0 when rows
+     * are packed back to back.
+     */
+    uint32_t stride;
     amiss_img_fmt_et fmt;
+    amiss_img_orient_et orient;
 } amiss_img_st;
 
+int amiss_img_create(amiss_img_st *const img, amiss_arena_st *const arena,
+                     uint32_t const w, uint32_t const h,
+                     amiss_img_fmt_et const fmt);
 uint8_t amiss_img_depth(amiss_img_st const *const img);
+uint32_t amiss_img_stride(amiss_img_st const *const img);
+void amiss_img_px_encode(amiss_img_st const *const img, uint8_t *const px,
+                         uint8_t const r, uint8_t const g, uint8_t const b);
+void amiss_img_px_decode(amiss_img_st const *const img, uint8_t const *const px,
+                         uint8_t *const r, uint8_t *const g, uint8_t *const b);
 uint32_t amiss_img_xy2idx(amiss_img_st const *const img, uint8_t const depth,
                           uint32_t const x, uint32_t const y);
 int amiss_img_save(amiss_img_st const *const img, char const *const path);
 void amiss_img_flip_vert(amiss_img_st const *const img);
+int amiss_img_from_surface(amiss_img_st *const img,
+                           struct plutovg_surface *const surface);
+struct plutovg_surface *amiss_img_to_surface(amiss_img_st const *const img);
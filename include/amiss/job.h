@@ -0,0 +1,84 @@
+#pragma once
+
+#include "amiss/arena.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Work done by a job.
+ * @param arg Argument given with the job.
+ * @param arena Scratch arena of the worker running the job, it gets reset once
+ * the job returns.
+ * @return 0 on success, anything else on failure.
+ */
+typedef int amiss_job_fn_ft(void *const arg, amiss_arena_st *const arena);
+
+typedef struct amiss_job_s
+{
+    amiss_job_fn_ft *fn;
+    void *arg;
+    /**
+     * Upper bound of the memory the job needs, it's held against the budget of
+     * the pool while the job runs. 0 if negligible.
+     */
+    size_t mem;
+    int ret; /* Set to what fn returned once the job ran. */
+} amiss_job_st;
+
+/**
+ * Jobs a worker owns. The worker takes from the tail, idle workers steal from
+ * the head so they take the jobs that were queued first.
+ */
+typedef struct amiss_job_deque_s
+{
+    pthread_mutex_t lock;
+    amiss_job_st **jobs;
+    uint32_t cap;
+    uint32_t head;
+    uint32_t tail;
+} amiss_job_deque_st;
+
+typedef struct amiss_job_pool_s amiss_job_pool_st;
+
+typedef struct amiss_job_worker_s
+{
+    amiss_job_pool_st *pool;
+    uint32_t idx;
+    pthread_t thread;
+    amiss_job_deque_st deque;
+    amiss_arena_st arena;
+} amiss_job_worker_st;
+
+/**
+ * Work-stealing thread pool. Jobs are spread over the deques of the workers and
+ * workers that run out steal from the others. A job only starts while the
+ * memory held by running jobs, plus what outlives jobs (see
+ * amiss_job_pool_hold), plus its own stays within the budget. A job that
+ * doesn't fit even then runs once no other job is running.
+ */
+struct amiss_job_pool_s
+{
+    uint32_t worker_count;
+    amiss_job_worker_st *workers;
+    size_t mem_budget; /* 0 for no limit. */
+
+    pthread_mutex_t lock; /* Guards everything below. */
+    pthread_cond_t cond;  /* Signaled on new jobs, finished jobs and stop. */
+    size_t mem_used; /* By running jobs and held. */
+    uint32_t running;
+    uint32_t queued;  /* Jobs sitting in deques. */
+    uint32_t pending; /* Jobs of the current run not finished yet. */
+    bool stop;
+};
+
+int amiss_job_pool_init(amiss_job_pool_st *const pool,
+                        uint32_t const worker_count, size_t const mem_budget,
+                        size_t const arena_chunk_size,
+                        uint32_t const arena_flags);
+int amiss_job_pool_run(amiss_job_pool_st *const pool, amiss_job_st *const jobs,
+                       uint32_t const job_count);
+void amiss_job_pool_hold(amiss_job_pool_st *const pool, size_t const mem);
+void amiss_job_pool_release(amiss_job_pool_st *const pool, size_t const mem);
+void amiss_job_pool_free(amiss_job_pool_st *const pool);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "amiss/img.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary PPM file mapped into memory that images are shown in as they get
+ * refined, so a viewer reloading the file sees the latest one. Images of any
+ * size are scaled to the size of the file. Every image shown comes with the
+ * stage of refinement it belongs to and never replaces one of a later stage,
+ * so stages may finish in any order.
+ */
+typedef struct amiss_preview_s
+{
+    uint8_t *map; /* Whole file, header and pixels. */
+    size_t map_len;
+    uint8_t *px; /* Packed RGB rows from the top, right after the header. */
+    uint32_t w;
+    uint32_t h;
+    pthread_mutex_t lock; /* Guards the pixels and stage. */
+    int32_t stage;        /* Of the image shown, -1 before the first. */
+} amiss_preview_st;
+
+int amiss_preview_open(amiss_preview_st *const preview, char const *const path,
+                       uint32_t const w, uint32_t const h);
+int amiss_preview_show(amiss_preview_st *const preview,
+                       amiss_img_st const *const img, uint32_t const stage);
+void amiss_preview_close(amiss_preview_st *const preview);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "amiss/img.h"
+#include "amiss/job.h"
+#include <stdint.h>
+
+/* Factors an image can be downsampled by in one go. */
+#define AMISS_RESAMPLE_FACTOR_MIN 2U
+#define AMISS_RESAMPLE_FACTOR_MAX 4U
+
+typedef enum amiss_resample_filter_e
+{
+    AMISS_RESAMPLE_BOX, /* Mean of every block of factor by factor pixels. */
+    /**
+     * Separable Lanczos with 3 lobes, sharper than box at the cost of slight
+     * ringing along hard edges.
+     */
+    AMISS_RESAMPLE_LANCZOS,
+} amiss_resample_filter_et;
+
+int amiss_img_downsample(amiss_img_st const *const dst,
+                         amiss_img_st const *const src, uint8_t const factor,
+                         amiss_resample_filter_et const filter,
+                         amiss_job_pool_st *const pool);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * xoshiro256** generator. Its output only depends on the seed, never on the
+ * platform or libc, and it has no global state so every thread can own one.
+ */
+typedef struct amiss_rng_s
+{
+    uint64_t s[4U];
+} amiss_rng_st;
+
+/**
+ * Four xoshiro256** generators advanced together, lane i starts i jumps after
+ * the generator it was created from. Steps are vectorized when built with AVX2
+ * and produce exactly the same values as the scalar path.
+ */
+typedef struct amiss_rng4_s
+{
+    uint64_t s[4U][4U]; /* Indexed by state word, then lane. */
+} amiss_rng4_st;
+
+void amiss_rng_seed(amiss_rng_st *const rng, uint64_t const seed);
+void amiss_rng_stream(amiss_rng_st *const rng, uint64_t const seed,
+                      uint32_t const stream);
+void amiss_rng_jump(amiss_rng_st *const rng);
+void amiss_rng_long_jump(amiss_rng_st *const rng);
+uint64_t amiss_rng_u64(amiss_rng_st *const rng);
+uint32_t amiss_rng_u32(amiss_rng_st *const rng);
+uint32_t amiss_rng_below(amiss_rng_st *const rng, uint32_t const bound);
+double amiss_rng_f64(amiss_rng_st *const rng);
+uint64_t amiss_rng_at(uint64_t const key, uint64_t const counter);
+double amiss_rng_at_f64(uint64_t const key, uint64_t const counter);
+
+void amiss_rng4_init(amiss_rng4_st *const rng4, amiss_rng_st *const rng);
+void amiss_rng4_fill_u64(amiss_rng4_st *const rng4, uint64_t *const out,
+                         size_t const count);
+void amiss_rng4_fill_u32(amiss_rng4_st *const rng4, uint32_t *const out,
+                         size_t const count);
+void amiss_rng4_fill_f64(amiss_rng4_st *const rng4, double *const out,
+                         size_t const count);
+void amiss_rng4_fill_bits(amiss_rng4_st *const rng4, uint64_t *const out,
+                          size_t const count, double const p);
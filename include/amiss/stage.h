@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Stage timings and output hashes are only collected when this environment
+ * variable names a file, they get written to it at exit.
+ */
+#define AMISS_STAGE_ENV "AMISS_STAGE_FILE"
+
+/* Starting value of a hash computed with amiss_hash. */
+#define AMISS_HASH_INIT 0xCBF29CE484222325U
+
+typedef enum amiss_stage_e
+{
+    AMISS_STAGE_EXPAND,    /* Generating what to draw e.g. rewriting words. */
+    AMISS_STAGE_INTERPRET, /* Turning it into geometry. */
+    AMISS_STAGE_RASTERIZE, /* Drawing the geometry. */
+    AMISS_STAGE_SAVE,      /* Writing the image out. */
+    AMISS_STAGE_COUNT,
+} amiss_stage_et;
+
+uint64_t amiss_stage_now(void);
+void amiss_stage_end(amiss_stage_et const stage, uint64_t const t_begin);
+void amiss_stage_output(char const *const path, uint64_t const hash);
+int amiss_stage_enabled(void);
+uint64_t amiss_hash(uint64_t const hash, uint8_t const *const b,
+                    size_t const len);
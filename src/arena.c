@@ -0,0 +1,260 @@
+#include "amiss.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+/* Size chunks get rounded up to when mapped with huge pages. */
+#define HUGE_PAGE_SIZE (2U * 1024U * 1024U)
+
+static size_t align_up(size_t const size, size_t const align)
+{
+    return (size + align - 1U) & ~(align - 1U);
+}
+
+/**
+ * @brief Get the start of the usable memory of a chunk, it directly follows the
+ * chunk header.
+ * @param chunk Chunk to get the memory of.
+ * @return Pointer to the usable memory.
+ */
+static uint8_t *chunk_data(amiss_arena_chunk_st *const chunk)
+{
+    return (uint8_t *)align_up((uintptr_t)(chunk + 1U), AMISS_ARENA_ALIGN);
+}
+
+/**
+ * @brief Create a new chunk.
+ * @param size How many usable bytes the chunk should have.
+ * @param flags Arena flags deciding how the chunk is backed.
+ * @return The chunk on success, NULL on failure.
+ */
+static amiss_arena_chunk_st *chunk_create(size_t const size,
+                                          uint32_t const flags)
+{
+    /* Room for the header and aligning the data after it. */
+    size_t const len =
+        sizeof(amiss_arena_chunk_st) + AMISS_ARENA_ALIGN + size;
+    amiss_arena_chunk_st *chunk = NULL;
+    size_t map_len = 0U;
+
+#if !defined(_WIN32)
+    if ((flags & AMISS_ARENA_FLAG_HUGE) != 0U)
+    {
+        map_len = align_up(len, HUGE_PAGE_SIZE);
+        void *map = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+        map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (map == MAP_FAILED)
+        {
+            /* No huge pages reserved, let transparent huge pages kick in. */
+            map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#if defined(MADV_HUGEPAGE)
+            if (map != MAP_FAILED)
+            {
+                madvise(map, map_len, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        if (map == MAP_FAILED)
+        {
+            log_warn("AMISS_ARENA", "Failed to map chunk, using malloc\n");
+            map_len = 0U;
+        }
+        else
+        {
+            chunk = map;
+        }
+    }
+#endif
+    if (chunk == NULL)
+    {
+        chunk = malloc(len);
+        if (chunk == NULL)
+        {
+            log_err("AMISS_ARENA", "Failed to allocate chunk\n");
+            return NULL;
+        }
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0U;
+    chunk->map_len = map_len;
+    return chunk;
+}
+
+static void chunk_destroy(amiss_arena_chunk_st *const chunk)
+{
+#if !defined(_WIN32)
+    if (chunk->map_len > 0U)
+    {
+        munmap(chunk, chunk->map_len);
+        return;
+    }
+#endif
+    free(chunk);
+}
+
+/**
+ * @brief Initialize an arena. No memory is reserved until the first
+ * allocation.
+ * @param arena Arena to initialize.
+ * @param chunk_size Size of chunks the arena allocates from the system.
+ * Allocations larger than this get a chunk of their own.
+ * @param flags Combination of amiss_arena_flag_et values.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_arena_init(amiss_arena_st *const arena, size_t const chunk_size,
+                     uint32_t const flags)
+{
+    if (chunk_size == 0U)
+    {
+        log_err("AMISS_ARENA", "Chunk size can't be 0\n");
+        return -1;
+    }
+    arena->head = NULL;
+    arena->cur = NULL;
+    arena->chunk_size = align_up(chunk_size, AMISS_ARENA_ALIGN);
+    arena->flags = flags;
+    arena->last = NULL;
+    return 0;
+}
+
+/**
+ * @brief Allocate memory from an arena. It stays valid until the arena gets
+ * reset or freed.
+ * @param arena Arena to allocate from.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to memory aligned to AMISS_ARENA_ALIGN on success, NULL on
+ * failure.
+ */
+void *amiss_arena_alloc(amiss_arena_st *const arena, size_t const size)
+{
+    size_t const size_aligned =
+        align_up(size == 0U ? 1U : size, AMISS_ARENA_ALIGN);
+
+    /**
+     * Chunks after the current one are left over from before a reset, they
+     * get emptied as they are reached.
+     */
+    amiss_arena_chunk_st *chunk = arena->cur;
+    while (chunk != NULL && chunk->used + size_aligned > chunk->size)
+    {
+        chunk = chunk->next;
+        if (chunk != NULL)
+        {
+            chunk->used = 0U;
+        }
+    }
+
+    if (chunk == NULL)
+    {
+        chunk = chunk_create(size_aligned > arena->chunk_size
+                                 ? size_aligned
+                                 : arena->chunk_size,
+                             arena->flags);
+        if (chunk == NULL)
+        {
+            return NULL;
+        }
+        if (arena->cur == NULL)
+        {
+            chunk->next = arena->head;
+            arena->head = chunk;
+        }
+        else
+        {
+            chunk->next = arena->cur->next;
+            arena->cur->next = chunk;
+        }
+    }
+
+    uint8_t *const ptr = chunk_data(chunk) + chunk->used;
+    chunk->used += size_aligned;
+    arena->cur = chunk;
+    arena->last = ptr;
+    return ptr;
+}
+
+/**
+ * @brief Resize an allocation made from an arena. The latest allocation grows
+ * or shrinks in place while it fits in its chunk, others get copied to a new
+ * allocation and the old memory is only reclaimed on reset.
+ * @param arena Arena the allocation was made from.
+ * @param ptr Allocation to resize, NULL to make a new one.
+ * @param size_old Current size of the allocation.
+ * @param size_new Size the allocation should have.
+ * @return Pointer to the resized allocation on success, NULL on failure (the
+ * old allocation is left untouched).
+ */
+void *amiss_arena_realloc(amiss_arena_st *const arena, void *const ptr,
+                          size_t const size_old, size_t const size_new)
+{
+    if (ptr == NULL)
+    {
+        return amiss_arena_alloc(arena, size_new);
+    }
+    if (ptr == arena->last)
+    {
+        amiss_arena_chunk_st *const chunk = arena->cur;
+        size_t const used_new =
+            (size_t)((uint8_t *)ptr - chunk_data(chunk)) +
+            align_up(size_new == 0U ? 1U : size_new, AMISS_ARENA_ALIGN);
+        if (used_new <= chunk->size)
+        {
+            chunk->used = used_new;
+            return ptr;
+        }
+    }
+    if (size_new <= size_old)
+    {
+        return ptr;
+    }
+
+    void *const ptr_new = amiss_arena_alloc(arena, size_new);
+    if (ptr_new == NULL)
+    {
+        return NULL;
+    }
+    memcpy(ptr_new, ptr, size_old);
+    return ptr_new;
+}
+
+/**
+ * @brief Give back all memory allocated from an arena at once. Chunks are kept
+ * for later allocations, this only rewinds to the first chunk.
+ * @param arena Arena to reset.
+ */
+void amiss_arena_reset(amiss_arena_st *const arena)
+{
+    if (arena->head != NULL)
+    {
+        arena->head->used = 0U;
+    }
+    arena->cur = arena->head;
+    arena->last = NULL;
+}
+
+/**
+ * @brief Return all chunks of an arena to the system.
+ * @param arena Arena to free.
+ */
+void amiss_arena_free(amiss_arena_st *const arena)
+{
+    amiss_arena_chunk_st *chunk = arena->head;
+    while (chunk != NULL)
+    {
+        amiss_arena_chunk_st *const next = chunk->next;
+        chunk_destroy(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->cur = NULL;
+    arena->last = NULL;
+}
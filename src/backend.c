@@ -0,0 +1,482 @@
+#include "amiss.h"
+#include "plutovg.h"
+#include <string.h>
+
+static void raster_lines(amiss_backend_st *const backend, color_st const color,
+                         amiss_line_st const *const lines,
+                         uint32_t const count)
+{
+    for (uint32_t line_idx = 0U; line_idx < count; ++line_idx)
+    {
+        amiss_draw_line(&backend->img, color, lines[line_idx].width, false,
+                        lines[line_idx].start, lines[line_idx].end);
+    }
+}
+
+static void raster_fill_rect(amiss_backend_st *const backend,
+                             color_st const color, uint32_t const x,
+                             uint32_t const y, uint32_t const w,
+                             uint32_t const h)
+{
+    if (w == 0U)
+    {
+        return;
+    }
+    for (uint32_t y_row = y; y_row - y < h && y_row < backend->img.h; ++y_row)
+    {
+        amiss_draw_span_h(&backend->img, color, x, x + (w - 1U), y_row);
+    }
+}
+
+static void raster_gradient(amiss_backend_st *const backend,
+                            gradient_st const gradient)
+{
+    amiss_draw_bg_gradient(&backend->img, gradient);
+}
+
+static int raster_save(amiss_backend_st *const backend, char const *const path)
+{
+    return amiss_img_save(&backend->img, path);
+}
+
+static void raster_destroy(amiss_backend_st *const backend)
+{
+    /* Pixels belong to the arena. */
+}
+
+/* Where a point of the canvas lands when drawn larger, amid its block. */
+static vec2u32_st ss_point(vec2u32_st const point)
+{
+    return (vec2u32_st){
+        .a = {(point.x * AMISS_BACKEND_SS_FACTOR) +
+                  (AMISS_BACKEND_SS_FACTOR / 2U),
+              (point.y * AMISS_BACKEND_SS_FACTOR) +
+                  (AMISS_BACKEND_SS_FACTOR / 2U)}};
+}
+
+static void ss_lines(amiss_backend_st *const backend, color_st const color,
+                     amiss_line_st const *const lines, uint32_t const count)
+{
+    for (uint32_t line_idx = 0U; line_idx < count; ++line_idx)
+    {
+        /**
+         * Strokes are at least a pixel of the canvas wide, so they still cover
+         * whole blocks and keep their contrast once downsampled.
+         */
+        vec2u32_st const pts[2U] = {ss_point(lines[line_idx].start),
+                                    ss_point(lines[line_idx].end)};
+        double_t const width =
+            fmax(lines[line_idx].width, 1.0) * AMISS_BACKEND_SS_FACTOR;
+        if (amiss_draw_polyline(&backend->img, color, pts, 2U, width) != 0)
+        {
+            log_err("AMISS_BACKEND", "Failed to draw supersampled line\n");
+            return;
+        }
+    }
+}
+
+static void ss_fill_rect(amiss_backend_st *const backend, color_st const color,
+                         uint32_t const x, uint32_t const y, uint32_t const w,
+                         uint32_t const h)
+{
+    raster_fill_rect(backend, color, x * AMISS_BACKEND_SS_FACTOR,
+                     y * AMISS_BACKEND_SS_FACTOR, w * AMISS_BACKEND_SS_FACTOR,
+                     h * AMISS_BACKEND_SS_FACTOR);
+}
+
+static int ss_save(amiss_backend_st *const backend, char const *const path)
+{
+    uint64_t const t_begin = amiss_stage_now();
+    /**
+     * Canvases are usually drawn from jobs already, so bands are filtered on
+     * this thread rather than by a pool.
+     */
+    int const ret =
+        amiss_img_downsample(&backend->out, &backend->img,
+                             AMISS_BACKEND_SS_FACTOR, AMISS_BACKEND_SS_FILTER,
+                             NULL);
+    amiss_stage_end(AMISS_STAGE_RASTERIZE, t_begin);
+    if (ret != 0)
+    {
+        return -1;
+    }
+    return amiss_img_save(&backend->out, path);
+}
+
+static void vector_lines(amiss_backend_st *const backend, color_st const color,
+                         amiss_line_st const *const lines,
+                         uint32_t const count)
+{
+    plutovg_t *const pluto = backend->vector.pluto;
+    plutovg_set_source_rgb(pluto, color.r / 255.0, color.g / 255.0,
+                           color.b / 255.0);
+    /* Lines are stroked one by one, a single path would blend overlaps once. */
+    for (uint32_t line_idx = 0U; line_idx < count; ++line_idx)
+    {
+        amiss_line_st const line = lines[line_idx];
+        plutovg_move_to(pluto, line.start.x, line.start.y);
+        plutovg_line_to(pluto, line.end.x, line.end.y);
+        plutovg_set_line_width(pluto, line.width);
+        plutovg_stroke(pluto);
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_SEGMENTS, count);
+}
+
+static void vector_gradient(amiss_backend_st *const backend,
+                            gradient_st const gradient)
+{
+    plutovg_t *const pluto = backend->vector.pluto;
+    plutovg_gradient_t *const pluto_gradient = plutovg_gradient_create_linear(
+        backend->w / 2U, 0U, backend->w / 2U, backend->h);
+    for (uint8_t stop_idx = 0U; stop_idx < gradient.count; ++stop_idx)
+    {
+        plutovg_gradient_add_stop_rgb(pluto_gradient, gradient.stops[stop_idx],
+                                      gradient.colors[stop_idx].r / 255.0,
+                                      gradient.colors[stop_idx].g / 255.0,
+                                      gradient.colors[stop_idx].b / 255.0);
+    }
+    plutovg_rect(pluto, 0U, 0U, backend->w, backend->h);
+    plutovg_set_source_gradient(pluto, pluto_gradient);
+    plutovg_fill(pluto);
+    /* The source holds its own reference to the gradient. */
+    plutovg_gradient_destroy(pluto_gradient);
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, (uint64_t)backend->w * backend->h);
+}
+
+static int vector_save(amiss_backend_st *const backend, char const *const path)
+{
+    PROF_SCOPE("vector_save");
+    uint64_t const t_begin = amiss_stage_now();
+    plutovg_surface_write_to_png(backend->vector.surface, path);
+    amiss_stage_end(AMISS_STAGE_SAVE, t_begin);
+    if (amiss_stage_enabled() == 1)
+    {
+        amiss_stage_output(path, amiss_hash(AMISS_HASH_INIT, backend->img.b,
+                                            backend->img.blen));
+    }
+    return 0;
+}
+
+static void vector_destroy(amiss_backend_st *const backend)
+{
+    plutovg_surface_destroy(backend->vector.surface);
+    plutovg_destroy(backend->vector.pluto);
+}
+
+static void record_lines(amiss_backend_st *const backend, color_st const color,
+                         amiss_line_st const *const lines,
+                         uint32_t const count)
+{
+    amiss_dlist_record_lines(backend->recorder, color, lines, count);
+}
+
+static void record_fill_rect(amiss_backend_st *const backend,
+                             color_st const color, uint32_t const x,
+                             uint32_t const y, uint32_t const w,
+                             uint32_t const h)
+{
+    amiss_dlist_record_rect(backend->recorder, color, x, y, w, h);
+}
+
+static void record_gradient(amiss_backend_st *const backend,
+                            gradient_st const gradient)
+{
+    amiss_dlist_record_gradient(backend->recorder, gradient);
+}
+
+static int record_save(amiss_backend_st *const backend, char const *const path)
+{
+    return amiss_dlist_recorder_save(backend->recorder, path);
+}
+
+static void record_destroy(amiss_backend_st *const backend)
+{
+    amiss_dlist_recorder_free(backend->recorder);
+}
+
+static void null_lines(amiss_backend_st *const backend, color_st const color,
+                       amiss_line_st const *const lines, uint32_t const count)
+{
+}
+
+static void null_fill_rect(amiss_backend_st *const backend,
+                           color_st const color, uint32_t const x,
+                           uint32_t const y, uint32_t const w,
+                           uint32_t const h)
+{
+}
+
+static void null_gradient(amiss_backend_st *const backend,
+                          gradient_st const gradient)
+{
+}
+
+static int null_save(amiss_backend_st *const backend, char const *const path)
+{
+    return 0;
+}
+
+static void null_destroy(amiss_backend_st *const backend)
+{
+}
+
+static amiss_backend_ops_st const backend_ops[AMISS_BACKEND_COUNT] = {
+    [AMISS_BACKEND_RASTER] =
+        {
+            .name = "raster",
+            .ext = "ppm",
+            .depth = 3U /* RGB */,
+            .lines = raster_lines,
+            .fill_rect = raster_fill_rect,
+            .gradient = raster_gradient,
+            .save = raster_save,
+            .destroy = raster_destroy,
+        },
+    [AMISS_BACKEND_VECTOR] =
+        {
+            .name = "vector",
+            .ext = "png",
+            .depth = 4U /* ARGB */,
+            .lines = vector_lines,
+            /* Pixel aligned opaque rects come out the same as from plutovg. */
+            .fill_rect = raster_fill_rect,
+            .gradient = vector_gradient,
+            .save = vector_save,
+            .destroy = vector_destroy,
+        },
+    [AMISS_BACKEND_HYBRID] =
+        {
+            .name = "hybrid",
+            .ext = "png",
+            .depth = 4U /* ARGB */,
+            .lines = vector_lines,
+            .fill_rect = raster_fill_rect,
+            .gradient = raster_gradient,
+            .save = vector_save,
+            .destroy = vector_destroy,
+        },
+    [AMISS_BACKEND_SUPERSAMPLE] =
+        {
+            .name = "supersample",
+            .ext = "ppm",
+            /* RGB drawn larger, plus the downsampled copy. */
+            .depth = 3U * ((AMISS_BACKEND_SS_FACTOR * AMISS_BACKEND_SS_FACTOR) +
+                           1U),
+            .lines = ss_lines,
+            .fill_rect = ss_fill_rect,
+            .gradient = raster_gradient,
+            .save = ss_save,
+            .destroy = raster_destroy,
+        },
+    [AMISS_BACKEND_RECORD] =
+        {
+            .name = "record",
+            .ext = "amdl",
+            .depth = 0U, /* Ops grow with what's drawn, not with the size. */
+            .lines = record_lines,
+            .fill_rect = record_fill_rect,
+            .gradient = record_gradient,
+            .save = record_save,
+            .destroy = record_destroy,
+        },
+    [AMISS_BACKEND_NULL] =
+        {
+            .name = "null",
+            .ext = "null",
+            .depth = 0U,
+            .lines = null_lines,
+            .fill_rect = null_fill_rect,
+            .gradient = null_gradient,
+            .save = null_save,
+            .destroy = null_destroy,
+        },
+};
+
+/**
+ * @brief Look up a backend by name e.g. to pick one from the command line.
+ * @param name Name of the backend: raster, vector, hybrid, supersample,
+ * record or null.
+ * @param kind Set to the backend found.
+ * @return 0 on success, -1 if no backend has that name.
+ */
+int amiss_backend_kind_parse(char const *const name,
+                             amiss_backend_kind_et *const kind)
+{
+    for (uint32_t kind_idx = 0U; kind_idx < AMISS_BACKEND_COUNT; ++kind_idx)
+    {
+        if (strcmp(name, backend_ops[kind_idx].name) == 0)
+        {
+            *kind = (amiss_backend_kind_et)kind_idx;
+            return 0;
+        }
+    }
+    log_err("AMISS_BACKEND", "Unknown backend '%s'\n", name);
+    return -1;
+}
+
+char const *amiss_backend_ext(amiss_backend_kind_et const kind)
+{
+    return backend_ops[kind].ext;
+}
+
+/**
+ * @brief Get how much memory the pixels of a canvas take.
+ * @param kind Backend of the canvas.
+ * @param w Width of the canvas.
+ * @param h Height of the canvas.
+ * @return Size in bytes.
+ */
+size_t amiss_backend_mem(amiss_backend_kind_et const kind, uint32_t const w,
+                         uint32_t const h)
+{
+    return (size_t)w * h * backend_ops[kind].depth;
+}
+
+/**
+ * @brief Create a canvas drawn by a backend. The contents of the canvas are
+ * undefined until something gets drawn over all of it.
+ * @param backend Canvas to create.
+ * @param kind Backend that draws on the canvas.
+ * @param arena Where to allocate the pixels from.
+ * @param w Width of the canvas.
+ * @param h Height of the canvas.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_backend_create(amiss_backend_st *const backend,
+                         amiss_backend_kind_et const kind,
+                         amiss_arena_st *const arena, uint32_t const w,
+                         uint32_t const h)
+{
+    *backend = (amiss_backend_st){
+        .ops = &backend_ops[kind],
+        .kind = kind,
+        .w = w,
+        .h = h,
+        .stats = {0U},
+        .img = {0U},
+        .out = {0U},
+        .vector = {.surface = NULL, .pluto = NULL},
+        .recorder = NULL,
+    };
+    switch (kind)
+    {
+    case AMISS_BACKEND_RASTER:
+        return amiss_img_create(&backend->img, arena, w, h, AMISS_IMG_FMT_PPM);
+    case AMISS_BACKEND_VECTOR:
+    case AMISS_BACKEND_HYBRID:
+        if (amiss_img_create(&backend->img, arena, w, h,
+                             AMISS_IMG_FMT_ARGB32) != 0)
+        {
+            return -1;
+        }
+        backend->vector.surface = amiss_img_to_surface(&backend->img);
+        if (backend->vector.surface == NULL)
+        {
+            log_err("AMISS_BACKEND", "Failed to create plutovg surface\n");
+            return -1;
+        }
+        backend->vector.pluto = plutovg_create(backend->vector.surface);
+        if (backend->vector.pluto == NULL)
+        {
+            log_err("AMISS_BACKEND", "Failed to create plutovg context\n");
+            plutovg_surface_destroy(backend->vector.surface);
+            backend->vector.surface = NULL;
+            return -1;
+        }
+        return 0;
+    case AMISS_BACKEND_SUPERSAMPLE:
+        if (amiss_img_create(&backend->img, arena, w * AMISS_BACKEND_SS_FACTOR,
+                             h * AMISS_BACKEND_SS_FACTOR,
+                             AMISS_IMG_FMT_PPM) != 0)
+        {
+            return -1;
+        }
+        return amiss_img_create(&backend->out, arena, w, h, AMISS_IMG_FMT_PPM);
+    case AMISS_BACKEND_RECORD:
+        backend->recorder =
+            amiss_arena_alloc(arena, sizeof(*backend->recorder));
+        if (backend->recorder == NULL)
+        {
+            log_err("AMISS_BACKEND", "Failed to allocate recorder\n");
+            return -1;
+        }
+        amiss_dlist_recorder_init(backend->recorder, w, h);
+        return 0;
+    case AMISS_BACKEND_NULL:
+        return 0;
+    default:
+        log_err("AMISS_BACKEND", "Unknown backend %u\n", kind);
+        return -1;
+    }
+}
+
+/**
+ * @brief Draw a batch of lines of the same color.
+ * @param backend Canvas to draw on.
+ * @param color Color of the lines.
+ * @param lines Lines to draw, in order.
+ * @param count Number of lines.
+ */
+void amiss_backend_lines(amiss_backend_st *const backend, color_st const color,
+                         amiss_line_st const *const lines, uint32_t const count)
+{
+    backend->stats.lines += count;
+    backend->ops->lines(backend, color, lines, count);
+}
+
+void amiss_backend_fill_rect(amiss_backend_st *const backend,
+                             color_st const color, uint32_t const x,
+                             uint32_t const y, uint32_t const w,
+                             uint32_t const h)
+{
+    backend->stats.rects++;
+    backend->ops->fill_rect(backend, color, x, y, w, h);
+}
+
+/**
+ * @brief Paint the whole canvas with a vertical gradient.
+ * @param backend Canvas to paint.
+ * @param gradient Stops and colors, from top to bottom.
+ */
+void amiss_backend_gradient(amiss_backend_st *const backend,
+                            gradient_st const gradient)
+{
+    backend->stats.gradients++;
+    backend->ops->gradient(backend, gradient);
+}
+
+/**
+ * @brief Save a canvas in the file format of its backend, see
+ * amiss_backend_ext.
+ * @param backend Canvas to save.
+ * @param path Where to save it.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_backend_save(amiss_backend_st *const backend, char const *const path)
+{
+    backend->stats.saves++;
+    return backend->ops->save(backend, path);
+}
+
+/**
+ * @brief Get the pixels of a canvas e.g. to keep a copy of them.
+ * @param backend Canvas to get the pixels of.
+ * @param len Set to the length of the pixels in bytes.
+ * @return The pixels, NULL if the backend keeps none.
+ */
+uint8_t *amiss_backend_pixels(amiss_backend_st const *const backend,
+                              size_t *const len)
+{
+    *len = backend->img.blen;
+    return backend->img.b;
+}
+
+/**
+ * @brief Destroy a canvas. Pixels belong to the arena and are only given back
+ * when it gets reset.
+ * @param backend Canvas to destroy.
+ */
+void amiss_backend_destroy(amiss_backend_st *const backend)
+{
+    backend->ops->destroy(backend);
+}
@@ -0,0 +1,410 @@
+#include "amiss.h"
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * All kernels work on premultiplied 8-bit channels and divide by 255 with
+ * mul_div255, the vector paths do exactly the same integer math as the scalar
+ * one so their results are bit-identical. Sums that can go past 255 saturate.
+ */
+
+/**
+ * @brief Multiply two channels and divide by 255, rounded to nearest. Exact for
+ * inputs up to 255 without a division.
+ */
+static uint32_t mul_div255(uint32_t const x, uint32_t const y)
+{
+    uint32_t const t = (x * y) + 128U;
+    return (t + (t >> 8U)) >> 8U;
+}
+
+static uint32_t channel_blend(uint32_t const s, uint32_t const d,
+                              uint32_t const sa, uint32_t const da,
+                              amiss_blend_mode_et const mode)
+{
+    uint32_t out;
+    switch (mode)
+    {
+    case AMISS_BLEND_OVER:
+        out = s + mul_div255(d, 255U - sa);
+        break;
+    case AMISS_BLEND_ADD:
+        out = s + d;
+        break;
+    case AMISS_BLEND_MULTIPLY:
+        out = mul_div255(s, d) + mul_div255(s, 255U - da) +
+              mul_div255(d, 255U - sa);
+        break;
+    case AMISS_BLEND_SCREEN:
+    default:
+        out = s + d - mul_div255(s, d);
+        break;
+    }
+    return out > 255U ? 255U : out;
+}
+
+/**
+ * @brief Blend one pixel.
+ * @param s Pixel of the layer.
+ * @param d Pixel under it.
+ * @param k Alpha the layer is scaled by first.
+ * @param mode How to blend.
+ * @return The blended pixel.
+ */
+static uint32_t px_blend(uint32_t const s, uint32_t const d, uint32_t const k,
+                         amiss_blend_mode_et const mode)
+{
+    uint32_t const sa = mul_div255(s >> 24U, k);
+    uint32_t const da = d >> 24U;
+    uint32_t out = 0U;
+    for (uint32_t shift = 0U; shift < 32U; shift += 8U)
+    {
+        uint32_t const s_ch = mul_div255((s >> shift) & 0xFFU, k);
+        out |= channel_blend(s_ch, (d >> shift) & 0xFFU, sa, da, mode)
+               << shift;
+    }
+    return out;
+}
+
+static uint32_t px_fade(uint32_t const px, uint32_t const k)
+{
+    uint32_t out = 0U;
+    for (uint32_t shift = 0U; shift < 32U; shift += 8U)
+    {
+        out |= mul_div255((px >> shift) & 0xFFU, k) << shift;
+    }
+    return out;
+}
+
+#if defined(__SSE2__)
+/* Same as mul_div255 on 16-bit lanes. */
+static __m128i sse2_mul_div255(__m128i const x, __m128i const y)
+{
+    __m128i const t =
+        _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/* Spread the alpha of two pixels in 16-bit lanes over all their lanes. */
+static __m128i sse2_alpha(__m128i const px)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, 0xFF), 0xFF);
+}
+
+/**
+ * @brief Blend two pixels held in 16-bit lanes, see px_blend.
+ * @return The blended pixels, saturating to 255 is left to the packing.
+ */
+static __m128i sse2_blend(__m128i s, __m128i const d, __m128i const k,
+                          amiss_blend_mode_et const mode)
+{
+    __m128i const max = _mm_set1_epi16(255);
+    s = sse2_mul_div255(s, k);
+    switch (mode)
+    {
+    case AMISS_BLEND_OVER:
+        return _mm_add_epi16(
+            s, sse2_mul_div255(d, _mm_sub_epi16(max, sse2_alpha(s))));
+    case AMISS_BLEND_ADD:
+        return _mm_add_epi16(s, d);
+    case AMISS_BLEND_MULTIPLY:
+        return _mm_add_epi16(
+            _mm_add_epi16(
+                sse2_mul_div255(s, d),
+                sse2_mul_div255(s, _mm_sub_epi16(max, sse2_alpha(d)))),
+            sse2_mul_div255(d, _mm_sub_epi16(max, sse2_alpha(s))));
+    case AMISS_BLEND_SCREEN:
+    default:
+        return _mm_sub_epi16(_mm_add_epi16(s, d), sse2_mul_div255(s, d));
+    }
+}
+
+/**
+ * @brief Get the alpha four pixels are scaled by, every byte of a pixel holds
+ * it so it can be unpacked like the pixels.
+ */
+static __m128i sse2_k(uint8_t const *const mask, uint32_t const x)
+{
+    uint32_t mask4;
+    memcpy(&mask4, &mask[x], sizeof(mask4));
+    __m128i const k = _mm_cvtsi32_si128((int)mask4);
+    __m128i const k2 = _mm_unpacklo_epi8(k, k);
+    return _mm_unpacklo_epi16(k2, k2);
+}
+#endif
+
+#if defined(__AVX2__)
+static __m256i avx2_mul_div255(__m256i const x, __m256i const y)
+{
+    __m256i const t =
+        _mm256_add_epi16(_mm256_mullo_epi16(x, y), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static __m256i avx2_alpha(__m256i const px)
+{
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, 0xFF), 0xFF);
+}
+
+static __m256i avx2_blend(__m256i s, __m256i const d, __m256i const k,
+                          amiss_blend_mode_et const mode)
+{
+    __m256i const max = _mm256_set1_epi16(255);
+    s = avx2_mul_div255(s, k);
+    switch (mode)
+    {
+    case AMISS_BLEND_OVER:
+        return _mm256_add_epi16(
+            s, avx2_mul_div255(d, _mm256_sub_epi16(max, avx2_alpha(s))));
+    case AMISS_BLEND_ADD:
+        return _mm256_add_epi16(s, d);
+    case AMISS_BLEND_MULTIPLY:
+        return _mm256_add_epi16(
+            _mm256_add_epi16(
+                avx2_mul_div255(s, d),
+                avx2_mul_div255(s, _mm256_sub_epi16(max, avx2_alpha(d)))),
+            avx2_mul_div255(d, _mm256_sub_epi16(max, avx2_alpha(s))));
+    case AMISS_BLEND_SCREEN:
+    default:
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d),
+                                avx2_mul_div255(s, d));
+    }
+}
+
+/* Like sse2_k for eight pixels, laid out the way 32 bytes of pixels load. */
+static __m256i avx2_k(uint8_t const *const mask, uint32_t const x)
+{
+    __m128i const k = _mm_loadl_epi64((__m128i const *)&mask[x]);
+    __m128i const k2 = _mm_unpacklo_epi8(k, k);
+    return _mm256_set_m128i(_mm_unpackhi_epi16(k2, k2),
+                            _mm_unpacklo_epi16(k2, k2));
+}
+#endif
+
+/**
+ * @brief Blend a row of a layer onto a row of another.
+ * @param d Row blended onto.
+ * @param s Row of the layer.
+ * @param mask Row of the mask, NULL for none.
+ * @param count Number of pixels.
+ * @param mode How to blend.
+ * @param alpha Alpha the whole layer is scaled by.
+ */
+static void row_blend(uint8_t *const d, uint8_t const *const s,
+                      uint8_t const *const mask, uint32_t const count,
+                      amiss_blend_mode_et const mode, uint8_t const alpha)
+{
+    uint32_t x = 0U;
+#if defined(__AVX2__)
+    __m256i const alpha8 = _mm256_set1_epi16(alpha);
+    for (; x + 8U <= count; x += 8U)
+    {
+        __m256i const zero = _mm256_setzero_si256();
+        __m256i const s8 = _mm256_loadu_si256((__m256i const *)&s[x * 4U]);
+        __m256i const d8 = _mm256_loadu_si256((__m256i const *)&d[x * 4U]);
+        __m256i k_lo = alpha8;
+        __m256i k_hi = alpha8;
+        if (mask != NULL)
+        {
+            __m256i const k = avx2_k(mask, x);
+            k_lo = avx2_mul_div255(alpha8, _mm256_unpacklo_epi8(k, zero));
+            k_hi = avx2_mul_div255(alpha8, _mm256_unpackhi_epi8(k, zero));
+        }
+        __m256i const lo = avx2_blend(_mm256_unpacklo_epi8(s8, zero),
+                                      _mm256_unpacklo_epi8(d8, zero), k_lo,
+                                      mode);
+        __m256i const hi = avx2_blend(_mm256_unpackhi_epi8(s8, zero),
+                                      _mm256_unpackhi_epi8(d8, zero), k_hi,
+                                      mode);
+        _mm256_storeu_si256((__m256i *)&d[x * 4U],
+                            _mm256_packus_epi16(lo, hi));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i const alpha4 = _mm_set1_epi16(alpha);
+    for (; x + 4U <= count; x += 4U)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const s4 = _mm_loadu_si128((__m128i const *)&s[x * 4U]);
+        __m128i const d4 = _mm_loadu_si128((__m128i const *)&d[x * 4U]);
+        __m128i k_lo = alpha4;
+        __m128i k_hi = alpha4;
+        if (mask != NULL)
+        {
+            __m128i const k = sse2_k(mask, x);
+            k_lo = sse2_mul_div255(alpha4, _mm_unpacklo_epi8(k, zero));
+            k_hi = sse2_mul_div255(alpha4, _mm_unpackhi_epi8(k, zero));
+        }
+        __m128i const lo = sse2_blend(_mm_unpacklo_epi8(s4, zero),
+                                      _mm_unpacklo_epi8(d4, zero), k_lo, mode);
+        __m128i const hi = sse2_blend(_mm_unpackhi_epi8(s4, zero),
+                                      _mm_unpackhi_epi8(d4, zero), k_hi, mode);
+        _mm_storeu_si128((__m128i *)&d[x * 4U], _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; x < count; ++x)
+    {
+        uint32_t s_px;
+        uint32_t d_px;
+        memcpy(&s_px, &s[x * 4U], sizeof(s_px));
+        memcpy(&d_px, &d[x * 4U], sizeof(d_px));
+        uint32_t const k = mask != NULL ? mul_div255(alpha, mask[x]) : alpha;
+        d_px = px_blend(s_px, d_px, k, mode);
+        memcpy(&d[x * 4U], &d_px, sizeof(d_px));
+    }
+}
+
+/**
+ * @brief Scale a row of pixels by an alpha, see row_blend.
+ */
+static void row_fade(uint8_t *const px, uint8_t const *const mask,
+                     uint32_t const count, uint8_t const alpha)
+{
+    uint32_t x = 0U;
+#if defined(__AVX2__)
+    __m256i const alpha8 = _mm256_set1_epi16(alpha);
+    for (; x + 8U <= count; x += 8U)
+    {
+        __m256i const zero = _mm256_setzero_si256();
+        __m256i const px8 = _mm256_loadu_si256((__m256i const *)&px[x * 4U]);
+        __m256i k_lo = alpha8;
+        __m256i k_hi = alpha8;
+        if (mask != NULL)
+        {
+            __m256i const k = avx2_k(mask, x);
+            k_lo = avx2_mul_div255(alpha8, _mm256_unpacklo_epi8(k, zero));
+            k_hi = avx2_mul_div255(alpha8, _mm256_unpackhi_epi8(k, zero));
+        }
+        __m256i const lo =
+            avx2_mul_div255(_mm256_unpacklo_epi8(px8, zero), k_lo);
+        __m256i const hi =
+            avx2_mul_div255(_mm256_unpackhi_epi8(px8, zero), k_hi);
+        _mm256_storeu_si256((__m256i *)&px[x * 4U],
+                            _mm256_packus_epi16(lo, hi));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i const alpha4 = _mm_set1_epi16(alpha);
+    for (; x + 4U <= count; x += 4U)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const px4 = _mm_loadu_si128((__m128i const *)&px[x * 4U]);
+        __m128i k_lo = alpha4;
+        __m128i k_hi = alpha4;
+        if (mask != NULL)
+        {
+            __m128i const k = sse2_k(mask, x);
+            k_lo = sse2_mul_div255(alpha4, _mm_unpacklo_epi8(k, zero));
+            k_hi = sse2_mul_div255(alpha4, _mm_unpackhi_epi8(k, zero));
+        }
+        __m128i const lo = sse2_mul_div255(_mm_unpacklo_epi8(px4, zero), k_lo);
+        __m128i const hi = sse2_mul_div255(_mm_unpackhi_epi8(px4, zero), k_hi);
+        _mm_storeu_si128((__m128i *)&px[x * 4U], _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; x < count; ++x)
+    {
+        uint32_t px1;
+        memcpy(&px1, &px[x * 4U], sizeof(px1));
+        px1 = px_fade(px1, mask != NULL ? mul_div255(alpha, mask[x]) : alpha);
+        memcpy(&px[x * 4U], &px1, sizeof(px1));
+    }
+}
+
+/**
+ * @brief Get a row of an image by where it's shown, whatever its orientation.
+ */
+static uint8_t *img_row(amiss_img_st const *const img, uint32_t const y)
+{
+    uint32_t const y_buf =
+        img->orient == AMISS_IMG_ORIENT_BOTTOM_UP ? img->h - y - 1U : y;
+    return &img->b[amiss_img_xy2idx(img, amiss_img_depth(img), 0U, y_buf)];
+}
+
+/**
+ * @brief Check that a mask fits an image.
+ * @return 0 if it does, -1 if not.
+ */
+static int mask_check(amiss_img_st const *const img,
+                      amiss_img_st const *const mask)
+{
+    if (mask != NULL && (mask->fmt != AMISS_IMG_FMT_A8 || mask->w != img->w ||
+                         mask->h != img->h))
+    {
+        log_err("AMISS_BLEND", "Mask has to be A8 and as large as the image\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Blend a layer onto an image of the same size.
+ * @param dst Image blended onto, ARGB32.
+ * @param src Layer to blend, ARGB32.
+ * @param mode How to blend.
+ * @param alpha Alpha the whole layer is scaled by, 255 to keep it as is.
+ * @param mask Coverage the layer is scaled by pixel by pixel, A8. NULL for
+ * none.
+ * @return 0 on success, -1 if the images don't fit together.
+ */
+int amiss_blend(amiss_img_st const *const dst, amiss_img_st const *const src,
+                amiss_blend_mode_et const mode, uint8_t const alpha,
+                amiss_img_st const *const mask)
+{
+    PROF_SCOPE("amiss_blend");
+    if (dst->fmt != AMISS_IMG_FMT_ARGB32 || src->fmt != AMISS_IMG_FMT_ARGB32 ||
+        dst->w != src->w || dst->h != src->h)
+    {
+        log_err("AMISS_BLEND", "Layers have to be ARGB32 and of equal size\n");
+        return -1;
+    }
+    if (mask_check(dst, mask) != 0)
+    {
+        return -1;
+    }
+    if (alpha == 0U)
+    {
+        return 0; /* Nothing to blend, every mode leaves dst as is. */
+    }
+    for (uint32_t y = 0U; y < dst->h; ++y)
+    {
+        row_blend(img_row(dst, y), img_row(src, y),
+                  mask != NULL ? img_row(mask, y) : NULL, dst->w, mode, alpha);
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, (uint64_t)dst->w * dst->h);
+    return 0;
+}
+
+/**
+ * @brief Scale a layer by an alpha e.g. to fade it out before blending it
+ * several times.
+ * @param img Layer to fade, ARGB32.
+ * @param alpha Alpha the whole layer is scaled by.
+ * @param mask Coverage the layer is scaled by pixel by pixel, A8. NULL for
+ * none.
+ * @return 0 on success, -1 if the images don't fit together.
+ */
+int amiss_blend_fade(amiss_img_st const *const img, uint8_t const alpha,
+                     amiss_img_st const *const mask)
+{
+    PROF_SCOPE("amiss_blend_fade");
+    if (img->fmt != AMISS_IMG_FMT_ARGB32)
+    {
+        log_err("AMISS_BLEND", "Only ARGB32 images can be faded\n");
+        return -1;
+    }
+    if (mask_check(img, mask) != 0)
+    {
+        return -1;
+    }
+    for (uint32_t y = 0U; y < img->h; ++y)
+    {
+        row_fade(img_row(img, y), mask != NULL ? img_row(mask, y) : NULL,
+                 img->w, alpha);
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, (uint64_t)img->w * img->h);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "amiss.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* How many scopes a thread buffer holds at first, it doubles when full. */
+#define EVENT_COUNT_INIT 4096U
+/* Scopes past this many per thread are dropped. */
+#define EVENT_COUNT_MAX (1U << 22U)
+
+static char const *const counter_names[AMISS_PROF_COUNTER_COUNT] = {
+    [AMISS_PROF_COUNTER_SEGMENTS] = "segments",
+    [AMISS_PROF_COUNTER_PIXELS] = "pixels",
+    [AMISS_PROF_COUNTER_BYTES] = "bytes",
+    [AMISS_PROF_COUNTER_SYMBOLS] = "symbols",
+};
+
+typedef struct prof_event_s
+{
+    char const *name;
+    uint64_t t_begin;
+    uint64_t t_end;
+    /* Counters of the thread when the scope ended. */
+    uint64_t counters[AMISS_PROF_COUNTER_COUNT];
+} prof_event_st;
+
+/**
+ * Everything recorded by one thread. Only the owning thread writes to it, it's
+ * read at exit. Buffers are never freed so they outlive their threads.
+ */
+typedef struct prof_thread_s prof_thread_st;
+struct prof_thread_s
+{
+    prof_thread_st *next;
+    uint32_t tid;
+    uint32_t event_cap;
+    uint32_t event_count;
+    uint64_t event_dropped;
+    prof_event_st *events;
+    uint64_t counters[AMISS_PROF_COUNTER_COUNT];
+};
+
+static _Atomic(prof_thread_st *) prof_threads = NULL;
+static atomic_uint prof_tid_next;
+static _Thread_local prof_thread_st *prof_thread = NULL;
+
+/**
+ * @brief Write everything recorded by all threads as Chrome trace JSON.
+ * Registered with atexit.
+ */
+static void prof_write(void)
+{
+    char const *path = getenv(AMISS_PROF_ENV);
+    if (path == NULL)
+    {
+        path = AMISS_PROF_PATH_DEFAULT;
+    }
+    FILE *const f = fopen(path, "w");
+    if (f == NULL)
+    {
+        log_err("AMISS_PROF", "Failed to open trace file\n");
+        return;
+    }
+
+    /* Timestamps are written relative to the earliest scope. */
+    uint64_t t_origin = UINT64_MAX;
+    for (prof_thread_st const *thread = atomic_load(&prof_threads);
+         thread != NULL; thread = thread->next)
+    {
+        /* Outer scopes are recorded after the scopes nested in them. */
+        for (uint32_t event_idx = 0U; event_idx < thread->event_count;
+             ++event_idx)
+        {
+            if (thread->events[event_idx].t_begin < t_origin)
+            {
+                t_origin = thread->events[event_idx].t_begin;
+            }
+        }
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (prof_thread_st const *thread = atomic_load(&prof_threads);
+         thread != NULL; thread = thread->next)
+    {
+        fprintf(f,
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                first ? "" : ",\n", thread->tid, thread->tid);
+        first = false;
+        for (uint32_t event_idx = 0U; event_idx < thread->event_count;
+             ++event_idx)
+        {
+            prof_event_st const *const event = &thread->events[event_idx];
+            double const ts = (double)(event->t_begin - t_origin) * 1e-3;
+            double const te = (double)(event->t_end - t_origin) * 1e-3;
+            fprintf(f,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, thread->tid, ts, te - ts);
+            fprintf(f,
+                    ",\n{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,"
+                    "\"tid\":%u,\"id\":%u,\"ts\":%.3f,\"args\":{",
+                    thread->tid, thread->tid, te);
+            for (uint32_t counter = 0U; counter < AMISS_PROF_COUNTER_COUNT;
+                 ++counter)
+            {
+                fprintf(f, "%s\"%s\":%llu", counter == 0U ? "" : ",",
+                        counter_names[counter],
+                        (unsigned long long)event->counters[counter]);
+            }
+            fprintf(f, "}}");
+        }
+        if (thread->event_dropped > 0U)
+        {
+            log_warn("AMISS_PROF", "Thread %u dropped %llu scopes\n",
+                     thread->tid, (unsigned long long)thread->event_dropped);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
+
+/**
+ * @brief Get the buffer of the calling thread, creating it on first use.
+ * @return The buffer, NULL if it could not be allocated.
+ */
+static prof_thread_st *prof_thread_get(void)
+{
+    if (prof_thread != NULL)
+    {
+        return prof_thread;
+    }
+    prof_thread_st *const thread = calloc(1U, sizeof(*thread));
+    if (thread == NULL)
+    {
+        log_err("AMISS_PROF", "Failed to allocate thread buffer\n");
+        return NULL;
+    }
+    thread->tid = atomic_fetch_add(&prof_tid_next, 1U);
+    if (thread->tid == 0U)
+    {
+        atexit(prof_write);
+    }
+    prof_thread_st *head = atomic_load(&prof_threads);
+    do
+    {
+        thread->next = head;
+    } while (!atomic_compare_exchange_weak(&prof_threads, &head, thread));
+    prof_thread = thread;
+    return thread;
+}
+
+/**
+ * @brief Start timing a scope. Use PROF_SCOPE instead of calling this directly.
+ * @param name Name shown in the trace.
+ * @return Scope to pass to amiss_prof_scope_end.
+ */
+amiss_prof_scope_st amiss_prof_scope_begin(char const *const name)
+{
+    return (amiss_prof_scope_st){.name = name, .t_begin = amiss_stage_now()};
+}
+
+/**
+ * @brief Record a scope that just ended into the buffer of the calling thread.
+ * Used as the cleanup function of PROF_SCOPE.
+ * @param scope Scope returned by amiss_prof_scope_begin.
+ */
+void amiss_prof_scope_end(amiss_prof_scope_st const *const scope)
+{
+    uint64_t const t_end = amiss_stage_now();
+    prof_thread_st *const thread = prof_thread_get();
+    if (thread == NULL)
+    {
+        return;
+    }
+    if (thread->event_count == thread->event_cap)
+    {
+        uint32_t const cap_new = thread->event_cap == 0U
+                                     ? EVENT_COUNT_INIT
+                                     : thread->event_cap * 2U;
+        prof_event_st *const events_new =
+            cap_new > EVENT_COUNT_MAX
+                ? NULL
+                : realloc(thread->events, cap_new * sizeof(*events_new));
+        if (events_new == NULL)
+        {
+            thread->event_dropped++;
+            return;
+        }
+        thread->events = events_new;
+        thread->event_cap = cap_new;
+    }
+    prof_event_st *const event = &thread->events[thread->event_count++];
+    event->name = scope->name;
+    event->t_begin = scope->t_begin;
+    event->t_end = t_end;
+    memcpy(event->counters, thread->counters, sizeof(event->counters));
+}
+
+/**
+ * @brief Add to a counter of the calling thread. Use PROF_COUNT instead of
+ * calling this directly.
+ * @param counter Counter to add to.
+ * @param n Amount to add.
+ */
+void amiss_prof_count(amiss_prof_counter_et const counter, uint64_t const n)
+{
+    prof_thread_st *const thread = prof_thread_get();
+    if (thread == NULL)
+    {
+        return;
+    }
+    thread->counters[counter] += n;
+}
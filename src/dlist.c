@@ -0,0 +1,697 @@
+#include "amiss.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Size of the first buffer of a recorder, it doubles whenever it fills up. */
+#define REC_CAP_MIN (64U * 1024U)
+
+/* Lines converted at once before they are handed to a backend. */
+#define REPLAY_BATCH 256U
+
+/* Narrowest strip an image gets split into when rendered in tiles. */
+#define STRIP_W_MIN 64U
+/* Strips queued per worker, so workers that finish early can steal some. */
+#define STRIPS_PER_WORKER 4U
+
+/**
+ * @brief Get the size of one payload item of an op.
+ * @param kind Kind of the op.
+ * @return Size in bytes, 0 if the kind is unknown.
+ */
+static size_t op_item_size(uint8_t const kind)
+{
+    switch (kind)
+    {
+    case AMISS_DLIST_OP_LINES:
+        return sizeof(amiss_dlist_line_st);
+    case AMISS_DLIST_OP_RECT:
+        return sizeof(amiss_dlist_rect_st);
+    case AMISS_DLIST_OP_GRADIENT:
+        return sizeof(amiss_dlist_stop_st);
+    default:
+        return 0U;
+    }
+}
+
+/**
+ * @brief Append an op to a recorder, growing its buffer as needed.
+ * @param rec Recorder to append to.
+ * @param kind Kind of the op.
+ * @param color Color the op draws with.
+ * @param count Number of payload items.
+ * @return Where the payload goes, NULL if the buffer couldn't grow.
+ */
+static void *rec_push(amiss_dlist_recorder_st *const rec, uint8_t const kind,
+                      color_st const color, uint32_t const count)
+{
+    size_t const len = sizeof(amiss_dlist_op_st) + (count * op_item_size(kind));
+    if (rec->failed == true)
+    {
+        return NULL;
+    }
+    if (rec->len + len > rec->cap)
+    {
+        size_t cap = rec->cap == 0U ? REC_CAP_MIN : rec->cap;
+        while (cap < rec->len + len)
+        {
+            cap *= 2U;
+        }
+        uint8_t *const b = realloc(rec->b, cap);
+        if (b == NULL)
+        {
+            log_err("AMISS_DLIST", "Failed to grow display list to %zu bytes\n",
+                    cap);
+            rec->failed = true;
+            return NULL;
+        }
+        rec->b = b;
+        rec->cap = cap;
+    }
+    amiss_dlist_op_st *const op =
+        (amiss_dlist_op_st *)(void *)&rec->b[rec->len];
+    *op = (amiss_dlist_op_st){
+        .kind = kind,
+        .rgb = {color.r, color.g, color.b},
+        .count = count,
+    };
+    rec->len += len;
+    rec->op_count++;
+    return &op[1U];
+}
+
+/**
+ * @brief Prepare a recorder, nothing gets allocated until the first op.
+ * @param rec Recorder to prepare.
+ * @param w Width of the canvas being recorded.
+ * @param h Height of the canvas being recorded.
+ */
+void amiss_dlist_recorder_init(amiss_dlist_recorder_st *const rec,
+                               uint32_t const w, uint32_t const h)
+{
+    *rec = (amiss_dlist_recorder_st){
+        .w = w,
+        .h = h,
+        .b = NULL,
+        .len = 0U,
+        .cap = 0U,
+        .op_count = 0U,
+        .failed = false,
+    };
+}
+
+void amiss_dlist_record_lines(amiss_dlist_recorder_st *const rec,
+                              color_st const color,
+                              amiss_line_st const *const lines,
+                              uint32_t const count)
+{
+    if (count == 0U)
+    {
+        return;
+    }
+    amiss_dlist_line_st *const out =
+        rec_push(rec, AMISS_DLIST_OP_LINES, color, count);
+    if (out == NULL)
+    {
+        return;
+    }
+    for (uint32_t line_idx = 0U; line_idx < count; ++line_idx)
+    {
+        out[line_idx] = (amiss_dlist_line_st){
+            .x0 = lines[line_idx].start.x,
+            .y0 = lines[line_idx].start.y,
+            .x1 = lines[line_idx].end.x,
+            .y1 = lines[line_idx].end.y,
+            .width = (float)lines[line_idx].width,
+        };
+    }
+}
+
+void amiss_dlist_record_rect(amiss_dlist_recorder_st *const rec,
+                             color_st const color, uint32_t const x,
+                             uint32_t const y, uint32_t const w,
+                             uint32_t const h)
+{
+    amiss_dlist_rect_st *const out =
+        rec_push(rec, AMISS_DLIST_OP_RECT, color, 1U);
+    if (out != NULL)
+    {
+        *out = (amiss_dlist_rect_st){.x = x, .y = y, .w = w, .h = h};
+    }
+}
+
+/**
+ * @brief Record a gradient over the whole canvas. It covers everything drawn
+ * before, so those ops are dropped and redrawing frames on a cleared canvas
+ * doesn't make the list grow. A gradient the raster backend wouldn't draw
+ * isn't recorded and keeps the ops before it.
+ * @param rec Recorder to record on.
+ * @param gradient Stops and colors, from top to bottom.
+ */
+void amiss_dlist_record_gradient(amiss_dlist_recorder_st *const rec,
+                                 gradient_st const gradient)
+{
+    if (amiss_draw_gradient_valid(gradient) == false)
+    {
+        return;
+    }
+    rec->len = 0U;
+    rec->op_count = 0U;
+    /* Bytes rather than stops, ops are only aligned for 32-bit fields. */
+    uint8_t *const out = rec_push(rec, AMISS_DLIST_OP_GRADIENT,
+                                  (color_st){.a = {0U}}, gradient.count);
+    if (out == NULL)
+    {
+        return;
+    }
+    for (uint8_t stop_idx = 0U; stop_idx < gradient.count; ++stop_idx)
+    {
+        amiss_dlist_stop_st const stop = {
+            .pos = gradient.stops[stop_idx],
+            .rgb = {gradient.colors[stop_idx].r, gradient.colors[stop_idx].g,
+                    gradient.colors[stop_idx].b},
+            .pad = {0U},
+        };
+        memcpy(&out[stop_idx * sizeof(stop)], &stop, sizeof(stop));
+    }
+}
+
+/**
+ * @brief Write everything recorded so far to a file.
+ * @param rec Recorder to save.
+ * @param path Where to save it.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_dlist_recorder_save(amiss_dlist_recorder_st const *const rec,
+                              char const *const path)
+{
+    PROF_SCOPE("amiss_dlist_recorder_save");
+    uint64_t const t_begin = amiss_stage_now();
+    if (rec->failed == true)
+    {
+        log_err("AMISS_DLIST", "Not saving incomplete display list\n");
+        return -1;
+    }
+    amiss_dlist_header_st const header = {
+        .magic = AMISS_DLIST_MAGIC,
+        .version = AMISS_DLIST_VERSION,
+        .header_len = sizeof(header),
+        .byte_order = AMISS_DLIST_BYTE_ORDER,
+        .w = rec->w,
+        .h = rec->h,
+        .op_count = rec->op_count,
+        .body_len = rec->len,
+    };
+    FILE *const f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        log_err("AMISS_DLIST", "Failed to create/open file: %s\n",
+                strerror(errno));
+        return -1;
+    }
+    int ret = 0;
+    if (fwrite(&header, sizeof(header), 1U, f) != 1U ||
+        (rec->len > 0U && fwrite(rec->b, rec->len, 1U, f) != 1U))
+    {
+        log_err("AMISS_DLIST", "Failed to write display list\n");
+        ret = -1;
+    }
+    if (fclose(f) != 0)
+    {
+        log_warn("AMISS_DLIST", "Failed to close file: %s\n", strerror(errno));
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_BYTES, sizeof(header) + rec->len);
+    amiss_stage_end(AMISS_STAGE_SAVE, t_begin);
+    if (ret == 0 && amiss_stage_enabled() == 1)
+    {
+        amiss_stage_output(path, amiss_hash(AMISS_HASH_INIT, rec->b, rec->len));
+    }
+    return ret;
+}
+
+void amiss_dlist_recorder_free(amiss_dlist_recorder_st *const rec)
+{
+    free(rec->b);
+    rec->b = NULL;
+    rec->len = 0U;
+    rec->cap = 0U;
+}
+
+/**
+ * @brief Check that every op of a mapped file lies within it.
+ * @param dlist Mapped file.
+ * @return 0 if all ops are valid, -1 otherwise.
+ */
+static int dlist_validate(amiss_dlist_st const *const dlist)
+{
+    size_t pos = 0U;
+    uint32_t op_idx = 0U;
+    for (; pos < dlist->body_len; ++op_idx)
+    {
+        if (dlist->body_len - pos < sizeof(amiss_dlist_op_st))
+        {
+            log_err("AMISS_DLIST", "Op %u is cut short\n", op_idx);
+            return -1;
+        }
+        amiss_dlist_op_st const *const op =
+            (amiss_dlist_op_st const *)(void const *)&dlist->body[pos];
+        size_t const item_size = op_item_size(op->kind);
+        if (item_size == 0U)
+        {
+            log_err("AMISS_DLIST", "Op %u is of unknown kind %u\n", op_idx,
+                    op->kind);
+            return -1;
+        }
+        pos += sizeof(*op);
+        if ((dlist->body_len - pos) / item_size < op->count ||
+            (op->kind == AMISS_DLIST_OP_RECT && op->count != 1U) ||
+            (op->kind == AMISS_DLIST_OP_GRADIENT && op->count > UINT8_MAX))
+        {
+            log_err("AMISS_DLIST", "Op %u has a bad count %u\n", op_idx,
+                    op->count);
+            return -1;
+        }
+        pos += op->count * item_size;
+    }
+    if (op_idx != dlist->op_count)
+    {
+        log_err("AMISS_DLIST", "Expected %u ops but found %u\n",
+                dlist->op_count, op_idx);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Map a display list file into memory and check it's one amiss can
+ * read. Ops are read straight from the mapping, only the pages that get used
+ * are loaded.
+ * @param dlist Set to the mapped file.
+ * @param path Where the file is.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_dlist_open(amiss_dlist_st *const dlist, char const *const path)
+{
+    *dlist = (amiss_dlist_st){.map = NULL, .map_len = 0U, .body = NULL};
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        log_err("AMISS_DLIST", "Failed to open '%s': %s\n", path,
+                strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        log_err("AMISS_DLIST", "Failed to stat '%s': %s\n", path,
+                strerror(errno));
+        close(fd);
+        return -1;
+    }
+    amiss_dlist_header_st header;
+    if ((size_t)st.st_size < sizeof(header))
+    {
+        log_err("AMISS_DLIST", "'%s' is too short for a display list\n", path);
+        close(fd);
+        return -1;
+    }
+    void *const map =
+        mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* The mapping keeps the file open. */
+    if (map == MAP_FAILED)
+    {
+        log_err("AMISS_DLIST", "Failed to map '%s': %s\n", path,
+                strerror(errno));
+        return -1;
+    }
+    dlist->map = map;
+    dlist->map_len = (size_t)st.st_size;
+
+    memcpy(&header, dlist->map, sizeof(header));
+    if (memcmp(header.magic, AMISS_DLIST_MAGIC, sizeof(header.magic)) != 0 ||
+        header.byte_order != AMISS_DLIST_BYTE_ORDER)
+    {
+        log_err("AMISS_DLIST", "'%s' is not a display list of this machine\n",
+                path);
+        amiss_dlist_close(dlist);
+        return -1;
+    }
+    if (header.version != AMISS_DLIST_VERSION ||
+        header.header_len < sizeof(header) || header.header_len % 4U != 0U ||
+        header.header_len > dlist->map_len ||
+        header.body_len != dlist->map_len - header.header_len)
+    {
+        log_err("AMISS_DLIST", "'%s' is of unsupported version %u or length\n",
+                path, header.version);
+        amiss_dlist_close(dlist);
+        return -1;
+    }
+    dlist->w = header.w;
+    dlist->h = header.h;
+    dlist->op_count = header.op_count;
+    dlist->body = &dlist->map[header.header_len];
+    dlist->body_len = header.body_len;
+    if (dlist_validate(dlist) != 0)
+    {
+        amiss_dlist_close(dlist);
+        return -1;
+    }
+    /* Ops are read front to back. */
+    madvise(map, dlist->map_len, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void amiss_dlist_close(amiss_dlist_st *const dlist)
+{
+    if (dlist->map != NULL)
+    {
+        munmap((void *)(uintptr_t)dlist->map, dlist->map_len);
+    }
+    *dlist = (amiss_dlist_st){.map = NULL, .map_len = 0U, .body = NULL};
+}
+
+/**
+ * @brief Scale a coordinate of the recorded canvas.
+ * @return Scaled coordinate, saturated to the range of uint32_t.
+ */
+static inline uint32_t coord_scale(uint32_t const coord, double_t const scale)
+{
+    if (scale == 1.0)
+    {
+        return coord;
+    }
+    /* Coordinates are positive, so adding a half rounds like round does. */
+    double_t const scaled = (coord * scale) + 0.5;
+    return scaled >= (double_t)UINT32_MAX ? UINT32_MAX : (uint32_t)scaled;
+}
+
+/**
+ * @brief Scale a rect by its edges, so rects that touched still do.
+ * @param rect Rect to scale.
+ * @param scale How much larger to make it.
+ * @param x Set to the first column.
+ * @param y Set to the first row.
+ * @param x_end Set to the column past the last one.
+ * @param y_end Set to the row past the last one.
+ */
+static void rect_scale(amiss_dlist_rect_st const *const rect,
+                       double_t const scale, uint32_t *const x,
+                       uint32_t *const y, uint32_t *const x_end,
+                       uint32_t *const y_end)
+{
+    uint64_t const x_end_rec = (uint64_t)rect->x + rect->w;
+    uint64_t const y_end_rec = (uint64_t)rect->y + rect->h;
+    *x = coord_scale(rect->x, scale);
+    *y = coord_scale(rect->y, scale);
+    *x_end = coord_scale(x_end_rec > UINT32_MAX ? UINT32_MAX
+                                                : (uint32_t)x_end_rec,
+                         scale);
+    *y_end = coord_scale(y_end_rec > UINT32_MAX ? UINT32_MAX
+                                                : (uint32_t)y_end_rec,
+                         scale);
+}
+
+/**
+ * @brief Read the stops of a gradient op.
+ * @param op Gradient op.
+ * @param stops Set to the positions of the stops.
+ * @param colors Set to the colors of the stops.
+ * @return Gradient referring to stops and colors.
+ */
+static gradient_st gradient_read(amiss_dlist_op_st const *const op,
+                                 double_t stops[UINT8_MAX],
+                                 color_st colors[UINT8_MAX])
+{
+    uint8_t const *const items = (uint8_t const *)&op[1U];
+    for (uint32_t stop_idx = 0U; stop_idx < op->count; ++stop_idx)
+    {
+        amiss_dlist_stop_st stop;
+        memcpy(&stop, &items[stop_idx * sizeof(stop)], sizeof(stop));
+        stops[stop_idx] = stop.pos;
+        colors[stop_idx] = (color_st){.a = {stop.rgb[0U], stop.rgb[1U],
+                                            stop.rgb[2U]}};
+    }
+    /* Safe cast, counts are checked when the file is opened. */
+    return (gradient_st){
+        .count = (uint8_t)op->count, .stops = stops, .colors = colors};
+}
+
+/**
+ * @brief Get the op following another one.
+ * @param op Current op.
+ * @return Next op, or the end of the body.
+ */
+static amiss_dlist_op_st const *op_next(amiss_dlist_op_st const *const op)
+{
+    uint8_t const *const items = (uint8_t const *)&op[1U];
+    return (amiss_dlist_op_st const *)(void const *)&items
+        [op->count * op_item_size(op->kind)];
+}
+
+/**
+ * @brief Draw a display list through a backend, e.g. to render recorded
+ * geometry as a vector image or at another size.
+ * @param dlist Display list to draw.
+ * @param backend Canvas to draw on, usually scale times the recorded size.
+ * @param scale How much larger to draw than recorded, coordinates are rounded
+ * to the nearest pixel and widths are scaled as is.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_dlist_replay(amiss_dlist_st const *const dlist,
+                       amiss_backend_st *const backend, double_t const scale)
+{
+    PROF_SCOPE("amiss_dlist_replay");
+    if (!(scale > 0.0))
+    {
+        log_err("AMISS_DLIST", "Scale must be positive\n");
+        return -1;
+    }
+    amiss_line_st batch[REPLAY_BATCH];
+    double_t stops[UINT8_MAX];
+    color_st colors[UINT8_MAX];
+    amiss_dlist_op_st const *op = (amiss_dlist_op_st const *)(void const *)
+                                      dlist->body;
+    for (uint32_t op_idx = 0U; op_idx < dlist->op_count;
+         ++op_idx, op = op_next(op))
+    {
+        color_st const color = {.a = {op->rgb[0U], op->rgb[1U], op->rgb[2U]}};
+        switch (op->kind)
+        {
+        case AMISS_DLIST_OP_LINES: {
+            amiss_dlist_line_st const *const lines =
+                (amiss_dlist_line_st const *)(void const *)&op[1U];
+            for (uint32_t done = 0U; done < op->count;)
+            {
+                uint32_t const batch_count = op->count - done < REPLAY_BATCH
+                                                 ? op->count - done
+                                                 : REPLAY_BATCH;
+                for (uint32_t line_idx = 0U; line_idx < batch_count;
+                     ++line_idx)
+                {
+                    amiss_dlist_line_st const *const line =
+                        &lines[done + line_idx];
+                    batch[line_idx] = (amiss_line_st){
+                        .start = {.a = {coord_scale(line->x0, scale),
+                                        coord_scale(line->y0, scale)}},
+                        .end = {.a = {coord_scale(line->x1, scale),
+                                      coord_scale(line->y1, scale)}},
+                        .width = line->width * scale,
+                    };
+                }
+                amiss_backend_lines(backend, color, batch, batch_count);
+                done += batch_count;
+            }
+            break;
+        }
+        case AMISS_DLIST_OP_RECT: {
+            uint32_t x, y, x_end, y_end;
+            rect_scale((amiss_dlist_rect_st const *)(void const *)&op[1U],
+                       scale, &x, &y, &x_end, &y_end);
+            if (x_end > x && y_end > y)
+            {
+                amiss_backend_fill_rect(backend, color, x, y, x_end - x,
+                                        y_end - y);
+            }
+            break;
+        }
+        case AMISS_DLIST_OP_GRADIENT:
+            amiss_backend_gradient(backend, gradient_read(op, stops, colors));
+            break;
+        default:
+            break; /* Kinds are checked when the file is opened. */
+        }
+    }
+    return 0;
+}
+
+/* A strip of the image drawn by one job. */
+typedef struct strip_s
+{
+    amiss_dlist_st const *dlist;
+    amiss_img_st const *img; /* Whole image. */
+    amiss_img_st window;     /* Columns of the strip, all rows. */
+    uint32_t x;              /* First column of the strip in img. */
+    double_t scale;
+} strip_st;
+
+/**
+ * @brief Draw every op of a display list that reaches into a strip. Strips
+ * span all rows, so gradients, which only depend on the row, come out the same
+ * as on the whole image.
+ * @param strip Strip to draw.
+ */
+static void strip_draw(strip_st const *const strip)
+{
+    amiss_img_st const *const img = strip->img;
+    amiss_img_st const *const window = &strip->window;
+    vec2u32_st const origin = {.a = {strip->x, 0U}};
+    double_t const scale = strip->scale;
+    double_t stops[UINT8_MAX];
+    color_st colors[UINT8_MAX];
+    amiss_dlist_op_st const *op = (amiss_dlist_op_st const *)(void const *)
+                                      strip->dlist->body;
+    for (uint32_t op_idx = 0U; op_idx < strip->dlist->op_count;
+         ++op_idx, op = op_next(op))
+    {
+        color_st const color = {.a = {op->rgb[0U], op->rgb[1U], op->rgb[2U]}};
+        switch (op->kind)
+        {
+        case AMISS_DLIST_OP_LINES: {
+            amiss_dlist_line_st const *const lines =
+                (amiss_dlist_line_st const *)(void const *)&op[1U];
+            for (uint32_t line_idx = 0U; line_idx < op->count; ++line_idx)
+            {
+                vec2u32_st const start = {
+                    .a = {coord_scale(lines[line_idx].x0, scale),
+                          coord_scale(lines[line_idx].y0, scale)}};
+                vec2u32_st const end = {
+                    .a = {coord_scale(lines[line_idx].x1, scale),
+                          coord_scale(lines[line_idx].y1, scale)}};
+                /* Lines leaving the image aren't drawn, see amiss_draw_line. */
+                if (start.x < img->w && end.x < img->w && start.y < img->h &&
+                    end.y < img->h)
+                {
+                    amiss_draw_line_window(window, color, origin, start, end);
+                }
+            }
+            break;
+        }
+        case AMISS_DLIST_OP_RECT: {
+            uint32_t x, y, x_end, y_end;
+            rect_scale((amiss_dlist_rect_st const *)(void const *)&op[1U],
+                       scale, &x, &y, &x_end, &y_end);
+            x = x > strip->x ? x - strip->x : 0U;
+            x_end = x_end > strip->x ? x_end - strip->x : 0U;
+            x_end = x_end > window->w ? window->w : x_end;
+            y_end = y_end > window->h ? window->h : y_end;
+            for (uint32_t row = y; x < x_end && row < y_end; ++row)
+            {
+                amiss_draw_span_h(window, color, x, x_end - 1U, row);
+            }
+            break;
+        }
+        case AMISS_DLIST_OP_GRADIENT:
+            amiss_draw_bg_gradient(window, gradient_read(op, stops, colors));
+            break;
+        default:
+            break; /* Kinds are checked when the file is opened. */
+        }
+    }
+}
+
+static int strip_job(void *const arg, amiss_arena_st *const arena)
+{
+    strip_draw(arg);
+    return 0;
+}
+
+/**
+ * @brief Rasterize a display list into an image in parallel strips of columns.
+ * Pixels come out the same as from the raster backend drawing at that size,
+ * whatever the number of strips.
+ * @param dlist Display list to draw.
+ * @param img Image to draw on, usually scale times the recorded size.
+ * @param scale How much larger to draw than recorded, coordinates are rounded
+ * to the nearest pixel.
+ * @param pool Workers drawing the strips, NULL to draw on this thread.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_dlist_render(amiss_dlist_st const *const dlist,
+                       amiss_img_st const *const img, double_t const scale,
+                       amiss_job_pool_st *const pool)
+{
+    PROF_SCOPE("amiss_dlist_render");
+    if (!(scale > 0.0))
+    {
+        log_err("AMISS_DLIST", "Scale must be positive\n");
+        return -1;
+    }
+    uint32_t strip_count = (img->w + STRIP_W_MIN - 1U) / STRIP_W_MIN;
+    if (pool == NULL)
+    {
+        strip_count = 1U;
+    }
+    else if (strip_count > pool->worker_count * STRIPS_PER_WORKER)
+    {
+        strip_count = pool->worker_count * STRIPS_PER_WORKER;
+    }
+    if (strip_count <= 1U)
+    {
+        strip_draw(&(strip_st){.dlist = dlist,
+                               .img = img,
+                               .window = *img,
+                               .x = 0U,
+                               .scale = scale});
+        return 0;
+    }
+
+    strip_st *const strips =
+        malloc(strip_count * (sizeof(strip_st) + sizeof(amiss_job_st)));
+    if (strips == NULL)
+    {
+        log_err("AMISS_DLIST", "Failed to allocate strips\n");
+        return -1;
+    }
+    amiss_job_st *const jobs = (amiss_job_st *)(void *)&strips[strip_count];
+    uint8_t const depth = amiss_img_depth(img);
+    uint32_t const stride = amiss_img_stride(img);
+    for (uint32_t strip_idx = 0U; strip_idx < strip_count; ++strip_idx)
+    {
+        /* Spread the columns evenly, in multiples of 16 pixels. */
+        uint32_t const x =
+            (uint32_t)(((uint64_t)img->w * strip_idx / strip_count) & ~15U);
+        uint32_t const x_end =
+            strip_idx + 1U == strip_count
+                ? img->w
+                : (uint32_t)(((uint64_t)img->w * (strip_idx + 1U) /
+                              strip_count) &
+                             ~15U);
+        uint32_t const offset = amiss_img_xy2idx(img, depth, x, 0U);
+        strips[strip_idx] = (strip_st){
+            .dlist = dlist,
+            .img = img,
+            .window =
+                {
+                    .w = x_end - x,
+                    .h = img->h,
+                    .blen = img->blen - offset,
+                    .b = &img->b[offset],
+                    .stride = stride,
+                    .fmt = img->fmt,
+                    .orient = img->orient,
+                },
+            .x = x,
+            .scale = scale,
+        };
+        jobs[strip_idx] = (amiss_job_st){
+            .fn = strip_job, .arg = &strips[strip_idx], .mem = 0U, .ret = 0};
+    }
+    int const ret = amiss_job_pool_run(pool, jobs, strip_count);
+    free(strips);
+    return ret;
+}
@@ -1,37 +1,23 @@
 #include "amiss.h"
 #include <stdlib.h>
+#include <string.h>
 
-__attribute__((unused)) static void color_antialias(
-    amiss_img_st const *const img, color_st *const color_aa,
-    color_st const color, color_st const color_bg, double_t const antialias)
-{
-    uint8_t const depth = amiss_img_depth(img);
-    for (uint8_t depth_idx = 0U; depth_idx < depth; ++depth_idx)
-    {
-        (*color_aa).a[depth_idx] =
-            (uint8_t)(((1 - antialias) * color.a[depth_idx]) +
-                      (antialias * color_bg.a[depth_idx]));
-    }
-}
+/* Bytes of a span filled one at a time before copies take over. */
+#define SPAN_H_BYTEWISE_LEN 48U
 
 /**
  * @brief General purpose bresenham implementation. It takes in a callback which
  * gets called for every pixel traced by this algorithm.
  * @param img An image to draw the line on.
+ * @param origin Where the image starts on the canvas the line is given in.
  * @param start Where the line should start.
  * @param end Where the line should end.
  * @return Length of the line.
  */
 static uint32_t bresenham_thin(amiss_img_st const *const img,
-                               color_st const color, vec2u32_st const start,
-                               vec2u32_st const end)
+                               color_st const color, vec2u32_st const origin,
+                               vec2u32_st const start, vec2u32_st const end)
 {
-    if (start.x >= img->w || end.x >= img->w || start.y >= img->h ||
-        end.y >= img->h)
-    {
-        return 0;
-    }
-
     int64_t dx = llabs((int64_t)end.x - (int64_t)start.x),
             sx = start.x < end.x ? 1 : -1;
     int64_t dy = -llabs((int64_t)end.y - (int64_t)start.y),
@@ -45,7 +31,8 @@ static uint32_t bresenham_thin(amiss_img_st const *const img,
 
     for (;;)
     {
-        amiss_draw_px_set(img, color, x, y);
+        /* Pixels left of or above the image wrap around and get skipped. */
+        amiss_draw_px_set(img, color, x - origin.x, y - origin.y);
         if (x == end.x && y == end.y)
         {
             break;
@@ -85,11 +72,8 @@ inline void amiss_draw_px_set(amiss_img_st const *const img,
         return; /* Outside of the image. */
     }
     uint8_t const depth = amiss_img_depth(img);
-    for (uint8_t depth_idx = 0; depth_idx < depth; ++depth_idx)
-    {
-        img->b[amiss_img_xy2idx(img, depth, x, y) + depth_idx] =
-            color.a[depth_idx];
-    }
+    amiss_img_px_encode(img, &img->b[amiss_img_xy2idx(img, depth, x, y)],
+                        color.r, color.g, color.b);
 }
 
 inline void amiss_draw_px_get(amiss_img_st const *const img,
@@ -101,11 +85,8 @@ inline void amiss_draw_px_get(amiss_img_st const *const img,
         return; /* Outside of the image. */
     }
     uint8_t const depth = amiss_img_depth(img);
-    for (uint8_t depth_idx = 0; depth_idx < depth; ++depth_idx)
-    {
-        (*color).a[depth_idx] =
-            img->b[amiss_img_xy2idx(img, depth, x, y) + depth_idx];
-    }
+    amiss_img_px_decode(img, &img->b[amiss_img_xy2idx(img, depth, x, y)],
+                        &color->r, &color->g, &color->b);
 }
 
 uint32_t amiss_draw_line(amiss_img_st const *const img, color_st const color,
@@ -113,23 +94,154 @@ uint32_t amiss_draw_line(amiss_img_st const *const img, color_st const color,
                          __attribute__((unused)) bool const antialias,
                          vec2u32_st const start, vec2u32_st const end)
 {
-    return bresenham_thin(img, color, start, end);
+    if (start.x >= img->w || end.x >= img->w || start.y >= img->h ||
+        end.y >= img->h)
+    {
+        return 0;
+    }
+    uint32_t const length =
+        bresenham_thin(img, color, (vec2u32_st){.a = {0U, 0U}}, start, end);
+    PROF_COUNT(AMISS_PROF_COUNTER_SEGMENTS, 1U);
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, length + 1U);
+    return length;
 }
 
-void amiss_draw_bg_gradient(amiss_img_st const *const img,
-                            gradient_st const gradient)
+/**
+ * @brief Draw a line of a canvas that the image is only a window of, e.g. a
+ * tile drawn on its own. The pixels are those amiss_draw_line sets on the whole
+ * canvas, the ones outside of the window are skipped.
+ * @param img Window to draw on.
+ * @param color Color of the line.
+ * @param origin Where the window starts on the canvas.
+ * @param start Where the line starts on the canvas.
+ * @param end Where the line ends on the canvas.
+ */
+void amiss_draw_line_window(amiss_img_st const *const img, color_st const color,
+                            vec2u32_st const origin, vec2u32_st const start,
+                            vec2u32_st const end)
+{
+    uint64_t const x_min = start.x < end.x ? start.x : end.x;
+    uint64_t const x_max = start.x < end.x ? end.x : start.x;
+    uint64_t const y_min = start.y < end.y ? start.y : end.y;
+    uint64_t const y_max = start.y < end.y ? end.y : start.y;
+    if (x_max < origin.x || x_min >= (uint64_t)origin.x + img->w ||
+        y_max < origin.y || y_min >= (uint64_t)origin.y + img->h)
+    {
+        return; /* Misses the window. */
+    }
+    bresenham_thin(img, color, origin, start, end);
+    PROF_COUNT(AMISS_PROF_COUNTER_SEGMENTS, 1U);
+}
+
+/**
+ * @brief Draw a horizontal run of pixels. The color is written once and then
+ * copied over in doubling blocks, so long spans cost a handful of memcpy calls.
+ * @param img Image to draw on.
+ * @param color Color of the span.
+ * @param x_start First pixel of the span.
+ * @param x_end Last pixel of the span (inclusive), can be before x_start.
+ * @param y Row of the span.
+ */
+void amiss_draw_span_h(amiss_img_st const *const img, color_st const color,
+                       uint32_t const x_start, uint32_t const x_end,
+                       uint32_t const y)
+{
+    uint32_t const x_min = x_start < x_end ? x_start : x_end;
+    uint32_t x_max = x_start < x_end ? x_end : x_start;
+    if (y >= img->h || x_min >= img->w)
+    {
+        return; /* Outside of the image. */
+    }
+    if (x_max >= img->w)
+    {
+        x_max = img->w - 1U;
+    }
+    uint8_t const depth = amiss_img_depth(img);
+    uint8_t *const row = &img->b[amiss_img_xy2idx(img, depth, x_min, y)];
+    size_t const len = (size_t)(x_max - x_min + 1U) * depth;
+    amiss_img_px_encode(img, row, color.r, color.g, color.b);
+    /**
+     * Short spans, like the rows of filled shapes, would mostly be calls to
+     * memcpy so their first bytes are copied one at a time.
+     */
+    size_t done = depth;
+    for (; done < len && done < SPAN_H_BYTEWISE_LEN; ++done)
+    {
+        row[done] = row[done - depth];
+    }
+    while (done < len)
+    {
+        size_t const copy_len = done < len - done ? done : len - done;
+        memcpy(&row[done], row, copy_len);
+        done += copy_len;
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, x_max - x_min + 1U);
+}
+
+/**
+ * @brief Draw a vertical run of pixels.
+ * @param img Image to draw on.
+ * @param color Color of the span.
+ * @param x Column of the span.
+ * @param y_start First pixel of the span.
+ * @param y_end Last pixel of the span (inclusive), can be before y_start.
+ */
+void amiss_draw_span_v(amiss_img_st const *const img, color_st const color,
+                       uint32_t const x, uint32_t const y_start,
+                       uint32_t const y_end)
+{
+    uint32_t const y_min = y_start < y_end ? y_start : y_end;
+    uint32_t y_max = y_start < y_end ? y_end : y_start;
+    if (x >= img->w || y_min >= img->h)
+    {
+        return; /* Outside of the image. */
+    }
+    if (y_max >= img->h)
+    {
+        y_max = img->h - 1U;
+    }
+    uint8_t const depth = amiss_img_depth(img);
+    uint32_t const stride = amiss_img_stride(img);
+    uint8_t px_color[4U];
+    amiss_img_px_encode(img, px_color, color.r, color.g, color.b);
+    uint8_t *px = &img->b[amiss_img_xy2idx(img, depth, x, y_min)];
+    for (uint32_t y = y_min; y <= y_max; ++y)
+    {
+        memcpy(px, px_color, depth);
+        px += stride;
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, y_max - y_min + 1U);
+}
+
+/**
+ * @brief Check if a gradient can be drawn, which then covers the whole image.
+ * @param gradient Gradient to check.
+ * @return True if it has stops and none of them is outside of [0, 1].
+ */
+bool amiss_draw_gradient_valid(gradient_st const gradient)
 {
     if (gradient.count == 0)
     {
-        return;
+        return false;
     }
     for (uint32_t stop_idx = 0U; stop_idx < gradient.count; ++stop_idx)
     {
         if (gradient.stops[stop_idx] < 0.0 || gradient.stops[stop_idx] > 1.0)
         {
-            return; /* Stops can't be negative or greater than 1. */
+            return false; /* Stops can't be negative or greater than 1. */
         }
     }
+    return true;
+}
+
+void amiss_draw_bg_gradient(amiss_img_st const *const img,
+                            gradient_st const gradient)
+{
+    PROF_SCOPE("amiss_draw_bg_gradient");
+    if (amiss_draw_gradient_valid(gradient) == false)
+    {
+        return;
+    }
 
     /* Fill in space before first stop with first color. */
     uint32_t const y_stop_pre =
@@ -200,4 +312,444 @@ void amiss_draw_bg_gradient(amiss_img_st const *const img,
             amiss_draw_px_set(img, color, x_seg, y_seg);
         }
     }
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, (uint64_t)img->w * img->h);
+}
+
+/* Fractional bits of the fixed point coordinates polygons are filled with. */
+#define FILL_FRAC 8U
+#define FILL_ONE ((int64_t)1 << FILL_FRAC)
+
+/* Vertices of polygons small enough to be filled without allocating. */
+#define FILL_STACK_COUNT 64U
+
+/* Point in fixed point, whole values are at pixel centers. */
+typedef struct fill_pt_s
+{
+    int64_t x;
+    int64_t y;
+} fill_pt_st;
+
+/**
+ * Edge of a polygon stepped from one row to the next. The column it crosses the
+ * current row at is kept as the exact fraction q + r / den, so stepping never
+ * accumulates any rounding error.
+ */
+typedef struct fill_edge_s
+{
+    fill_pt_st top;
+    int64_t dx;
+    int64_t dy;
+    int64_t y_begin; /* First row crossed. */
+    int64_t y_end;   /* First row no longer crossed. */
+    int64_t q;
+    int64_t r;
+    int64_t den;
+    int64_t step_q;
+    int64_t step_r;
+    int64_t x; /* First column at or right of the crossing. */
+    int32_t winding; /* 1 if the edge goes down, -1 if it goes up. */
+} fill_edge_st;
+
+static int64_t floor_div(int64_t const a, int64_t const b)
+{
+    int64_t const q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+static int64_t ceil_div(int64_t const a, int64_t const b)
+{
+    return -floor_div(-a, b);
+}
+
+/**
+ * @brief Draw a horizontal span given by signed coordinates, clipped to the
+ * image.
+ */
+static void span_clip(amiss_img_st const *const img, color_st const color,
+                      int64_t const x_start, int64_t const x_end,
+                      int64_t const y)
+{
+    if (y < 0 || y >= img->h || x_end < 0 || x_start >= img->w ||
+        x_end < x_start)
+    {
+        return; /* Outside of the image. */
+    }
+    /* Safe casts due to bound checks. */
+    amiss_draw_span_h(img, color, x_start < 0 ? 0U : (uint32_t)x_start,
+                      x_end >= img->w ? img->w - 1U : (uint32_t)x_end,
+                      (uint32_t)y);
+}
+
+static int edge_cmp(void const *const a, void const *const b)
+{
+    int64_t const y_a = ((fill_edge_st const *)a)->y_begin;
+    int64_t const y_b = ((fill_edge_st const *)b)->y_begin;
+    return (y_a > y_b) - (y_a < y_b);
+}
+
+/**
+ * @brief Place an edge on the row it gets active on.
+ * @param edge Edge to place.
+ * @param y Row, at or below the first one the edge crosses.
+ */
+static void edge_start(fill_edge_st *const edge, int64_t const y)
+{
+    /**
+     * The crossing is at top.x + (y - top.y) * dx / dy in fixed point, the
+     * first pixel right of it is the ceiling of that in pixels.
+     */
+    int64_t const num =
+        (edge->top.x * edge->dy) + (((y * FILL_ONE) - edge->top.y) * edge->dx);
+    edge->den = edge->dy * FILL_ONE;
+    edge->q = floor_div(num, edge->den);
+    edge->r = num - (edge->q * edge->den);
+    edge->step_q = floor_div(edge->dx * FILL_ONE, edge->den);
+    edge->step_r = (edge->dx * FILL_ONE) - (edge->step_q * edge->den);
+    edge->x = edge->q + (edge->r > 0 ? 1 : 0);
+}
+
+/**
+ * @brief Move an edge down to the next row.
+ */
+static void edge_step(fill_edge_st *const edge)
+{
+    edge->q += edge->step_q;
+    edge->r += edge->step_r;
+    if (edge->r >= edge->den)
+    {
+        edge->q++;
+        edge->r -= edge->den;
+    }
+    edge->x = edge->q + (edge->r > 0 ? 1 : 0);
+}
+
+/**
+ * @brief Turn the sides of a polygon into edges, leaving out the ones that
+ * cross no row.
+ * @return Number of edges.
+ */
+static uint32_t edges_build(fill_edge_st *const edges,
+                            fill_pt_st const *const pts, uint32_t const count)
+{
+    uint32_t edge_count = 0U;
+    for (uint32_t pt_idx = 0U; pt_idx < count; ++pt_idx)
+    {
+        fill_pt_st const a = pts[pt_idx];
+        fill_pt_st const b = pts[(pt_idx + 1U) % count];
+        fill_pt_st const top = a.y < b.y ? a : b;
+        fill_pt_st const bottom = a.y < b.y ? b : a;
+        /* Rows top <= y < bottom are crossed, shared vertices count once. */
+        int64_t const y_begin = ceil_div(top.y, FILL_ONE);
+        int64_t const y_end = ceil_div(bottom.y, FILL_ONE);
+        if (y_begin >= y_end)
+        {
+            continue;
+        }
+        edges[edge_count++] = (fill_edge_st){
+            .top = top,
+            .dx = bottom.x - top.x,
+            .dy = bottom.y - top.y,
+            .y_begin = y_begin,
+            .y_end = y_end,
+            .winding = b.y > a.y ? 1 : -1,
+        };
+    }
+    return edge_count;
+}
+
+/**
+ * @brief Fill a polygon row by row with an active edge table. A pixel is filled
+ * when its center is inside, pixels whose center lies on the left or top side
+ * are in and those on the right or bottom side out, so polygons sharing a side
+ * neither overlap nor leave a gap.
+ * @param img Image to draw on.
+ * @param color Color to fill with.
+ * @param pts Vertices in fixed point, the last one connects to the first.
+ * @param count Number of vertices.
+ * @param fill How overlapping parts are filled.
+ * @return 0 on success, -1 on failure.
+ */
+static int fill_poly(amiss_img_st const *const img, color_st const color,
+                     fill_pt_st const *const pts, uint32_t const count,
+                     amiss_draw_fill_et const fill)
+{
+    fill_edge_st edges_stack[FILL_STACK_COUNT];
+    fill_edge_st *active_stack[FILL_STACK_COUNT];
+    fill_edge_st *edges = edges_stack;
+    fill_edge_st **active = active_stack;
+    if (count > FILL_STACK_COUNT)
+    {
+        edges = malloc(count * (sizeof(edges[0U]) + sizeof(active[0U])));
+        if (edges == NULL)
+        {
+            log_err("AMISS_DRAW", "Failed to allocate polygon edges\n");
+            return -1;
+        }
+        active = (fill_edge_st **)(void *)&edges[count];
+    }
+    uint32_t const edge_count = edges_build(edges, pts, count);
+    qsort(edges, edge_count, sizeof(edges[0U]), edge_cmp);
+
+    uint32_t edge_next = 0U;
+    uint32_t active_count = 0U;
+    int64_t y = edge_count > 0U && edges[0U].y_begin > 0 ? edges[0U].y_begin
+                                                          : 0;
+    /* Next row where an edge joins or leaves, the table only changes there. */
+    int64_t y_event = y;
+    while (y < img->h && (edge_next < edge_count || active_count > 0U))
+    {
+        if (y >= y_event)
+        {
+            /* Edges above the row leave, edges reaching down to it join. */
+            uint32_t kept = 0U;
+            y_event = INT64_MAX;
+            for (uint32_t active_idx = 0U; active_idx < active_count;
+                 ++active_idx)
+            {
+                if (active[active_idx]->y_end > y)
+                {
+                    active[kept++] = active[active_idx];
+                }
+            }
+            active_count = kept;
+            for (; edge_next < edge_count && edges[edge_next].y_begin <= y;
+                 ++edge_next)
+            {
+                if (edges[edge_next].y_end > y)
+                {
+                    edge_start(&edges[edge_next], y);
+                    active[active_count++] = &edges[edge_next];
+                }
+            }
+            for (uint32_t active_idx = 0U; active_idx < active_count;
+                 ++active_idx)
+            {
+                y_event = active[active_idx]->y_end < y_event
+                              ? active[active_idx]->y_end
+                              : y_event;
+            }
+            if (edge_next < edge_count && edges[edge_next].y_begin < y_event)
+            {
+                y_event = edges[edge_next].y_begin;
+            }
+            if (active_count == 0U)
+            {
+                y = y_event;
+                continue;
+            }
+        }
+
+        /* Crossings barely move between rows, insertion sort is near linear. */
+        for (uint32_t active_idx = 1U; active_idx < active_count; ++active_idx)
+        {
+            fill_edge_st *const edge = active[active_idx];
+            uint32_t idx = active_idx;
+            for (; idx > 0U && active[idx - 1U]->x > edge->x; --idx)
+            {
+                active[idx] = active[idx - 1U];
+            }
+            active[idx] = edge;
+        }
+
+        int32_t inside = 0;
+        int64_t x_in = 0;
+        for (uint32_t active_idx = 0U; active_idx < active_count; ++active_idx)
+        {
+            fill_edge_st *const edge = active[active_idx];
+            int32_t const inside_prev = inside;
+            inside = fill == AMISS_DRAW_FILL_EVEN_ODD ? inside ^ 1
+                                                      : inside + edge->winding;
+            if (inside_prev == 0 && inside != 0)
+            {
+                x_in = edge->x;
+            }
+            else if (inside_prev != 0 && inside == 0)
+            {
+                span_clip(img, color, x_in, edge->x - 1, y);
+            }
+            edge_step(edge);
+        }
+        ++y;
+    }
+
+    if (edges != edges_stack)
+    {
+        free(edges);
+    }
+    return 0;
+}
+
+/**
+ * @brief Fill a polygon, convex or not, e.g. to draw shapes in one pass rather
+ * than with many lines. Only the spans inside get written.
+ * @param img Image to draw on.
+ * @param color Color to fill with.
+ * @param pts Vertices, the last one connects to the first. Vertices are at
+ * pixel centers and the right and bottom sides are left out, so a square from
+ * (0, 0) to (10, 10) fills 10 by 10 pixels.
+ * @param count Number of vertices.
+ * @param fill How parts of the polygon that overlap themselves are filled.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_draw_polygon(amiss_img_st const *const img, color_st const color,
+                       vec2u32_st const *const pts, uint32_t const count,
+                       amiss_draw_fill_et const fill)
+{
+    if (count < 3U)
+    {
+        return 0; /* Nothing to fill. */
+    }
+    for (uint32_t pt_idx = 0U; pt_idx < count; ++pt_idx)
+    {
+        if (pts[pt_idx].x > AMISS_DRAW_COORD_MAX ||
+            pts[pt_idx].y > AMISS_DRAW_COORD_MAX)
+        {
+            return 0; /* Too far outside of the image. */
+        }
+    }
+    fill_pt_st pts_stack[FILL_STACK_COUNT];
+    fill_pt_st *fill_pts = pts_stack;
+    if (count > FILL_STACK_COUNT)
+    {
+        fill_pts = malloc(count * sizeof(fill_pts[0U]));
+        if (fill_pts == NULL)
+        {
+            log_err("AMISS_DRAW", "Failed to allocate polygon vertices\n");
+            return -1;
+        }
+    }
+    for (uint32_t pt_idx = 0U; pt_idx < count; ++pt_idx)
+    {
+        fill_pts[pt_idx] = (fill_pt_st){.x = pts[pt_idx].x * FILL_ONE,
+                                        .y = pts[pt_idx].y * FILL_ONE};
+    }
+    int const ret = fill_poly(img, color, fill_pts, count, fill);
+    if (fill_pts != pts_stack)
+    {
+        free(fill_pts);
+    }
+    return ret;
+}
+
+/**
+ * @brief Fill an axis-aligned ellipse. The half-width of every row comes from
+ * the midpoint criterion in exact integer math and only shrinks from one row
+ * to the next, so the whole shape takes O(rx + ry) steps and one span per row.
+ * @param img Image to draw on.
+ * @param color Color to fill with.
+ * @param center Center of the ellipse, it can be outside of the image.
+ * @param rx Horizontal radius, up to AMISS_DRAW_RADIUS_MAX. The ellipse is
+ * 2 * rx + 1 pixels wide.
+ * @param ry Vertical radius, up to AMISS_DRAW_RADIUS_MAX.
+ */
+void amiss_draw_ellipse(amiss_img_st const *const img, color_st const color,
+                        vec2u32_st const center, uint32_t const rx,
+                        uint32_t const ry)
+{
+    if (rx > AMISS_DRAW_RADIUS_MAX || ry > AMISS_DRAW_RADIUS_MAX)
+    {
+        return;
+    }
+    /**
+     * A pixel is in if its center is within the ellipse grown by half a pixel:
+     * (dx / (rx + 1/2))^2 + (dy / (ry + 1/2))^2 <= 1, scaled to integers.
+     */
+    int64_t const ax = (2 * (int64_t)rx) + 1;
+    int64_t const ay = (2 * (int64_t)ry) + 1;
+    int64_t const limit = ax * ax * ay * ay;
+    int64_t const cx = center.x;
+    int64_t const cy = center.y;
+    int64_t dx = rx;
+    for (int64_t dy = 0; dy <= (int64_t)ry; ++dy)
+    {
+        while (dx > 0 &&
+               (4 * dx * dx * ay * ay) + (4 * dy * dy * ax * ax) > limit)
+        {
+            --dx;
+        }
+        span_clip(img, color, cx - dx, cx + dx, cy + dy);
+        if (dy > 0)
+        {
+            span_clip(img, color, cx - dx, cx + dx, cy - dy);
+        }
+    }
+}
+
+/**
+ * @brief Fill a circle, see amiss_draw_ellipse.
+ * @param img Image to draw on.
+ * @param color Color to fill with.
+ * @param center Center of the circle, it can be outside of the image.
+ * @param r Radius, the circle is 2 * r + 1 pixels wide.
+ */
+void amiss_draw_circle(amiss_img_st const *const img, color_st const color,
+                       vec2u32_st const center, uint32_t const r)
+{
+    amiss_draw_ellipse(img, color, center, r, r);
+}
+
+/**
+ * @brief Draw connected lines of any width with round joins and caps. Every
+ * segment is filled as a quad and every vertex as a disc, all through spans.
+ * @param img Image to draw on.
+ * @param color Color of the lines.
+ * @param pts Vertices, in order.
+ * @param count Number of vertices.
+ * @param width Width of the lines in pixels, amiss_draw_line is quicker for
+ * lines 1 pixel wide.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_draw_polyline(amiss_img_st const *const img, color_st const color,
+                        vec2u32_st const *const pts, uint32_t const count,
+                        double_t const width)
+{
+    if (!(width > 0.0) || width > AMISS_DRAW_COORD_MAX)
+    {
+        return 0; /* Nothing to draw. */
+    }
+    for (uint32_t pt_idx = 0U; pt_idx < count; ++pt_idx)
+    {
+        if (pts[pt_idx].x > AMISS_DRAW_COORD_MAX ||
+            pts[pt_idx].y > AMISS_DRAW_COORD_MAX)
+        {
+            return 0; /* Too far outside of the image. */
+        }
+    }
+    double_t const half = width / 2.0;
+    /* A disc of radius r covers centers closer than about r + 1/2. */
+    uint32_t const r = (uint32_t)lround(fmax(half - 0.5, 0.0));
+    for (uint32_t pt_idx = 0U; pt_idx < count; ++pt_idx)
+    {
+        amiss_draw_circle(img, color, pts[pt_idx], r);
+    }
+    for (uint32_t pt_idx = 0U; pt_idx + 1U < count; ++pt_idx)
+    {
+        vec2u32_st const a = pts[pt_idx];
+        vec2u32_st const b = pts[pt_idx + 1U];
+        double_t const dx = (double_t)b.x - a.x;
+        double_t const dy = (double_t)b.y - a.y;
+        double_t const len = hypot(dx, dy);
+        if (len == 0.0)
+        {
+            continue; /* The disc covers it. */
+        }
+        /* Offset to either side, perpendicular to the segment. */
+        double_t const nx = -dy / len * half * FILL_ONE;
+        double_t const ny = dx / len * half * FILL_ONE;
+        double_t const ax = (double_t)a.x * FILL_ONE;
+        double_t const ay = (double_t)a.y * FILL_ONE;
+        double_t const bx = (double_t)b.x * FILL_ONE;
+        double_t const by = (double_t)b.y * FILL_ONE;
+        fill_pt_st const quad[4U] = {
+            {.x = llround(ax + nx), .y = llround(ay + ny)},
+            {.x = llround(bx + nx), .y = llround(by + ny)},
+            {.x = llround(bx - nx), .y = llround(by - ny)},
+            {.x = llround(ax - nx), .y = llround(ay - ny)},
+        };
+        if (fill_poly(img, color, quad, 4U, AMISS_DRAW_FILL_NONZERO) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
 }
@@ -0,0 +1,225 @@
+#include "amiss.h"
+#include <string.h>
+
+/* Boxes a cell holds on average when boxes don't span several cells. */
+#define CELL_BOXES 2U
+/**
+ * Cells get larger while boxes are listed in more cells than this on average,
+ * so a few long boxes don't blow up the size of the grid.
+ */
+#define BOX_CELLS_MAX 4U
+
+/* Cells a box overlaps, inclusive. */
+typedef struct cell_range_s
+{
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+} cell_range_st;
+
+static cell_range_st box_cells(amiss_box_st const bounds, uint8_t const shift,
+                               amiss_box_st const box)
+{
+    return (cell_range_st){
+        .x0 = (box.x0 - bounds.x0) >> shift,
+        .y0 = (box.y0 - bounds.y0) >> shift,
+        .x1 = (box.x1 - bounds.x0) >> shift,
+        .y1 = (box.y1 - bounds.y0) >> shift,
+    };
+}
+
+static uint64_t grid_cell_count(amiss_box_st const bounds, uint8_t const shift)
+{
+    return ((uint64_t)((bounds.x1 - bounds.x0) >> shift) + 1U) *
+           (((bounds.y1 - bounds.y0) >> shift) + 1U);
+}
+
+/**
+ * @brief Index boxes in a uniform grid. The cell size is picked so cells hold
+ * a couple of boxes each, larger if boxes would span too many cells.
+ * @param grid Grid to build.
+ * @param arena Where the cell lists are allocated from.
+ * @param boxes Boxes to index, referred to by the grid so they must outlive
+ * it. Every box must have its first corner above and left of the second.
+ * @param count Number of boxes.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_grid_build(amiss_grid_st *const grid, amiss_arena_st *const arena,
+                     amiss_box_st const *const boxes, uint32_t const count)
+{
+    PROF_SCOPE("amiss_grid_build");
+    *grid = (amiss_grid_st){
+        .boxes = boxes,
+        .box_count = count,
+        .bounds = {.x0 = UINT32_MAX, .y0 = UINT32_MAX, .x1 = 0U, .y1 = 0U},
+        .cell_shift = AMISS_GRID_CELL_SHIFT_MIN,
+        .cols = 0U,
+        .rows = 0U,
+        .cell_first = NULL,
+        .ids = NULL,
+    };
+    if (count == 0U)
+    {
+        return 0;
+    }
+    for (uint32_t box_idx = 0U; box_idx < count; ++box_idx)
+    {
+        amiss_box_st const box = boxes[box_idx];
+        grid->bounds.x0 = box.x0 < grid->bounds.x0 ? box.x0 : grid->bounds.x0;
+        grid->bounds.y0 = box.y0 < grid->bounds.y0 ? box.y0 : grid->bounds.y0;
+        grid->bounds.x1 = box.x1 > grid->bounds.x1 ? box.x1 : grid->bounds.x1;
+        grid->bounds.y1 = box.y1 > grid->bounds.y1 ? box.y1 : grid->bounds.y1;
+    }
+
+    /* Coarsen until cells hold enough boxes and boxes span few enough cells. */
+    uint8_t shift = AMISS_GRID_CELL_SHIFT_MIN;
+    while (shift < AMISS_GRID_CELL_SHIFT_MAX &&
+           grid_cell_count(grid->bounds, shift) > (count / CELL_BOXES) + 1U)
+    {
+        shift++;
+    }
+    uint64_t ref_count;
+    for (;; ++shift)
+    {
+        ref_count = 0U;
+        for (uint32_t box_idx = 0U; box_idx < count; ++box_idx)
+        {
+            cell_range_st const cells =
+                box_cells(grid->bounds, shift, boxes[box_idx]);
+            ref_count += ((uint64_t)cells.x1 - cells.x0 + 1U) *
+                         (cells.y1 - cells.y0 + 1U);
+        }
+        if (ref_count <= (uint64_t)count * BOX_CELLS_MAX ||
+            shift == AMISS_GRID_CELL_SHIFT_MAX)
+        {
+            break;
+        }
+    }
+    uint64_t const cell_count = grid_cell_count(grid->bounds, shift);
+    if (ref_count > UINT32_MAX || cell_count >= UINT32_MAX)
+    {
+        log_err("AMISS_GRID", "Too many boxes to index\n");
+        return -1;
+    }
+    grid->cell_shift = shift;
+    grid->cols = ((grid->bounds.x1 - grid->bounds.x0) >> shift) + 1U;
+    grid->rows = ((grid->bounds.y1 - grid->bounds.y0) >> shift) + 1U;
+    grid->cell_first =
+        amiss_arena_alloc(arena, (cell_count + 1U) * sizeof(uint32_t));
+    grid->ids = amiss_arena_alloc(arena, ref_count * sizeof(uint32_t));
+    if (grid->cell_first == NULL || grid->ids == NULL)
+    {
+        log_err("AMISS_GRID", "Failed to allocate grid\n");
+        return -1;
+    }
+
+    /**
+     * Count the boxes of every cell, sum them up to where each list ends and
+     * fill the lists back to front. Boxes are taken last to first so every list
+     * comes out in ascending order and ends up starting at cell_first.
+     */
+    memset(grid->cell_first, 0U, (cell_count + 1U) * sizeof(uint32_t));
+    for (uint32_t box_idx = 0U; box_idx < count; ++box_idx)
+    {
+        cell_range_st const cells =
+            box_cells(grid->bounds, shift, boxes[box_idx]);
+        for (uint32_t cy = cells.y0; cy <= cells.y1; ++cy)
+        {
+            for (uint32_t cx = cells.x0; cx <= cells.x1; ++cx)
+            {
+                grid->cell_first[(cy * grid->cols) + cx]++;
+            }
+        }
+    }
+    for (uint32_t cell_idx = 1U; cell_idx < cell_count; ++cell_idx)
+    {
+        grid->cell_first[cell_idx] += grid->cell_first[cell_idx - 1U];
+    }
+    grid->cell_first[cell_count] = (uint32_t)ref_count; /* Safe, checked. */
+    for (uint32_t box_idx = count; box_idx-- > 0U;)
+    {
+        cell_range_st const cells =
+            box_cells(grid->bounds, shift, boxes[box_idx]);
+        for (uint32_t cy = cells.y0; cy <= cells.y1; ++cy)
+        {
+            for (uint32_t cx = cells.x0; cx <= cells.x1; ++cx)
+            {
+                grid->ids[--grid->cell_first[(cy * grid->cols) + cx]] = box_idx;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Find the boxes overlapping a view. Only the cells under the view are
+ * visited, so the cost follows what's visible rather than how many boxes
+ * there are.
+ * @param grid Grid to search.
+ * @param view Part of the plane to search.
+ * @param ids Set to the indices of the boxes found, in ascending order so they
+ * can be drawn in the order they were given. Must hold box_count indices.
+ * @return Number of boxes found.
+ */
+uint32_t amiss_grid_query(amiss_grid_st const *const grid,
+                          amiss_box_st const view, uint32_t *const ids)
+{
+    PROF_SCOPE("amiss_grid_query");
+    amiss_box_st const bounds = grid->bounds;
+    if (grid->box_count == 0U || view.x1 < bounds.x0 || view.x0 > bounds.x1 ||
+        view.y1 < bounds.y0 || view.y0 > bounds.y1 || view.x1 < view.x0 ||
+        view.y1 < view.y0)
+    {
+        return 0U;
+    }
+    amiss_box_st const clamped = {
+        .x0 = view.x0 > bounds.x0 ? view.x0 : bounds.x0,
+        .y0 = view.y0 > bounds.y0 ? view.y0 : bounds.y0,
+        .x1 = view.x1 < bounds.x1 ? view.x1 : bounds.x1,
+        .y1 = view.y1 < bounds.y1 ? view.y1 : bounds.y1,
+    };
+    cell_range_st const cells = box_cells(bounds, grid->cell_shift, clamped);
+
+    /**
+     * Boxes found are marked in a bitmap at the end of ids, which takes care
+     * of boxes listed in several cells and puts them in order without sorting.
+     */
+    uint32_t const word_count = (grid->box_count + 31U) / 32U;
+    uint32_t *const found = &ids[grid->box_count - word_count];
+    memset(found, 0U, word_count * sizeof(found[0U]));
+    for (uint32_t cy = cells.y0; cy <= cells.y1; ++cy)
+    {
+        for (uint32_t cx = cells.x0; cx <= cells.x1; ++cx)
+        {
+            uint32_t const cell_idx = (cy * grid->cols) + cx;
+            for (uint32_t ref_idx = grid->cell_first[cell_idx];
+                 ref_idx < grid->cell_first[cell_idx + 1U]; ++ref_idx)
+            {
+                uint32_t const id = grid->ids[ref_idx];
+                amiss_box_st const box = grid->boxes[id];
+                if (box.x1 >= view.x0 && box.x0 <= view.x1 &&
+                    box.y1 >= view.y0 && box.y0 <= view.y1)
+                {
+                    found[id / 32U] |= 1U << (id % 32U);
+                }
+            }
+        }
+    }
+
+    /**
+     * Ids are written from the front. The ones of the first n words can't
+     * reach word n, as a word covers 32 boxes while taking up the space of one.
+     */
+    uint32_t count = 0U;
+    for (uint32_t word_idx = 0U; word_idx < word_count; ++word_idx)
+    {
+        uint32_t word = found[word_idx];
+        while (word != 0U)
+        {
+            ids[count++] = (word_idx * 32U) + (uint32_t)__builtin_ctz(word);
+            word &= word - 1U;
+        }
+    }
+    return count;
+}
@@ -3,83 +3,362 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Create an image with its buffer allocated from an arena. The contents
+ * of the buffer are undefined.
+ * @param img Image to create.
+ * @param arena Arena to allocate the buffer from.
+ * @param w Width of the image.
+ * @param h Height of the image.
+ * @param fmt Format of the image.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_img_create(amiss_img_st *const img, amiss_arena_st *const arena,
+                     uint32_t const w, uint32_t const h,
+                     amiss_img_fmt_et const fmt)
+{
+    *img = (amiss_img_st){
+        .w = w,
+        .h = h,
+        .blen = 0U,
+        .b = NULL,
+        .stride = 0U,
+        .fmt = fmt,
+        .orient = AMISS_IMG_ORIENT_TOP_DOWN,
+    };
+    uint64_t const blen = (uint64_t)w * h * amiss_img_depth(img);
+    if (blen > UINT32_MAX)
+    {
+        log_err("AMISS_IMG", "Image is too large\n");
+        return -1;
+    }
+    img->b = amiss_arena_alloc(arena, blen);
+    if (img->b == NULL)
+    {
+        log_err("AMISS_IMG", "Failed to allocate image buffer\n");
+        return -1;
+    }
+    img->blen = (uint32_t)blen; /* Safe cast due to bound check. */
+    img->stride = w * amiss_img_depth(img);
+    return 0;
+}
+
 uint8_t amiss_img_depth(amiss_img_st const *const img)
 {
-    return img->fmt == AMISS_IMG_FMT_PPM ? 3 : 1;
+    switch (img->fmt)
+    {
+    case AMISS_IMG_FMT_PPM:
+        return 3U;
+    case AMISS_IMG_FMT_ARGB32:
+        return 4U;
+    case AMISS_IMG_FMT_A8:
+    default:
+        return 1U;
+    }
+}
+
+uint32_t amiss_img_stride(amiss_img_st const *const img)
+{
+    return img->stride != 0U ? img->stride : img->w * amiss_img_depth(img);
+}
+
+/**
+ * @brief Write an opaque color as a pixel in the format of an image.
+ * @param img Image the pixel belongs to.
+ * @param px Where to write the pixel, amiss_img_depth bytes.
+ * @param r Red.
+ * @param g Green.
+ * @param b Blue.
+ */
+void amiss_img_px_encode(amiss_img_st const *const img, uint8_t *const px,
+                         uint8_t const r, uint8_t const g, uint8_t const b)
+{
+    if (img->fmt == AMISS_IMG_FMT_ARGB32)
+    {
+        /* Opaque, so premultiplying leaves the color as is. */
+        uint32_t const argb =
+            (0xFFU << 24U) | ((uint32_t)r << 16U) | ((uint32_t)g << 8U) | b;
+        memcpy(px, &argb, sizeof(argb));
+    }
+    else if (img->fmt == AMISS_IMG_FMT_A8)
+    {
+        /* Luma, integer BT.601 weights. */
+        px[0U] = (uint8_t)(((77U * r) + (150U * g) + (29U * b) + 128U) >> 8U);
+    }
+    else
+    {
+        px[0U] = r;
+        px[1U] = g;
+        px[2U] = b;
+    }
+}
+
+/**
+ * @brief Read the color of a pixel in the format of an image. Colors of
+ * translucent pixels are unpremultiplied, transparent pixels are black.
+ * @param img Image the pixel belongs to.
+ * @param px Pixel to read, amiss_img_depth bytes.
+ * @param r Set to the red of the pixel.
+ * @param g Set to the green of the pixel.
+ * @param b Set to the blue of the pixel.
+ */
+void amiss_img_px_decode(amiss_img_st const *const img, uint8_t const *const px,
+                         uint8_t *const r, uint8_t *const g, uint8_t *const b)
+{
+    if (img->fmt == AMISS_IMG_FMT_ARGB32)
+    {
+        uint32_t argb;
+        memcpy(&argb, px, sizeof(argb));
+        uint32_t const a = argb >> 24U;
+        uint32_t const channels[3U] = {(argb >> 16U) & 0xFFU,
+                                       (argb >> 8U) & 0xFFU, argb & 0xFFU};
+        uint8_t *const out[3U] = {r, g, b};
+        for (uint8_t channel_idx = 0U; channel_idx < 3U; ++channel_idx)
+        {
+            uint32_t const channel = channels[channel_idx];
+            if (a == 0U)
+            {
+                *out[channel_idx] = 0U;
+            }
+            else if (channel >= a)
+            {
+                *out[channel_idx] = 0xFFU;
+            }
+            else
+            {
+                *out[channel_idx] =
+                    (uint8_t)(((channel * 255U) + (a / 2U)) / a);
+            }
+        }
+    }
+    else if (img->fmt == AMISS_IMG_FMT_A8)
+    {
+        *r = px[0U];
+        *g = px[0U];
+        *b = px[0U];
+    }
+    else
+    {
+        *r = px[0U];
+        *g = px[1U];
+        *b = px[2U];
+    }
 }
 
 uint32_t amiss_img_xy2idx(amiss_img_st const *const img, uint8_t const depth,
                           uint32_t const x, uint32_t const y)
 {
-    return ((img->w * depth) * y) + (x * depth);
+    return (amiss_img_stride(img) * y) + (x * depth);
 }
 
+/**
+ * @brief Swap two rows of pixels in place, 128 bytes at a time using the widest
+ * vector registers available. Every byte gets loaded and stored exactly once.
+ * @param a First row.
+ * @param b Second row.
+ * @param len Length of a row in bytes.
+ */
+static void row_swap(uint8_t *const a, uint8_t *const b, uint32_t const len)
+{
+    uint32_t idx = 0U;
+#if defined(__AVX2__)
+    for (; idx + 128U <= len; idx += 128U)
+    {
+        __m256i const a0 = _mm256_loadu_si256((__m256i const *)&a[idx]);
+        __m256i const a1 = _mm256_loadu_si256((__m256i const *)&a[idx + 32U]);
+        __m256i const a2 = _mm256_loadu_si256((__m256i const *)&a[idx + 64U]);
+        __m256i const a3 = _mm256_loadu_si256((__m256i const *)&a[idx + 96U]);
+        __m256i const b0 = _mm256_loadu_si256((__m256i const *)&b[idx]);
+        __m256i const b1 = _mm256_loadu_si256((__m256i const *)&b[idx + 32U]);
+        __m256i const b2 = _mm256_loadu_si256((__m256i const *)&b[idx + 64U]);
+        __m256i const b3 = _mm256_loadu_si256((__m256i const *)&b[idx + 96U]);
+        _mm256_storeu_si256((__m256i *)&a[idx], b0);
+        _mm256_storeu_si256((__m256i *)&a[idx + 32U], b1);
+        _mm256_storeu_si256((__m256i *)&a[idx + 64U], b2);
+        _mm256_storeu_si256((__m256i *)&a[idx + 96U], b3);
+        _mm256_storeu_si256((__m256i *)&b[idx], a0);
+        _mm256_storeu_si256((__m256i *)&b[idx + 32U], a1);
+        _mm256_storeu_si256((__m256i *)&b[idx + 64U], a2);
+        _mm256_storeu_si256((__m256i *)&b[idx + 96U], a3);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; idx + 64U <= len; idx += 64U)
+    {
+        __m128i const a0 = _mm_loadu_si128((__m128i const *)&a[idx]);
+        __m128i const a1 = _mm_loadu_si128((__m128i const *)&a[idx + 16U]);
+        __m128i const a2 = _mm_loadu_si128((__m128i const *)&a[idx + 32U]);
+        __m128i const a3 = _mm_loadu_si128((__m128i const *)&a[idx + 48U]);
+        __m128i const b0 = _mm_loadu_si128((__m128i const *)&b[idx]);
+        __m128i const b1 = _mm_loadu_si128((__m128i const *)&b[idx + 16U]);
+        __m128i const b2 = _mm_loadu_si128((__m128i const *)&b[idx + 32U]);
+        __m128i const b3 = _mm_loadu_si128((__m128i const *)&b[idx + 48U]);
+        _mm_storeu_si128((__m128i *)&a[idx], b0);
+        _mm_storeu_si128((__m128i *)&a[idx + 16U], b1);
+        _mm_storeu_si128((__m128i *)&a[idx + 32U], b2);
+        _mm_storeu_si128((__m128i *)&a[idx + 48U], b3);
+        _mm_storeu_si128((__m128i *)&b[idx], a0);
+        _mm_storeu_si128((__m128i *)&b[idx + 16U], a1);
+        _mm_storeu_si128((__m128i *)&b[idx + 32U], a2);
+        _mm_storeu_si128((__m128i *)&b[idx + 48U], a3);
+    }
+#endif
+    for (; idx + 8U <= len; idx += 8U)
+    {
+        uint64_t a_word;
+        uint64_t b_word;
+        memcpy(&a_word, &a[idx], sizeof(a_word));
+        memcpy(&b_word, &b[idx], sizeof(b_word));
+        memcpy(&a[idx], &b_word, sizeof(b_word));
+        memcpy(&b[idx], &a_word, sizeof(a_word));
+    }
+    for (; idx < len; ++idx)
+    {
+        uint8_t const a_byte = a[idx];
+        a[idx] = b[idx];
+        b[idx] = a_byte;
+    }
+}
+
+/**
+ * @brief Hash the pixels of an image in the order they end up in the file.
+ * @param img Image to hash.
+ * @return Hash of the pixels.
+ */
+static uint64_t img_hash(amiss_img_st const *const img)
+{
+    uint8_t const depth = amiss_img_depth(img);
+    uint64_t hash = AMISS_HASH_INIT;
+    for (uint32_t y = 0U; y < img->h; ++y)
+    {
+        uint32_t const y_buf =
+            img->orient == AMISS_IMG_ORIENT_BOTTOM_UP ? img->h - y - 1U : y;
+        hash = amiss_hash(hash,
+                          &img->b[amiss_img_xy2idx(img, depth, 0U, y_buf)],
+                          img->w * depth);
+    }
+    return hash;
+}
+
+/**
+ * @brief Write the rows of an image as packed RGB, in the order they are shown.
+ * @param img Image to write.
+ * @param f File to write to.
+ * @return Number of pixels written.
+ */
+static uint64_t img_rows_write(amiss_img_st const *const img, FILE *const f)
+{
+    uint8_t const depth = amiss_img_depth(img);
+    if (img->fmt == AMISS_IMG_FMT_PPM &&
+        img->orient == AMISS_IMG_ORIENT_TOP_DOWN &&
+        amiss_img_stride(img) == img->w * depth)
+    {
+        return fwrite(img->b, sizeof(img->b[0]) * 3 /* RGB */,
+                      (size_t)img->w * img->h, f);
+    }
+
+    uint8_t *row_rgb = NULL;
+    if (img->fmt != AMISS_IMG_FMT_PPM)
+    {
+        row_rgb = malloc((size_t)img->w * 3U /* RGB */);
+        if (row_rgb == NULL)
+        {
+            log_err("AMISS_IMG", "Failed to allocate row\n");
+            return 0U;
+        }
+    }
+    uint64_t pix_written = 0U;
+    for (uint32_t y = 0U; y < img->h; ++y)
+    {
+        /* Bottom-up rows are emitted last to first instead of flipping. */
+        uint32_t const y_buf =
+            img->orient == AMISS_IMG_ORIENT_BOTTOM_UP ? img->h - y - 1U : y;
+        uint8_t const *row = &img->b[amiss_img_xy2idx(img, depth, 0U, y_buf)];
+        if (row_rgb != NULL)
+        {
+            for (uint32_t x = 0U; x < img->w; ++x)
+            {
+                amiss_img_px_decode(img, &row[x * depth],
+                                    &row_rgb[x * 3U /* RGB */],
+                                    &row_rgb[(x * 3U /* RGB */) + 1U],
+                                    &row_rgb[(x * 3U /* RGB */) + 2U]);
+            }
+            row = row_rgb;
+        }
+        pix_written += fwrite(row, sizeof(img->b[0]) * 3 /* RGB */, img->w, f);
+    }
+    free(row_rgb);
+    return pix_written;
+}
+
+/**
+ * @brief Save an image as a binary PPM. Images with alpha are saved as if
+ * composited over black.
+ * @param img Image to save.
+ * @param path Where to save it.
+ * @return 0 on success, -1 on failure.
+ */
 int amiss_img_save(amiss_img_st const *const img, char const *const path)
 {
+    PROF_SCOPE("amiss_img_save");
+    uint64_t const t_begin = amiss_stage_now();
+    if (img->h > 0U &&
+        img->blen < ((uint64_t)amiss_img_stride(img) * (img->h - 1U)) +
+                        ((uint64_t)img->w * amiss_img_depth(img)))
+    {
+        log_err("AMISS_IMG",
+                "Image buffer is too small to contain the image\n");
+        return -1;
+    }
     int32_t ret = 0;
-    FILE *f = fopen(path, "w");
+    FILE *f = fopen(path, "wb");
     if (f == NULL)
     {
         log_err("AMISS_IMG", "Failed to create/open file: %s\n", strerror(ret));
         return -1;
     }
 
-    switch (img->fmt)
+    ret = fprintf(f, "P6\n%u %u\n255\n", img->w, img->h);
+    PROF_COUNT(AMISS_PROF_COUNTER_BYTES, ret > 0 ? (uint64_t)ret : 0U);
+    uint64_t const pix_written = img_rows_write(img, f);
+    if (pix_written != (uint64_t)img->w * img->h)
     {
-    case AMISS_IMG_FMT_PPM:
-        ret = fprintf(f, "P6\n%u %u\n255\n", img->w, img->h);
-        uint32_t const img_size = img->w * img->h;
-        if (img->blen < img_size * 3 /* RGB */)
-        {
-            log_err("AMISS_IMG",
-                    "Image buffer is too small to contain the image\n");
-            return -1;
-        }
-        uint64_t const pix_written =
-            fwrite(img->b, sizeof(img->b[0]) * 3 /* RGB */, img_size, f);
-        if (pix_written != img_size)
+        log_err("AMISS_IMG", "Failed to write pixels\n");
+        ret = fclose(f);
+        if (ret < 0)
         {
-            log_err("AMISS_IMG", "Failed to write pixels\n");
-            ret = fclose(f);
-            if (ret < 0)
-            {
-                log_warn("AMISS_IMG", "Failed to close file: %s\n",
-                         strerror(ret));
-            }
-            return -1;
+            log_warn("AMISS_IMG", "Failed to close file: %s\n", strerror(ret));
         }
-        break;
+        return -1;
     }
+    PROF_COUNT(AMISS_PROF_COUNTER_BYTES, pix_written * 3U /* RGB */);
 
     ret = fclose(f);
     if (ret < 0)
     {
         log_warn("AMISS_IMG", "Failed to close file: %s\n", strerror(ret));
     }
+    amiss_stage_end(AMISS_STAGE_SAVE, t_begin);
+    if (amiss_stage_enabled() == 1)
+    {
+        amiss_stage_output(path, img_hash(img));
+    }
     return 0;
 }
 
 void amiss_img_flip_vert(amiss_img_st const *const img)
 {
+    PROF_SCOPE("amiss_img_flip_vert");
     uint8_t const depth = amiss_img_depth(img);
-    uint32_t const line_size = img->w * depth;
-    uint8_t *line_tmp = malloc(line_size);
-    if (line_tmp == NULL)
-    {
-        log_err("AMISS_IMG", "Failed to flip image\n");
-        free(line_tmp);
-        return;
-    }
-
+    uint32_t const line_size = img->w * depth; /* Padding is left alone. */
     for (uint32_t y = 0; y < (img->h / 2); ++y)
     {
-        memcpy(line_tmp, &img->b[amiss_img_xy2idx(img, depth, 0, y)],
-               line_size);
-        memcpy(&img->b[amiss_img_xy2idx(img, depth, 0, y)],
-               &img->b[amiss_img_xy2idx(img, depth, 0, img->h - y - 1)],
-               line_size);
-        memcpy(&img->b[amiss_img_xy2idx(img, depth, 0, img->h - y - 1)],
-               line_tmp, line_size);
+        row_swap(&img->b[amiss_img_xy2idx(img, depth, 0, y)],
+                 &img->b[amiss_img_xy2idx(img, depth, 0, img->h - y - 1)],
+                 line_size);
     }
-    free(line_tmp);
 }
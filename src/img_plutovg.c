@@ -0,0 +1,54 @@
+/* Kept apart from img.c so only programs sharing surfaces need plutovg. */
+#include "amiss.h"
+#include "plutovg.h"
+
+/**
+ * @brief Wrap the pixels of a plutovg surface as an image, so amiss can draw
+ * on them and plutovg sees the result without any conversion.
+ * @param img Image to set up, it shares the buffer of the surface which has to
+ * outlive it.
+ * @param surface Surface to wrap.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_img_from_surface(amiss_img_st *const img,
+                           struct plutovg_surface *const surface)
+{
+    int const w = plutovg_surface_get_width(surface);
+    int const h = plutovg_surface_get_height(surface);
+    int const stride = plutovg_surface_get_stride(surface);
+    if (w < 0 || h < 0 || stride < w * 4 /* ARGB */ ||
+        (uint64_t)stride * (uint64_t)h > UINT32_MAX)
+    {
+        log_err("AMISS_IMG", "Surface can not be wrapped\n");
+        return -1;
+    }
+    *img = (amiss_img_st){
+        .w = (uint32_t)w,
+        .h = (uint32_t)h,
+        .blen = (uint32_t)(stride * h), /* Safe cast due to bound check. */
+        .b = plutovg_surface_get_data(surface),
+        .stride = (uint32_t)stride,
+        .fmt = AMISS_IMG_FMT_ARGB32,
+        .orient = AMISS_IMG_ORIENT_TOP_DOWN,
+    };
+    return 0;
+}
+
+/**
+ * @brief Create a plutovg surface drawing on the pixels of an image, so
+ * plutovg can stroke on top of what amiss drew without any conversion.
+ * @param img Image to share, it has to be ARGB32, top-down and outlive the
+ * surface.
+ * @return The surface, to be destroyed by the caller. NULL on failure.
+ */
+struct plutovg_surface *amiss_img_to_surface(amiss_img_st const *const img)
+{
+    if (img->fmt != AMISS_IMG_FMT_ARGB32 ||
+        img->orient != AMISS_IMG_ORIENT_TOP_DOWN)
+    {
+        log_err("AMISS_IMG", "Only top-down ARGB32 images can be shared\n");
+        return NULL;
+    }
+    return plutovg_surface_create_for_data(img->b, (int)img->w, (int)img->h,
+                                           (int)amiss_img_stride(img));
+}
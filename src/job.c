@@ -0,0 +1,302 @@
+#include "amiss.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief Take a job from a deque.
+ * @param deque Deque to take from.
+ * @param steal Take the oldest job instead of the newest.
+ * @return The job, NULL if the deque is empty.
+ */
+static amiss_job_st *deque_take(amiss_job_deque_st *const deque,
+                                bool const steal)
+{
+    amiss_job_st *job = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head != deque->tail)
+    {
+        job = steal == true ? deque->jobs[deque->head++]
+                            : deque->jobs[--deque->tail];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+/**
+ * @brief Find a job for a worker, first in its own deque then in the deques
+ * of the others starting with its neighbor.
+ * @param worker Worker looking for a job.
+ * @return The job, NULL if all deques are empty.
+ */
+static amiss_job_st *worker_job_find(amiss_job_worker_st *const worker)
+{
+    amiss_job_pool_st *const pool = worker->pool;
+    amiss_job_st *job = deque_take(&worker->deque, false);
+    for (uint32_t victim_off = 1U;
+         job == NULL && victim_off < pool->worker_count; ++victim_off)
+    {
+        uint32_t const victim_idx =
+            (worker->idx + victim_off) % pool->worker_count;
+        job = deque_take(&pool->workers[victim_idx].deque, true);
+    }
+    return job;
+}
+
+static void *worker_run(void *const arg)
+{
+    amiss_job_worker_st *const worker = arg;
+    amiss_job_pool_st *const pool = worker->pool;
+    for (;;)
+    {
+        amiss_job_st *const job = worker_job_find(worker);
+        pthread_mutex_lock(&pool->lock);
+        if (job == NULL)
+        {
+            while (pool->queued == 0U && pool->stop == false)
+            {
+                pthread_cond_wait(&pool->cond, &pool->lock);
+            }
+            bool const stop = pool->stop && pool->queued == 0U;
+            pthread_mutex_unlock(&pool->lock);
+            if (stop == true)
+            {
+                return NULL;
+            }
+            continue;
+        }
+
+        /**
+         * Wait for running jobs to free up enough of the budget. Held memory
+         * may only be released by the jobs waiting, so it's not waited on
+         * once nothing runs.
+         */
+        pool->queued--;
+        while (pool->mem_budget > 0U && pool->running > 0U &&
+               pool->mem_used + job->mem > pool->mem_budget)
+        {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        pool->mem_used += job->mem;
+        pool->running++;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->ret = job->fn(job->arg, &worker->arena);
+        amiss_arena_reset(&worker->arena);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->mem_used -= job->mem;
+        pool->running--;
+        pool->pending--;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief Stop the workers once they are idle and free what they were given.
+ * @param pool Pool to tear down.
+ * @param init_count Number of workers with an arena and deque set up.
+ * @param thread_count Number of workers with a running thread, at most
+ * init_count.
+ */
+static void pool_teardown(amiss_job_pool_st *const pool,
+                          uint32_t const init_count,
+                          uint32_t const thread_count)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (uint32_t worker_idx = 0U; worker_idx < thread_count; ++worker_idx)
+    {
+        pthread_join(pool->workers[worker_idx].thread, NULL);
+    }
+    for (uint32_t worker_idx = 0U; worker_idx < init_count; ++worker_idx)
+    {
+        amiss_job_worker_st *const worker = &pool->workers[worker_idx];
+        amiss_arena_free(&worker->arena);
+        pthread_mutex_destroy(&worker->deque.lock);
+        free(worker->deque.jobs);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->worker_count = 0U;
+}
+
+/**
+ * @brief Start a pool of workers. Each gets its own arena.
+ * @param pool Pool to start.
+ * @param worker_count Number of workers, 0 for one per online CPU.
+ * @param mem_budget Memory running jobs may hold at once, 0 for no limit.
+ * @param arena_chunk_size Chunk size of the arenas of the workers.
+ * @param arena_flags Flags of the arenas of the workers.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_job_pool_init(amiss_job_pool_st *const pool,
+                        uint32_t const worker_count, size_t const mem_budget,
+                        size_t const arena_chunk_size,
+                        uint32_t const arena_flags)
+{
+    pool->worker_count = worker_count;
+    if (pool->worker_count == 0U)
+    {
+#if defined(_SC_NPROCESSORS_ONLN)
+        long const cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        pool->worker_count = cpu_count > 0 ? (uint32_t)cpu_count : 1U;
+#else
+        pool->worker_count = 1U;
+#endif
+    }
+    pool->mem_budget = mem_budget;
+    pool->mem_used = 0U;
+    pool->running = 0U;
+    pool->queued = 0U;
+    pool->pending = 0U;
+    pool->stop = false;
+    pool->workers = calloc(pool->worker_count, sizeof(pool->workers[0U]));
+    if (pool->workers == NULL)
+    {
+        log_err("AMISS_JOB", "Failed to allocate workers\n");
+        return -1;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    /* Workers steal from each other, so all are set up before any starts. */
+    for (uint32_t worker_idx = 0U; worker_idx < pool->worker_count;
+         ++worker_idx)
+    {
+        amiss_job_worker_st *const worker = &pool->workers[worker_idx];
+        worker->pool = pool;
+        worker->idx = worker_idx;
+        if (amiss_arena_init(&worker->arena, arena_chunk_size, arena_flags) !=
+            0)
+        {
+            pool_teardown(pool, worker_idx, 0U);
+            return -1;
+        }
+        pthread_mutex_init(&worker->deque.lock, NULL);
+    }
+    for (uint32_t worker_idx = 0U; worker_idx < pool->worker_count;
+         ++worker_idx)
+    {
+        amiss_job_worker_st *const worker = &pool->workers[worker_idx];
+        if (pthread_create(&worker->thread, NULL, worker_run, worker) != 0)
+        {
+            log_err("AMISS_JOB", "Failed to start worker %u\n", worker_idx);
+            pool_teardown(pool, pool->worker_count, worker_idx);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Run jobs on a pool and wait for all of them to finish. Jobs run in no
+ * particular order, so they must not depend on each other.
+ * @param pool Pool to run the jobs on.
+ * @param jobs Jobs to run, their ret gets set.
+ * @param job_count Number of jobs.
+ * @return 0 if all jobs succeeded, -1 if any failed or they could not be
+ * queued.
+ */
+int amiss_job_pool_run(amiss_job_pool_st *const pool, amiss_job_st *const jobs,
+                       uint32_t const job_count)
+{
+    uint32_t const cap = (job_count + pool->worker_count - 1U) /
+                         pool->worker_count;
+    pthread_mutex_lock(&pool->lock);
+    /* Deques only grow, and all of them do before any job is queued. */
+    for (uint32_t worker_idx = 0U; worker_idx < pool->worker_count;
+         ++worker_idx)
+    {
+        amiss_job_deque_st *const deque = &pool->workers[worker_idx].deque;
+        pthread_mutex_lock(&deque->lock);
+        if (cap > deque->cap)
+        {
+            amiss_job_st **const deque_jobs =
+                realloc(deque->jobs, cap * sizeof(deque_jobs[0U]));
+            if (deque_jobs == NULL)
+            {
+                log_err("AMISS_JOB", "Failed to allocate deque\n");
+                pthread_mutex_unlock(&deque->lock);
+                pthread_mutex_unlock(&pool->lock);
+                return -1;
+            }
+            deque->jobs = deque_jobs;
+            deque->cap = cap;
+        }
+        pthread_mutex_unlock(&deque->lock);
+    }
+    for (uint32_t worker_idx = 0U; worker_idx < pool->worker_count;
+         ++worker_idx)
+    {
+        amiss_job_deque_st *const deque = &pool->workers[worker_idx].deque;
+        pthread_mutex_lock(&deque->lock);
+        deque->head = 0U;
+        deque->tail = 0U;
+        /* Jobs are dealt round-robin so neighbors in the list spread out. */
+        for (uint32_t job_idx = worker_idx; job_idx < job_count;
+             job_idx += pool->worker_count)
+        {
+            deque->jobs[deque->tail++] = &jobs[job_idx];
+        }
+        pthread_mutex_unlock(&deque->lock);
+    }
+    pool->queued += job_count;
+    pool->pending += job_count;
+    pthread_cond_broadcast(&pool->cond);
+    while (pool->pending > 0U)
+    {
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    int ret = 0;
+    for (uint32_t job_idx = 0U; job_idx < job_count; ++job_idx)
+    {
+        if (jobs[job_idx].ret != 0)
+        {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Count memory against the budget of a pool beyond the job that
+ * allocated it, e.g. a result that later jobs read.
+ * @param pool Pool whose budget to use.
+ * @param mem Memory to hold until amiss_job_pool_release gives it back.
+ */
+void amiss_job_pool_hold(amiss_job_pool_st *const pool, size_t const mem)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->mem_used += mem;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Give back memory held with amiss_job_pool_hold, safe to call from a
+ * job.
+ * @param pool Pool the memory is held against.
+ * @param mem Memory to give back, at most what is held.
+ */
+void amiss_job_pool_release(amiss_job_pool_st *const pool, size_t const mem)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->mem_used -= mem;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Stop all workers once they are idle and free the pool.
+ * @param pool Pool to free.
+ */
+void amiss_job_pool_free(amiss_job_pool_st *const pool)
+{
+    pool_teardown(pool, pool->worker_count, pool->worker_count);
+}
@@ -0,0 +1,635 @@
+#include "amiss.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Records per thread ring, has to be a power of 2. */
+#define RING_SIZE 256U
+/* Arguments a single log call can have, the rest are dropped. */
+#define ARG_COUNT_MAX 16U
+/* Room for copies of string arguments, longer strings get truncated. */
+#define STR_SIZE 512U
+/* Longest formatted line, longer ones get truncated. */
+#define LINE_SIZE 4096U
+/* How long the formatter sleeps when all rings are empty. */
+#define IDLE_NS 200000L
+
+typedef enum log_arg_kind_e
+{
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+} log_arg_kind_et;
+
+typedef struct log_arg_s
+{
+    log_arg_kind_et kind;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        void const *p;
+        uint32_t str_off; /* Offset of the copied string in the record. */
+    } v;
+} log_arg_st;
+
+/**
+ * A log call captured as is, it only gets formatted by the background thread.
+ * Everything but the arguments has to be a string literal (which LOG_FMT
+ * guarantees) so only pointers to them are kept.
+ */
+typedef struct log_record_s
+{
+    uint64_t seq; /* Orders records across threads. */
+    char const *color;
+    char const *level_str;
+    char const *tag;
+    char const *file;
+    char const *fmt;
+    int line;
+    uint32_t arg_count;
+    uint32_t str_used;
+    log_arg_st args[ARG_COUNT_MAX];
+    char str[STR_SIZE];
+} log_record_st;
+
+/**
+ * Single producer single consumer ring. The owning thread is the only one
+ * moving tail, the background thread the only one moving head. Rings are never
+ * freed so lines logged by threads that already exited still get printed.
+ */
+typedef struct log_ring_s log_ring_st;
+struct log_ring_s
+{
+    log_ring_st *next;
+    atomic_uint head;
+    atomic_uint tail;
+    log_record_st records[RING_SIZE];
+};
+
+static _Atomic(log_ring_st *) log_rings = NULL;
+static _Thread_local log_ring_st *log_ring = NULL;
+static atomic_uint_fast64_t log_seq;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_t log_thread;
+static atomic_bool log_async;
+static atomic_bool log_stop;
+
+/**
+ * @brief Skip over one conversion specification of a format string and work
+ * out what argument it consumes.
+ * @param spec Points at the character after '%'.
+ * @param star_count Set to the number of '*' widths and precisions, each takes
+ * an int argument before the value.
+ * @param kind Set to what the value is passed as.
+ * @param len_mod Set to the length modifier, 'H' for hh and 'L' for ll.
+ * @return Pointer to the conversion character.
+ */
+static char const *spec_parse(char const *spec, uint32_t *const star_count,
+                              log_arg_kind_et *const kind, char *const len_mod)
+{
+    *star_count = 0U;
+    *len_mod = '\0';
+    while (*spec == '-' || *spec == '+' || *spec == ' ' || *spec == '#' ||
+           *spec == '0')
+    {
+        spec++;
+    }
+    for (uint32_t part = 0U; part < 2U; ++part)
+    {
+        if (part == 1U)
+        {
+            if (*spec != '.')
+            {
+                break;
+            }
+            spec++;
+        }
+        if (*spec == '*')
+        {
+            (*star_count)++;
+            spec++;
+        }
+        while (*spec >= '0' && *spec <= '9')
+        {
+            spec++;
+        }
+    }
+    if (*spec == 'h' || *spec == 'l')
+    {
+        *len_mod = spec[1] == spec[0] ? (spec[0] == 'h' ? 'H' : 'L') : spec[0];
+        spec += spec[1] == spec[0] ? 2 : 1;
+    }
+    else if (*spec == 'z' || *spec == 'j' || *spec == 't' || *spec == 'L')
+    {
+        *len_mod = *spec;
+        spec++;
+    }
+    switch (*spec)
+    {
+    case 'd':
+    case 'i':
+    case 'c':
+        *kind = LOG_ARG_INT;
+        break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        *kind = LOG_ARG_UINT;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        *kind = LOG_ARG_DOUBLE;
+        break;
+    case 'p':
+        *kind = LOG_ARG_PTR;
+        break;
+    case 's':
+        *kind = LOG_ARG_STR;
+        break;
+    default:
+        *kind = LOG_ARG_PTR; /* Unsupported, nothing gets consumed. */
+        break;
+    }
+    return spec;
+}
+
+/**
+ * @brief Copy the arguments of a log call into a record.
+ * @param record Record to fill.
+ * @param ap Arguments matching the format of the record.
+ */
+static void record_capture(log_record_st *const record, va_list ap)
+{
+    record->arg_count = 0U;
+    record->str_used = 0U;
+    for (char const *c = record->fmt; *c != '\0'; ++c)
+    {
+        if (*c != '%')
+        {
+            continue;
+        }
+        if (c[1] == '%')
+        {
+            c++;
+            continue;
+        }
+        uint32_t star_count;
+        log_arg_kind_et kind;
+        char len_mod;
+        char const *const spec = c + 1;
+        c = spec_parse(spec, &star_count, &kind, &len_mod);
+        if (*c == '\0')
+        {
+            break;
+        }
+        bool prec_star = false;
+        for (char const *s = spec; s + 1 < c; ++s)
+        {
+            prec_star |= s[0] == '.' && s[1] == '*';
+        }
+        if (strchr("diucxXofFeEgGaAps", *c) == NULL)
+        {
+            continue;
+        }
+        if (record->arg_count + star_count + 1U > ARG_COUNT_MAX)
+        {
+            break;
+        }
+
+        int precision = -1;
+        for (uint32_t star_idx = 0U; star_idx < star_count; ++star_idx)
+        {
+            log_arg_st *const arg = &record->args[record->arg_count++];
+            arg->kind = LOG_ARG_INT;
+            arg->v.i = va_arg(ap, int);
+            if (prec_star == true && star_idx + 1U == star_count)
+            {
+                precision = (int)arg->v.i;
+            }
+        }
+
+        log_arg_st *const arg = &record->args[record->arg_count++];
+        arg->kind = kind;
+        switch (kind)
+        {
+        case LOG_ARG_INT:
+            switch (len_mod)
+            {
+            case 'H':
+                arg->v.i = (signed char)va_arg(ap, int);
+                break;
+            case 'h':
+                arg->v.i = (short)va_arg(ap, int);
+                break;
+            case 'l':
+                arg->v.i = va_arg(ap, long);
+                break;
+            case 'L':
+                arg->v.i = va_arg(ap, long long);
+                break;
+            case 'z':
+                arg->v.i = (int64_t)va_arg(ap, size_t);
+                break;
+            case 'j':
+                arg->v.i = va_arg(ap, intmax_t);
+                break;
+            case 't':
+                arg->v.i = va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                arg->v.i = va_arg(ap, int);
+                break;
+            }
+            break;
+        case LOG_ARG_UINT:
+            switch (len_mod)
+            {
+            case 'H':
+                arg->v.u = (unsigned char)va_arg(ap, unsigned int);
+                break;
+            case 'h':
+                arg->v.u = (unsigned short)va_arg(ap, unsigned int);
+                break;
+            case 'l':
+                arg->v.u = va_arg(ap, unsigned long);
+                break;
+            case 'L':
+                arg->v.u = va_arg(ap, unsigned long long);
+                break;
+            case 'z':
+                arg->v.u = va_arg(ap, size_t);
+                break;
+            case 'j':
+                arg->v.u = va_arg(ap, uintmax_t);
+                break;
+            case 't':
+                arg->v.u = (uint64_t)va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                arg->v.u = va_arg(ap, unsigned int);
+                break;
+            }
+            break;
+        case LOG_ARG_DOUBLE:
+            arg->v.d = len_mod == 'L' ? (double)va_arg(ap, long double)
+                                      : va_arg(ap, double);
+            break;
+        case LOG_ARG_PTR:
+            arg->v.p = va_arg(ap, void *);
+            break;
+        case LOG_ARG_STR:
+        {
+            char const *str = va_arg(ap, char const *);
+            if (str == NULL)
+            {
+                str = "(null)";
+            }
+            if (record->str_used >= STR_SIZE)
+            {
+                /* No room left, point at the terminator of the last string. */
+                arg->v.str_off = STR_SIZE - 1U;
+                break;
+            }
+            /* Only copy what gets printed, it's bounded by the precision. */
+            size_t str_len = 0U;
+            size_t const str_room = STR_SIZE - record->str_used - 1U;
+            while (str_len < str_room &&
+                   (precision < 0 || str_len < (size_t)precision) &&
+                   str[str_len] != '\0')
+            {
+                str_len++;
+            }
+            arg->v.str_off = record->str_used;
+            memcpy(&record->str[record->str_used], str, str_len);
+            record->str[record->str_used + str_len] = '\0';
+            record->str_used += (uint32_t)str_len + 1U;
+            break;
+        }
+        }
+    }
+}
+
+/**
+ * @brief Format a record into one line.
+ * @param record Record to format.
+ * @param line Where the line is written.
+ * @return Length of the line.
+ */
+static size_t record_format(log_record_st const *const record,
+                            char line[LINE_SIZE])
+{
+    int len = snprintf(line, LINE_SIZE, "%s|%-8s|%-5s|%4d:%-16s|" CLR_DEF,
+                       record->color, record->tag, record->level_str,
+                       record->line, record->file);
+    uint32_t arg_idx = 0U;
+    char const *c = record->fmt;
+    while (*c != '\0' && len >= 0 && len < (int)LINE_SIZE)
+    {
+        char const *const text_end = strchr(c, '%');
+        if (text_end == NULL || text_end[1] == '%')
+        {
+            size_t const text_len =
+                text_end == NULL ? strlen(c) : (size_t)(text_end - c) + 1U;
+            len += snprintf(&line[len], LINE_SIZE - (size_t)len, "%.*s",
+                            (int)text_len, c);
+            c += text_len + (text_end == NULL ? 0U : 1U);
+            continue;
+        }
+        if (text_end != c)
+        {
+            len += snprintf(&line[len], LINE_SIZE - (size_t)len, "%.*s",
+                            (int)(text_end - c), c);
+            c = text_end;
+            continue;
+        }
+
+        /**
+         * Rebuild the conversion with '*' replaced by the captured values and
+         * the length modifier replaced by one matching how the value was kept.
+         */
+        uint32_t star_count;
+        log_arg_kind_et kind;
+        char len_mod;
+        char const *const conv = spec_parse(c + 1, &star_count, &kind,
+                                            &len_mod);
+        if (*conv == '\0' || arg_idx + star_count + 1U > record->arg_count)
+        {
+            break;
+        }
+        if (strchr("diucxXofFeEgGaAps", *conv) == NULL)
+        {
+            /* Unsupported conversions didn't consume arguments, skip them. */
+            c = conv + 1;
+            continue;
+        }
+        char spec[64U];
+        size_t spec_len = 0U;
+        for (char const *s = c; s < conv && spec_len + 24U < sizeof(spec);
+             ++s)
+        {
+            if (*s == '*' && spec_len > 0U && spec[spec_len - 1U] == '.' &&
+                record->args[arg_idx].v.i < 0)
+            {
+                /* A negative precision counts as if it was left out. */
+                spec_len--;
+                arg_idx++;
+            }
+            else if (*s == '*')
+            {
+                spec_len += (size_t)snprintf(
+                    &spec[spec_len], sizeof(spec) - spec_len, "%lld",
+                    (long long)record->args[arg_idx++].v.i);
+            }
+            else if (strchr("hlzjtL", *s) == NULL)
+            {
+                spec[spec_len++] = *s;
+            }
+        }
+        log_arg_st const *const arg = &record->args[arg_idx++];
+        switch (arg->kind)
+        {
+        case LOG_ARG_INT:
+        case LOG_ARG_UINT:
+            if (*conv != 'c')
+            {
+                spec[spec_len++] = 'l';
+                spec[spec_len++] = 'l';
+            }
+            break;
+        default:
+            break;
+        }
+        spec[spec_len++] = *conv;
+        spec[spec_len] = '\0';
+
+        char *const out = &line[len];
+        size_t const out_size = LINE_SIZE - (size_t)len;
+        int out_len = 0;
+        /* The spec comes from a literal format checked at the call site. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+        switch (arg->kind)
+        {
+        case LOG_ARG_INT:
+            out_len = *conv == 'c'
+                          ? snprintf(out, out_size, spec, (int)arg->v.i)
+                          : snprintf(out, out_size, spec, (long long)arg->v.i);
+            break;
+        case LOG_ARG_UINT:
+            out_len = snprintf(out, out_size, spec, (unsigned long long)arg->v.u);
+            break;
+        case LOG_ARG_DOUBLE:
+            out_len = snprintf(out, out_size, spec, arg->v.d);
+            break;
+        case LOG_ARG_PTR:
+            out_len = snprintf(out, out_size, spec, arg->v.p);
+            break;
+        case LOG_ARG_STR:
+            out_len =
+                snprintf(out, out_size, spec, &record->str[arg->v.str_off]);
+            break;
+        }
+#pragma GCC diagnostic pop
+        len += out_len;
+        c = conv + 1;
+    }
+    if (len < 0)
+    {
+        return 0U;
+    }
+    if ((size_t)len >= LINE_SIZE)
+    {
+        /* Keep the line break of truncated lines. */
+        line[LINE_SIZE - 2U] = '\n';
+        return LINE_SIZE - 1U;
+    }
+    return (size_t)len;
+}
+
+static void record_print(log_record_st const *const record)
+{
+    char line[LINE_SIZE];
+    size_t const len = record_format(record, line);
+    fwrite(line, 1U, len, stdout);
+}
+
+/**
+ * @brief Format the oldest pending record of all rings.
+ * @return True if a record was printed, false if all rings are empty.
+ */
+static bool rings_drain_one(void)
+{
+    log_ring_st *oldest = NULL;
+    uint64_t seq_oldest = UINT64_MAX;
+    for (log_ring_st *ring = atomic_load(&log_rings); ring != NULL;
+         ring = ring->next)
+    {
+        uint32_t const head =
+            atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint32_t const tail =
+            atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head != tail &&
+            ring->records[head & (RING_SIZE - 1U)].seq < seq_oldest)
+        {
+            oldest = ring;
+            seq_oldest = ring->records[head & (RING_SIZE - 1U)].seq;
+        }
+    }
+    if (oldest == NULL)
+    {
+        return false;
+    }
+    uint32_t const head =
+        atomic_load_explicit(&oldest->head, memory_order_relaxed);
+    record_print(&oldest->records[head & (RING_SIZE - 1U)]);
+    atomic_store_explicit(&oldest->head, head + 1U, memory_order_release);
+    return true;
+}
+
+static void *log_thread_run(void *const arg)
+{
+    struct timespec const idle = {.tv_sec = 0, .tv_nsec = IDLE_NS};
+    for (;;)
+    {
+        bool const stop = atomic_load(&log_stop);
+        bool printed = false;
+        while (rings_drain_one() == true)
+        {
+            printed = true;
+        }
+        if (printed == true)
+        {
+            fflush(stdout);
+        }
+        else if (stop == true)
+        {
+            break;
+        }
+        else
+        {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Print everything still pending and stop the formatter. Registered
+ * with atexit.
+ */
+static void log_flush(void)
+{
+    atomic_store(&log_stop, true);
+    pthread_join(log_thread, NULL);
+    /* Lines logged by later exit handlers get printed right away. */
+    atomic_store(&log_async, false);
+}
+
+static void log_start(void)
+{
+    if (pthread_create(&log_thread, NULL, log_thread_run, NULL) != 0)
+    {
+        /* Records get formatted by the threads writing them instead. */
+        return;
+    }
+    atomic_store(&log_async, true);
+    atexit(log_flush);
+}
+
+/**
+ * @brief Get the ring of the calling thread, creating it on first use.
+ * @return The ring, NULL if it could not be allocated.
+ */
+static log_ring_st *log_ring_get(void)
+{
+    if (log_ring != NULL)
+    {
+        return log_ring;
+    }
+    log_ring_st *const ring = malloc(sizeof(*ring));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    atomic_init(&ring->head, 0U);
+    atomic_init(&ring->tail, 0U);
+    log_ring_st *head = atomic_load(&log_rings);
+    do
+    {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak(&log_rings, &head, ring));
+    log_ring = ring;
+    return ring;
+}
+
+/**
+ * @brief Queue a log line for the background formatter. Use the log_* macros
+ * instead of calling this directly. Strings are copied (and truncated when
+ * long), everything else is kept as is and formatted later.
+ * @param color Color of the line prefix.
+ * @param level_str Name of the log level.
+ * @param tag Tag of the module logging.
+ * @param line Line of the call.
+ * @param file File of the call.
+ * @param fmt printf format string.
+ */
+void amiss_log_write(char const *const color, char const *const level_str,
+                     char const *const tag, int const line,
+                     char const *const file, char const *const fmt, ...)
+{
+    pthread_once(&log_once, log_start);
+    log_record_st record_sync;
+    log_record_st *record = &record_sync;
+    log_ring_st *const ring =
+        atomic_load(&log_async) == true ? log_ring_get() : NULL;
+    uint32_t tail = 0U;
+    if (ring != NULL)
+    {
+        tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        /* Wait for the formatter to make room rather than lose the line. */
+        struct timespec const idle = {.tv_sec = 0, .tv_nsec = IDLE_NS};
+        while (tail - atomic_load_explicit(&ring->head,
+                                           memory_order_acquire) ==
+               RING_SIZE)
+        {
+            nanosleep(&idle, NULL);
+        }
+        record = &ring->records[tail & (RING_SIZE - 1U)];
+    }
+
+    record->seq = atomic_fetch_add(&log_seq, 1U);
+    record->color = color;
+    record->level_str = level_str;
+    record->tag = tag;
+    record->file = file;
+    record->fmt = fmt;
+    record->line = line;
+    va_list ap;
+    va_start(ap, fmt);
+    record_capture(record, ap);
+    va_end(ap);
+
+    if (ring != NULL)
+    {
+        atomic_store_explicit(&ring->tail, tail + 1U, memory_order_release);
+    }
+    else
+    {
+        record_print(record);
+    }
+}
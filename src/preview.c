@@ -0,0 +1,138 @@
+#include "amiss.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @brief Create a preview file, or truncate an existing one, and map it into
+ * memory. It shows a black image until the first one is shown.
+ * @param preview Set to the mapped file.
+ * @param path Where to create the file.
+ * @param w Width of the file, images shown get scaled to it.
+ * @param h Height of the file.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_preview_open(amiss_preview_st *const preview, char const *const path,
+                       uint32_t const w, uint32_t const h)
+{
+    *preview = (amiss_preview_st){
+        .map = NULL, .map_len = 0U, .px = NULL, .w = w, .h = h, .stage = -1};
+    char header[32U];
+    int const header_len =
+        snprintf(header, sizeof(header), "P6\n%u %u\n255\n", w, h);
+    uint64_t const px_len = (uint64_t)w * h * 3U /* RGB */;
+    if (header_len < 0 || (uint32_t)header_len >= sizeof(header) ||
+        px_len > UINT32_MAX)
+    {
+        log_err("AMISS_PREVIEW", "Preview is too large\n");
+        return -1;
+    }
+    int const fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        log_err("AMISS_PREVIEW", "Failed to open '%s': %s\n", path,
+                strerror(errno));
+        return -1;
+    }
+    size_t const map_len = (size_t)header_len + px_len;
+    if (ftruncate(fd, (off_t)map_len) != 0)
+    {
+        log_err("AMISS_PREVIEW", "Failed to resize '%s': %s\n", path,
+                strerror(errno));
+        close(fd);
+        return -1;
+    }
+    void *const map =
+        mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); /* The mapping keeps the file open. */
+    if (map == MAP_FAILED)
+    {
+        log_err("AMISS_PREVIEW", "Failed to map '%s': %s\n", path,
+                strerror(errno));
+        return -1;
+    }
+    preview->map = map;
+    preview->map_len = map_len;
+    preview->px = &preview->map[header_len];
+    memcpy(preview->map, header, (size_t)header_len);
+    pthread_mutex_init(&preview->lock, NULL);
+    return 0;
+}
+
+/**
+ * @brief Overwrite the preview with an image, unless one of a later stage is
+ * already shown. The image is scaled to the preview by nearest neighbor, which
+ * is all a preview needs. Safe to call from several threads at once.
+ * @param preview Preview to show the image in.
+ * @param img Image to show, of any size and format.
+ * @param stage Stage of refinement the image belongs to, later ones are finer.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_preview_show(amiss_preview_st *const preview,
+                       amiss_img_st const *const img, uint32_t const stage)
+{
+    PROF_SCOPE("amiss_preview_show");
+    if (img->b == NULL || img->w == 0U || img->h == 0U)
+    {
+        log_err("AMISS_PREVIEW", "Image has no pixels to show\n");
+        return -1;
+    }
+    pthread_mutex_lock(&preview->lock);
+    if ((int64_t)stage < preview->stage)
+    {
+        pthread_mutex_unlock(&preview->lock);
+        return 0; /* A finer image finished first. */
+    }
+    uint8_t const depth = amiss_img_depth(img);
+    bool const same_rows =
+        img->fmt == AMISS_IMG_FMT_PPM && img->w == preview->w;
+    for (uint32_t y = 0U; y < preview->h; ++y)
+    {
+        uint32_t const y_img =
+            (uint32_t)(((uint64_t)y * img->h) / preview->h);
+        uint32_t const y_buf = img->orient == AMISS_IMG_ORIENT_BOTTOM_UP
+                                   ? img->h - y_img - 1U
+                                   : y_img;
+        uint8_t const *const row =
+            &img->b[amiss_img_xy2idx(img, depth, 0U, y_buf)];
+        uint8_t *const row_px =
+            &preview->px[(size_t)y * preview->w * 3U /* RGB */];
+        if (same_rows == true)
+        {
+            memcpy(row_px, row, (size_t)preview->w * 3U /* RGB */);
+            continue;
+        }
+        for (uint32_t x = 0U; x < preview->w; ++x)
+        {
+            uint32_t const x_img =
+                (uint32_t)(((uint64_t)x * img->w) / preview->w);
+            uint8_t *const px = &row_px[x * 3U /* RGB */];
+            amiss_img_px_decode(img, &row[x_img * depth], &px[0U], &px[1U],
+                                &px[2U]);
+        }
+    }
+    preview->stage = (int32_t)stage;
+    /* Let the pages reach the file without waiting for them. */
+    int const ret = msync(preview->map, preview->map_len, MS_ASYNC);
+    pthread_mutex_unlock(&preview->lock);
+    if (ret != 0)
+    {
+        log_err("AMISS_PREVIEW", "Failed to sync preview: %s\n",
+                strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void amiss_preview_close(amiss_preview_st *const preview)
+{
+    if (preview->map != NULL)
+    {
+        munmap(preview->map, preview->map_len);
+        pthread_mutex_destroy(&preview->lock);
+    }
+    *preview = (amiss_preview_st){.map = NULL, .map_len = 0U, .px = NULL};
+}
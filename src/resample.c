@@ -0,0 +1,620 @@
+#include "amiss.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Every filter runs vertically first, into one row as wide as the source, then
+ * horizontally from that row into the destination. A band of destination rows
+ * thus needs no more scratch than a row and reads each source row while it is
+ * still in cache from the previous destination row. The vector paths do the
+ * same integer math as the scalar ones so their results are bit-identical.
+ */
+
+/* Lobes of the Lanczos kernel on each side of its center. */
+#define LANCZOS_LOBES 3U
+/* Taps of the widest Lanczos kernel, padded to pairs. */
+#define LANCZOS_TAPS_MAX ((2U * LANCZOS_LOBES * AMISS_RESAMPLE_FACTOR_MAX) + 2U)
+/* Fractional bits of Lanczos weights. */
+#define LANCZOS_SHIFT 14U
+
+/* Source bytes a band of destination rows should span. */
+#define BAND_BYTES (512U * 1024U)
+/* Fewest destination rows in a band, so a band is worth a job. */
+#define BAND_ROWS_MIN 8U
+
+/**
+ * Lanczos weights, the same for every destination pixel since the factor is
+ * whole.
+ */
+typedef struct lanczos_s
+{
+    int16_t w[LANCZOS_TAPS_MAX];
+    /* Weights of neighbor taps packed in pairs, as multiplied by madd. */
+    int32_t pairs[LANCZOS_TAPS_MAX / 2U];
+    uint32_t count; /* Taps, even. */
+    int32_t first;  /* Offset of the first tap from x * factor. */
+} lanczos_st;
+
+/* Rows of the destination filtered at once e.g. by a job. */
+typedef struct band_s
+{
+    amiss_img_st const *dst;
+    amiss_img_st const *src;
+    uint8_t factor;
+    amiss_resample_filter_et filter;
+    lanczos_st const *lanczos;
+    uint32_t y_begin;
+    uint32_t y_end;
+} band_st;
+
+static double_t lanczos(double_t const x)
+{
+    if (x == 0.0)
+    {
+        return 1.0;
+    }
+    double_t const px = M_PI * x;
+    return LANCZOS_LOBES * sin(px) * sin(px / LANCZOS_LOBES) / (px * px);
+}
+
+/**
+ * @brief Compute the Lanczos weights of a factor in fixed point. They sum to
+ * exactly one, the rounding error goes to the largest weight.
+ * @param l Weights to compute.
+ * @param factor Factor the image gets downsampled by.
+ */
+static void lanczos_init(lanczos_st *const l, uint8_t const factor)
+{
+    int32_t const reach = (int32_t)(LANCZOS_LOBES * factor);
+    double_t weights[LANCZOS_TAPS_MAX];
+    double_t total = 0.0;
+    *l = (lanczos_st){.count = 0U, .first = 0};
+    for (int32_t k = -reach; k <= reach; ++k)
+    {
+        /* Distance between the centers of both pixels, in destination units. */
+        double_t const d = ((k + 0.5) - (factor / 2.0)) / factor;
+        if (fabs(d) >= LANCZOS_LOBES)
+        {
+            continue;
+        }
+        if (l->count == 0U)
+        {
+            l->first = k;
+        }
+        weights[l->count] = lanczos(d);
+        total += weights[l->count++];
+    }
+    int32_t sum = 0;
+    uint32_t center = 0U;
+    for (uint32_t tap = 0U; tap < l->count; ++tap)
+    {
+        l->w[tap] =
+            (int16_t)lrint(weights[tap] / total * (1 << LANCZOS_SHIFT));
+        sum += l->w[tap];
+        center = weights[tap] > weights[center] ? tap : center;
+    }
+    l->w[center] = (int16_t)(l->w[center] + ((1 << LANCZOS_SHIFT) - sum));
+    if (l->count % 2U != 0U)
+    {
+        l->w[l->count++] = 0;
+    }
+    for (uint32_t tap = 0U; tap < l->count; tap += 2U)
+    {
+        l->pairs[tap / 2U] = (int32_t)(((uint32_t)(uint16_t)l->w[tap + 1U]
+                                        << 16U) |
+                                       (uint16_t)l->w[tap]);
+    }
+}
+
+static uint8_t lanczos_round(int32_t const acc)
+{
+    int32_t const v = (acc + (1 << (LANCZOS_SHIFT - 1U))) >> LANCZOS_SHIFT;
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/**
+ * @brief Keep colors of a premultiplied pixel within its alpha, ringing of the
+ * Lanczos kernel can push them past it.
+ */
+static uint32_t premul_clamp(uint32_t const px)
+{
+    uint32_t const a = px >> 24U;
+    uint32_t out = px & 0xFF000000U;
+    for (uint32_t shift = 0U; shift < 24U; shift += 8U)
+    {
+        uint32_t const channel = (px >> shift) & 0xFFU;
+        out |= (channel < a ? channel : a) << shift;
+    }
+    return out;
+}
+
+/**
+ * @brief Copy every factor-th pixel of a row.
+ * @param dst Where to copy the pixels to, packed.
+ * @param src Row to copy from.
+ * @param w Number of pixels to copy.
+ * @param depth Bytes per pixel.
+ * @param factor Distance between copied pixels.
+ */
+static void px_gather(uint8_t *const dst, uint8_t const *const src,
+                      uint32_t const w, uint8_t const depth,
+                      uint8_t const factor)
+{
+    uint32_t const step = (uint32_t)factor * depth;
+    /* Sizes are spelled out so every copy is a plain move. */
+    switch (depth)
+    {
+    case 4U:
+        for (uint32_t x = 0U; x < w; ++x)
+        {
+            memcpy(&dst[x * 4U], &src[x * step], 4U);
+        }
+        break;
+    case 3U:
+        for (uint32_t x = 0U; x < w; ++x)
+        {
+            memcpy(&dst[x * 3U], &src[x * step], 3U);
+        }
+        break;
+    default:
+        for (uint32_t x = 0U; x < w; ++x)
+        {
+            dst[x] = src[x * step];
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Sum the same bytes of several rows.
+ * @param sum Set to the sums, one per byte of a row.
+ * @param rows Rows to sum.
+ * @param count Number of rows.
+ * @param len Length of a row in bytes.
+ */
+static void box_v(uint16_t *const sum, uint8_t const *const *const rows,
+                  uint8_t const count, uint32_t const len)
+{
+    uint32_t idx = 0U;
+#if defined(__AVX2__)
+    for (; idx + 16U <= len; idx += 16U)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        for (uint8_t row_idx = 0U; row_idx < count; ++row_idx)
+        {
+            acc = _mm256_add_epi16(
+                acc, _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                         (__m128i const *)&rows[row_idx][idx])));
+        }
+        _mm256_storeu_si256((__m256i *)&sum[idx], acc);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; idx + 8U <= len; idx += 8U)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        for (uint8_t row_idx = 0U; row_idx < count; ++row_idx)
+        {
+            acc = _mm_add_epi16(
+                acc, _mm_unpacklo_epi8(_mm_loadl_epi64((
+                                           __m128i const *)&rows[row_idx][idx]),
+                                       zero));
+        }
+        _mm_storeu_si128((__m128i *)&sum[idx], acc);
+    }
+#endif
+    for (; idx < len; ++idx)
+    {
+        uint32_t acc = 0U;
+        for (uint8_t row_idx = 0U; row_idx < count; ++row_idx)
+        {
+            acc += rows[row_idx][idx];
+        }
+        sum[idx] = (uint16_t)acc;
+    }
+}
+
+/**
+ * @brief Turn column sums into means of blocks. Every byte adds the sums of the
+ * same channel of factor neighbor pixels, only the first pixel of each block
+ * is kept.
+ * @param dst Destination row.
+ * @param sum Column sums from box_v, followed by factor pixels of zeros so
+ * every byte can add its neighbors.
+ * @param mean Scratch as long as a source row.
+ * @param w Width of the destination.
+ * @param depth Bytes per pixel.
+ * @param factor Factor the row gets downsampled by.
+ */
+static void box_h(uint8_t *const dst, uint16_t const *const sum,
+                  uint8_t *const mean, uint32_t const w, uint8_t const depth,
+                  uint8_t const factor)
+{
+    uint32_t const len = w * factor * depth;
+    uint32_t const area = (uint32_t)factor * factor;
+    /**
+     * Rounded division by the area as a multiply by its reciprocal, exact for
+     * sums of up to 16 bytes.
+     */
+    uint32_t const mul = (65536U + area - 1U) / area;
+    uint32_t const bias = area / 2U;
+    uint32_t idx = 0U;
+#if defined(__AVX2__)
+    __m256i const mul16 = _mm256_set1_epi16((int16_t)mul);
+    __m256i const bias16 = _mm256_set1_epi16((int16_t)bias);
+    for (; idx + 16U <= len; idx += 16U)
+    {
+        __m256i acc = bias16;
+        for (uint8_t px_idx = 0U; px_idx < factor; ++px_idx)
+        {
+            acc = _mm256_add_epi16(
+                acc, _mm256_loadu_si256(
+                         (__m256i const *)&sum[idx + (px_idx * depth)]));
+        }
+        acc = _mm256_mulhi_epu16(acc, mul16);
+        __m256i const px = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(acc, acc), 0x08);
+        _mm_storeu_si128((__m128i *)&mean[idx], _mm256_castsi256_si128(px));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i const mul8 = _mm_set1_epi16((int16_t)mul);
+    __m128i const bias8 = _mm_set1_epi16((int16_t)bias);
+    for (; idx + 8U <= len; idx += 8U)
+    {
+        __m128i acc = bias8;
+        for (uint8_t px_idx = 0U; px_idx < factor; ++px_idx)
+        {
+            acc = _mm_add_epi16(
+                acc,
+                _mm_loadu_si128((__m128i const *)&sum[idx + (px_idx * depth)]));
+        }
+        acc = _mm_mulhi_epu16(acc, mul8);
+        _mm_storel_epi64((__m128i *)&mean[idx], _mm_packus_epi16(acc, acc));
+    }
+#endif
+    for (; idx < len; ++idx)
+    {
+        uint32_t acc = bias;
+        for (uint8_t px_idx = 0U; px_idx < factor; ++px_idx)
+        {
+            acc += sum[idx + (px_idx * depth)];
+        }
+        mean[idx] = (uint8_t)((acc * mul) >> 16U);
+    }
+    px_gather(dst, mean, w, depth, factor);
+}
+
+/**
+ * @brief Filter the same bytes of several rows with the Lanczos weights.
+ * @param out Set to the filtered bytes.
+ * @param rows Rows to filter, one per tap.
+ * @param l Weights.
+ * @param len Length of a row in bytes.
+ */
+static void lanczos_v(uint8_t *const out, uint8_t const *const *const rows,
+                      lanczos_st const *const l, uint32_t const len)
+{
+    uint32_t idx = 0U;
+#if defined(__AVX2__)
+    for (; idx + 16U <= len; idx += 16U)
+    {
+        __m256i lo = _mm256_set1_epi32(1 << (LANCZOS_SHIFT - 1U));
+        __m256i hi = lo;
+        for (uint32_t tap = 0U; tap < l->count; tap += 2U)
+        {
+            __m256i const w = _mm256_set1_epi32(l->pairs[tap / 2U]);
+            __m256i const a = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128((__m128i const *)&rows[tap][idx]));
+            __m256i const b = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128((__m128i const *)&rows[tap + 1U][idx]));
+            lo = _mm256_add_epi32(
+                lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            hi = _mm256_add_epi32(
+                hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        /* Lanes hold bytes 0-3 and 8-11 in lo, 4-7 and 12-15 in hi. */
+        __m256i const px16 =
+            _mm256_packs_epi32(_mm256_srai_epi32(lo, LANCZOS_SHIFT),
+                               _mm256_srai_epi32(hi, LANCZOS_SHIFT));
+        __m256i const px = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(px16, px16), 0x08);
+        _mm_storeu_si128((__m128i *)&out[idx], _mm256_castsi256_si128(px));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; idx + 8U <= len; idx += 8U)
+    {
+        __m128i const zero = _mm_setzero_si128();
+        __m128i lo = _mm_set1_epi32(1 << (LANCZOS_SHIFT - 1U));
+        __m128i hi = lo;
+        for (uint32_t tap = 0U; tap < l->count; tap += 2U)
+        {
+            __m128i const w = _mm_set1_epi32(l->pairs[tap / 2U]);
+            __m128i const a = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((__m128i const *)&rows[tap][idx]), zero);
+            __m128i const b = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((__m128i const *)&rows[tap + 1U][idx]), zero);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        __m128i const px16 =
+            _mm_packs_epi32(_mm_srai_epi32(lo, LANCZOS_SHIFT),
+                            _mm_srai_epi32(hi, LANCZOS_SHIFT));
+        _mm_storel_epi64((__m128i *)&out[idx], _mm_packus_epi16(px16, px16));
+    }
+#endif
+    for (; idx < len; ++idx)
+    {
+        int32_t acc = 0;
+        for (uint32_t tap = 0U; tap < l->count; ++tap)
+        {
+            acc += l->w[tap] * rows[tap][idx];
+        }
+        out[idx] = lanczos_round(acc);
+    }
+}
+
+/**
+ * @brief Filter a row horizontally with the Lanczos weights, pixels past the
+ * edges repeat the edge.
+ * @param dst Destination row.
+ * @param row Source row, from lanczos_v.
+ * @param src Source image, for its width and format.
+ * @param w Width of the destination.
+ * @param factor Factor the row gets downsampled by.
+ * @param l Weights.
+ */
+static void lanczos_h(uint8_t *const dst, uint8_t const *const row,
+                      amiss_img_st const *const src, uint32_t const w,
+                      uint8_t const factor, lanczos_st const *const l)
+{
+    uint8_t const depth = amiss_img_depth(src);
+    /* Vector loads of the last tap read one pixel past it. */
+    uint8_t edge[(LANCZOS_TAPS_MAX + 1U) * 4U /* ARGB */];
+    for (uint32_t x = 0U; x < w; ++x)
+    {
+        int32_t const first = (int32_t)(x * factor) + l->first;
+        uint8_t const *taps = edge;
+        if (first >= 0 && first + (int32_t)l->count < (int32_t)src->w)
+        {
+            taps = &row[(uint32_t)first * depth];
+        }
+        else
+        {
+            for (uint32_t tap = 0U; tap < l->count; ++tap)
+            {
+                int32_t const x_src = first + (int32_t)tap;
+                uint32_t const x_edge =
+                    x_src < 0 ? 0U
+                              : ((uint32_t)x_src >= src->w ? src->w - 1U
+                                                           : (uint32_t)x_src);
+                memcpy(&edge[tap * depth], &row[x_edge * depth], depth);
+            }
+        }
+        uint8_t *const px = &dst[x * depth];
+#if defined(__SSE2__)
+        if (depth >= 3U)
+        {
+            /* Channels of neighbor taps get interleaved to go in pairs. */
+            __m128i const zero = _mm_setzero_si128();
+            __m128i acc = _mm_set1_epi32(1 << (LANCZOS_SHIFT - 1U));
+            for (uint32_t tap = 0U; tap < l->count; tap += 2U)
+            {
+                __m128i const ab = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((__m128i const *)&taps[tap * depth]),
+                    zero);
+                __m128i const b = depth == 4U ? _mm_srli_si128(ab, 8)
+                                              : _mm_srli_si128(ab, 6);
+                acc = _mm_add_epi32(
+                    acc, _mm_madd_epi16(_mm_unpacklo_epi16(ab, b),
+                                        _mm_set1_epi32(l->pairs[tap / 2U])));
+            }
+            __m128i const px16 =
+                _mm_packs_epi32(_mm_srai_epi32(acc, LANCZOS_SHIFT), zero);
+            uint32_t out =
+                (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(px16, zero));
+            if (src->fmt == AMISS_IMG_FMT_ARGB32)
+            {
+                out = premul_clamp(out);
+            }
+            /* Channels come out in order, RGB leaves the last one out. */
+            memcpy(px, &out, depth);
+            continue;
+        }
+#endif
+        for (uint8_t channel = 0U; channel < depth; ++channel)
+        {
+            int32_t acc = 0;
+            for (uint32_t tap = 0U; tap < l->count; ++tap)
+            {
+                acc += l->w[tap] * taps[(tap * depth) + channel];
+            }
+            px[channel] = lanczos_round(acc);
+        }
+        if (src->fmt == AMISS_IMG_FMT_ARGB32)
+        {
+            uint32_t argb;
+            memcpy(&argb, px, sizeof(argb));
+            argb = premul_clamp(argb);
+            memcpy(px, &argb, sizeof(argb));
+        }
+    }
+}
+
+/**
+ * @brief Get how much scratch filtering a band takes: the column sums of box
+ * with their padding and a row of means, which also fits the row lanczos_v
+ * filters into.
+ */
+static size_t band_scratch_len(amiss_img_st const *const src,
+                               uint8_t const factor)
+{
+    size_t const len = (size_t)src->w * amiss_img_depth(src);
+    size_t const pad = (size_t)factor * amiss_img_depth(src);
+    return ((len + pad) * sizeof(uint16_t)) + len;
+}
+
+/**
+ * @brief Filter a band of destination rows.
+ * @param band Band to filter.
+ * @param scratch At least band_scratch_len bytes.
+ */
+static void band_run(band_st const *const band, uint8_t *const scratch)
+{
+    amiss_img_st const *const dst = band->dst;
+    amiss_img_st const *const src = band->src;
+    uint8_t const depth = amiss_img_depth(src);
+    uint8_t const factor = band->factor;
+    uint32_t const len = src->w * depth;
+    uint32_t const stride_dst = amiss_img_stride(dst);
+    uint32_t const stride_src = amiss_img_stride(src);
+    uint16_t *const sum = (uint16_t *)(void *)scratch;
+    uint8_t *const mid = &scratch[(len + (factor * depth)) * sizeof(sum[0U])];
+    /* Zero the padding past the sums, box_v never writes it. */
+    memset(&sum[len], 0, factor * depth * sizeof(sum[0U]));
+    uint8_t const *rows[LANCZOS_TAPS_MAX];
+    for (uint32_t y = band->y_begin; y < band->y_end; ++y)
+    {
+        uint8_t *const row_dst = &dst->b[(size_t)stride_dst * y];
+        if (band->filter == AMISS_RESAMPLE_BOX)
+        {
+            for (uint8_t row_idx = 0U; row_idx < factor; ++row_idx)
+            {
+                rows[row_idx] =
+                    &src->b[(size_t)stride_src * ((y * factor) + row_idx)];
+            }
+            box_v(sum, rows, factor, len);
+            box_h(row_dst, sum, mid, dst->w, depth, factor);
+            continue;
+        }
+        lanczos_st const *const l = band->lanczos;
+        int32_t const first = (int32_t)(y * factor) + l->first;
+        for (uint32_t tap = 0U; tap < l->count; ++tap)
+        {
+            int32_t const y_src = first + (int32_t)tap;
+            uint32_t const y_edge =
+                y_src < 0 ? 0U
+                          : ((uint32_t)y_src >= src->h ? src->h - 1U
+                                                       : (uint32_t)y_src);
+            rows[tap] = &src->b[(size_t)stride_src * y_edge];
+        }
+        lanczos_v(mid, rows, l, len);
+        lanczos_h(row_dst, mid, src, dst->w, factor, l);
+    }
+}
+
+static int band_job(void *const arg, amiss_arena_st *const arena)
+{
+    band_st const *const band = arg;
+    uint8_t *const scratch =
+        amiss_arena_alloc(arena, band_scratch_len(band->src, band->factor));
+    if (scratch == NULL)
+    {
+        log_err("AMISS_RESAMPLE", "Failed to allocate band scratch\n");
+        return -1;
+    }
+    band_run(band, scratch);
+    return 0;
+}
+
+/**
+ * @brief Downsample an image by a whole factor e.g. to antialias a canvas drawn
+ * larger than the output. Rows are filtered in bands that each stay in cache,
+ * spread over a pool when one is given.
+ * @param dst Destination, as large as the source divided by the factor and of
+ * the same format and orientation.
+ * @param src Source image. Premultiplied ARGB32 stays premultiplied.
+ * @param factor Factor to divide the size by, see AMISS_RESAMPLE_FACTOR_MIN and
+ * AMISS_RESAMPLE_FACTOR_MAX.
+ * @param filter Filter to downsample with.
+ * @param pool Pool filtering the bands, NULL to filter them on this thread.
+ * Must not be called from a job of that same pool.
+ * @return 0 on success, -1 on failure.
+ */
+int amiss_img_downsample(amiss_img_st const *const dst,
+                         amiss_img_st const *const src, uint8_t const factor,
+                         amiss_resample_filter_et const filter,
+                         amiss_job_pool_st *const pool)
+{
+    PROF_SCOPE("amiss_img_downsample");
+    if (factor < AMISS_RESAMPLE_FACTOR_MIN ||
+        factor > AMISS_RESAMPLE_FACTOR_MAX)
+    {
+        log_err("AMISS_RESAMPLE", "Factor %u is out of range\n", factor);
+        return -1;
+    }
+    if (dst->fmt != src->fmt || dst->orient != src->orient ||
+        (uint64_t)dst->w * factor != src->w ||
+        (uint64_t)dst->h * factor != src->h)
+    {
+        log_err("AMISS_RESAMPLE", "Images don't match the factor\n");
+        return -1;
+    }
+    lanczos_st lanczos;
+    if (filter == AMISS_RESAMPLE_LANCZOS)
+    {
+        lanczos_init(&lanczos, factor);
+    }
+    size_t const scratch_len = band_scratch_len(src, factor);
+    size_t const band_src = (size_t)amiss_img_stride(src) * factor;
+    uint32_t const band_rows =
+        band_src * BAND_ROWS_MIN >= BAND_BYTES
+            ? BAND_ROWS_MIN
+            : (uint32_t)(BAND_BYTES / band_src); /* Safe cast due to check. */
+    uint32_t const band_count = (dst->h + band_rows - 1U) / band_rows;
+
+    int ret = 0;
+    if (pool == NULL || band_count <= 1U)
+    {
+        uint8_t *const scratch = malloc(scratch_len);
+        if (scratch == NULL)
+        {
+            log_err("AMISS_RESAMPLE", "Failed to allocate scratch\n");
+            return -1;
+        }
+        band_st const band = {dst, src, factor, filter, &lanczos, 0U, dst->h};
+        band_run(&band, scratch);
+        free(scratch);
+    }
+    else
+    {
+        band_st *const bands = malloc(band_count * sizeof(bands[0U]));
+        amiss_job_st *const jobs = malloc(band_count * sizeof(jobs[0U]));
+        if (bands == NULL || jobs == NULL)
+        {
+            log_err("AMISS_RESAMPLE", "Failed to allocate bands\n");
+            free(bands);
+            free(jobs);
+            return -1;
+        }
+        for (uint32_t band_idx = 0U; band_idx < band_count; ++band_idx)
+        {
+            uint32_t const y_begin = band_idx * band_rows;
+            bands[band_idx] = (band_st){
+                dst,
+                src,
+                factor,
+                filter,
+                &lanczos,
+                y_begin,
+                dst->h - y_begin < band_rows ? dst->h : y_begin + band_rows,
+            };
+            jobs[band_idx] = (amiss_job_st){.fn = band_job,
+                                            .arg = &bands[band_idx],
+                                            .mem = scratch_len,
+                                            .ret = 0};
+        }
+        ret = amiss_job_pool_run(pool, jobs, band_count);
+        free(bands);
+        free(jobs);
+    }
+    PROF_COUNT(AMISS_PROF_COUNTER_PIXELS, (uint64_t)dst->w * dst->h);
+    return ret;
+}
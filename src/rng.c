@@ -0,0 +1,390 @@
+#include "amiss.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* How many values the bulk fills generate at once before converting them. */
+#define CHUNK_SIZE 256U
+/* Bits of precision of the probability of Bernoulli fills. */
+#define BITS_P_PRECISION 16U
+
+static uint64_t rotl(uint64_t const x, uint32_t const k)
+{
+    return (x << k) | (x >> (64U - k));
+}
+
+/* Finalizer of splitmix64, every output bit depends on all input bits. */
+static uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9U;
+    z = (z ^ (z >> 27U)) * 0x94D049BB133111EBU;
+    return z ^ (z >> 31U);
+}
+
+/**
+ * @brief Next value of a splitmix64 generator, used to expand a seed into the
+ * xoshiro256** state.
+ * @param x State of the generator.
+ * @return Next value.
+ */
+static uint64_t splitmix64(uint64_t *const x)
+{
+    return mix64(*x += 0x9E3779B97F4A7C15U);
+}
+
+/**
+ * @brief Seed a generator. Equal seeds always give equal sequences.
+ * @param rng Generator to seed.
+ * @param seed Any value, 0 included.
+ */
+void amiss_rng_seed(amiss_rng_st *const rng, uint64_t const seed)
+{
+    uint64_t x = seed;
+    for (uint32_t s_idx = 0U; s_idx < 4U; ++s_idx)
+    {
+        rng->s[s_idx] = splitmix64(&x);
+    }
+}
+
+/**
+ * @brief Seed the generator of one of many independent streams e.g. one per
+ * worker. Streams are 2^192 values apart so they never overlap.
+ * @param rng Generator to seed.
+ * @param seed Seed shared by all streams.
+ * @param stream Index of the stream.
+ */
+void amiss_rng_stream(amiss_rng_st *const rng, uint64_t const seed,
+                      uint32_t const stream)
+{
+    amiss_rng_seed(rng, seed);
+    for (uint32_t stream_idx = 0U; stream_idx < stream; ++stream_idx)
+    {
+        amiss_rng_long_jump(rng);
+    }
+}
+
+uint64_t amiss_rng_u64(amiss_rng_st *const rng)
+{
+    uint64_t *const s = rng->s;
+    uint64_t const result = rotl(s[1U] * 5U, 7U) * 9U;
+    uint64_t const t = s[1U] << 17U;
+    s[2U] ^= s[0U];
+    s[3U] ^= s[1U];
+    s[1U] ^= s[2U];
+    s[0U] ^= s[3U];
+    s[2U] ^= t;
+    s[3U] = rotl(s[3U], 45U);
+    return result;
+}
+
+uint32_t amiss_rng_u32(amiss_rng_st *const rng)
+{
+    return (uint32_t)(amiss_rng_u64(rng) >> 32U);
+}
+
+/**
+ * @brief Get a uniformly distributed integer below a bound, without the bias
+ * of taking a modulo.
+ * @param rng Generator to use.
+ * @param bound Exclusive upper bound.
+ * @return Value in [0, bound), 0 if bound is 0.
+ */
+uint32_t amiss_rng_below(amiss_rng_st *const rng, uint32_t const bound)
+{
+    uint64_t m = (uint64_t)amiss_rng_u32(rng) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound)
+    {
+        uint32_t const threshold = (uint32_t)(-bound) % bound;
+        while (low < threshold)
+        {
+            m = (uint64_t)amiss_rng_u32(rng) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32U);
+}
+
+/**
+ * @brief Get a uniformly distributed double.
+ * @param rng Generator to use.
+ * @return Value in [0, 1) with 53 bits of precision.
+ */
+double amiss_rng_f64(amiss_rng_st *const rng)
+{
+    return (double)(amiss_rng_u64(rng) >> 11U) * 0x1.0p-53;
+}
+
+/**
+ * @brief Get a value of a counter-based generator, a splitmix64 sequence
+ * picked by the key and read at the counter. There is no state, any value can
+ * be drawn on its own and in any order, so work split between threads draws
+ * the same values as when done on one.
+ * @param key Picks the sequence e.g. a seed mixed with an iteration.
+ * @param counter Position in the sequence e.g. the index of an element.
+ * @return The value.
+ */
+uint64_t amiss_rng_at(uint64_t const key, uint64_t const counter)
+{
+    return mix64(mix64(key) + ((counter + 1U) * 0x9E3779B97F4A7C15U));
+}
+
+/**
+ * @brief Get a uniformly distributed double from a counter-based generator,
+ * see amiss_rng_at.
+ * @param key Picks the sequence.
+ * @param counter Position in the sequence.
+ * @return Value in [0, 1) with 53 bits of precision.
+ */
+double amiss_rng_at_f64(uint64_t const key, uint64_t const counter)
+{
+    return (double)(amiss_rng_at(key, counter) >> 11U) * 0x1.0p-53;
+}
+
+static void rng_jump_by(amiss_rng_st *const rng, uint64_t const poly[4U])
+{
+    uint64_t s[4U] = {0U, 0U, 0U, 0U};
+    for (uint32_t poly_idx = 0U; poly_idx < 4U; ++poly_idx)
+    {
+        for (uint32_t bit = 0U; bit < 64U; ++bit)
+        {
+            if ((poly[poly_idx] & ((uint64_t)1U << bit)) != 0U)
+            {
+                for (uint32_t s_idx = 0U; s_idx < 4U; ++s_idx)
+                {
+                    s[s_idx] ^= rng->s[s_idx];
+                }
+            }
+            amiss_rng_u64(rng);
+        }
+    }
+    memcpy(rng->s, s, sizeof(s));
+}
+
+/**
+ * @brief Advance a generator by 2^128 values.
+ * @param rng Generator to advance.
+ */
+void amiss_rng_jump(amiss_rng_st *const rng)
+{
+    static uint64_t const poly[4U] = {
+        0x180EC6D33CFD0ABAU,
+        0xD5A61266F0C9392CU,
+        0xA9582618E03FC9AAU,
+        0x39ABDC4529B1661CU,
+    };
+    rng_jump_by(rng, poly);
+}
+
+/**
+ * @brief Advance a generator by 2^192 values.
+ * @param rng Generator to advance.
+ */
+void amiss_rng_long_jump(amiss_rng_st *const rng)
+{
+    static uint64_t const poly[4U] = {
+        0x76E15D3EFEFDCBBFU,
+        0xC5004E441C522FB3U,
+        0x77710069854EE241U,
+        0x39109BB02ACBE635U,
+    };
+    rng_jump_by(rng, poly);
+}
+
+/**
+ * @brief Create four lanes from a generator. Lane i is the generator jumped i
+ * times, the generator itself is jumped 4 times so it can keep being used
+ * without overlapping the lanes.
+ * @param rng4 Lanes to create.
+ * @param rng Generator to start from.
+ */
+void amiss_rng4_init(amiss_rng4_st *const rng4, amiss_rng_st *const rng)
+{
+    for (uint32_t lane = 0U; lane < 4U; ++lane)
+    {
+        for (uint32_t s_idx = 0U; s_idx < 4U; ++s_idx)
+        {
+            rng4->s[s_idx][lane] = rng->s[s_idx];
+        }
+        amiss_rng_jump(rng);
+    }
+}
+
+/**
+ * @brief Advance all lanes. Every step writes one value per lane, lane 0
+ * first.
+ * @param rng4 Lanes to advance.
+ * @param out Where 4 values per step are written.
+ * @param steps How many steps to take.
+ */
+static void rng4_steps(amiss_rng4_st *const rng4, uint64_t *const out,
+                       size_t const steps)
+{
+#if defined(__AVX2__)
+    __m256i s0 = _mm256_loadu_si256((__m256i const *)rng4->s[0U]);
+    __m256i s1 = _mm256_loadu_si256((__m256i const *)rng4->s[1U]);
+    __m256i s2 = _mm256_loadu_si256((__m256i const *)rng4->s[2U]);
+    __m256i s3 = _mm256_loadu_si256((__m256i const *)rng4->s[3U]);
+    for (size_t step = 0U; step < steps; ++step)
+    {
+        /* No 64 bit multiply in AVX2, x*5 and x*9 are done with shifts. */
+        __m256i const s1x5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+        __m256i const rot = _mm256_or_si256(_mm256_slli_epi64(s1x5, 7),
+                                            _mm256_srli_epi64(s1x5, 57));
+        __m256i const result =
+            _mm256_add_epi64(_mm256_slli_epi64(rot, 3), rot);
+        _mm256_storeu_si256((__m256i *)&out[step * 4U], result);
+
+        __m256i const t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45),
+                             _mm256_srli_epi64(s3, 19));
+    }
+    _mm256_storeu_si256((__m256i *)rng4->s[0U], s0);
+    _mm256_storeu_si256((__m256i *)rng4->s[1U], s1);
+    _mm256_storeu_si256((__m256i *)rng4->s[2U], s2);
+    _mm256_storeu_si256((__m256i *)rng4->s[3U], s3);
+#else
+    uint64_t(*const s)[4U] = rng4->s;
+    for (size_t step = 0U; step < steps; ++step)
+    {
+        for (uint32_t lane = 0U; lane < 4U; ++lane)
+        {
+            out[(step * 4U) + lane] = rotl(s[1U][lane] * 5U, 7U) * 9U;
+            uint64_t const t = s[1U][lane] << 17U;
+            s[2U][lane] ^= s[0U][lane];
+            s[3U][lane] ^= s[1U][lane];
+            s[1U][lane] ^= s[2U][lane];
+            s[0U][lane] ^= s[3U][lane];
+            s[2U][lane] ^= t;
+            s[3U][lane] = rotl(s[3U][lane], 45U);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Fill a buffer with uniformly distributed integers. Values are made 4
+ * at a time, when count is not a multiple of 4 the rest of the last step is
+ * dropped.
+ * @param rng4 Lanes to use.
+ * @param out Buffer to fill.
+ * @param count Number of values to write.
+ */
+void amiss_rng4_fill_u64(amiss_rng4_st *const rng4, uint64_t *const out,
+                         size_t const count)
+{
+    rng4_steps(rng4, out, count / 4U);
+    if (count % 4U != 0U)
+    {
+        uint64_t tail[4U];
+        rng4_steps(rng4, tail, 1U);
+        memcpy(&out[count - (count % 4U)], tail,
+               (count % 4U) * sizeof(tail[0U]));
+    }
+}
+
+/**
+ * @brief Fill a buffer with uniformly distributed integers. Every 64 bit value
+ * gives two, its low half first.
+ * @param rng4 Lanes to use.
+ * @param out Buffer to fill.
+ * @param count Number of values to write.
+ */
+void amiss_rng4_fill_u32(amiss_rng4_st *const rng4, uint32_t *const out,
+                         size_t const count)
+{
+    uint64_t chunk[CHUNK_SIZE];
+    for (size_t out_idx = 0U; out_idx < count; out_idx += CHUNK_SIZE * 2U)
+    {
+        size_t const out_len = count - out_idx < CHUNK_SIZE * 2U
+                                   ? count - out_idx
+                                   : CHUNK_SIZE * 2U;
+        amiss_rng4_fill_u64(rng4, chunk, (out_len + 1U) / 2U);
+        for (size_t chunk_idx = 0U; chunk_idx < out_len; ++chunk_idx)
+        {
+            out[out_idx + chunk_idx] =
+                (uint32_t)(chunk[chunk_idx / 2U] >> ((chunk_idx % 2U) * 32U));
+        }
+    }
+}
+
+/**
+ * @brief Fill a buffer with uniformly distributed doubles in [0, 1).
+ * @param rng4 Lanes to use.
+ * @param out Buffer to fill.
+ * @param count Number of values to write.
+ */
+void amiss_rng4_fill_f64(amiss_rng4_st *const rng4, double *const out,
+                         size_t const count)
+{
+    uint64_t chunk[CHUNK_SIZE];
+    for (size_t out_idx = 0U; out_idx < count; out_idx += CHUNK_SIZE)
+    {
+        size_t const out_len =
+            count - out_idx < CHUNK_SIZE ? count - out_idx : CHUNK_SIZE;
+        amiss_rng4_fill_u64(rng4, chunk, out_len);
+        for (size_t chunk_idx = 0U; chunk_idx < out_len; ++chunk_idx)
+        {
+            out[out_idx + chunk_idx] =
+                (double)(chunk[chunk_idx] >> 11U) * 0x1.0p-53;
+        }
+    }
+}
+
+/**
+ * @brief Fill a buffer with bits that are each set with a given probability.
+ * Bits are combined from several random words following the binary expansion
+ * of the probability, p = 0.5 costs one word per 64 bits and every further bit
+ * of precision one more.
+ * @param rng4 Lanes to use.
+ * @param out Buffer to fill.
+ * @param count Number of 64 bit words to write.
+ * @param p Probability of a bit being set, rounded to 16 bits of precision.
+ */
+void amiss_rng4_fill_bits(amiss_rng4_st *const rng4, uint64_t *const out,
+                          size_t const count, double const p)
+{
+    double const p_clamped = p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p);
+    uint32_t const p_fixed =
+        (uint32_t)lround(p_clamped * (double)(1U << BITS_P_PRECISION));
+    if (p_fixed == 0U || p_fixed >= (1U << BITS_P_PRECISION))
+    {
+        memset(out, p_fixed == 0U ? 0x00 : 0xFF, count * sizeof(out[0U]));
+        return;
+    }
+
+    /* Only bits down to the lowest set one of the probability matter. */
+    uint32_t bit_low = 0U;
+    while ((p_fixed & (1U << bit_low)) == 0U)
+    {
+        bit_low++;
+    }
+    uint32_t const word_count = BITS_P_PRECISION - bit_low;
+
+    uint64_t words[BITS_P_PRECISION * 4U];
+    for (size_t out_idx = 0U; out_idx < count; out_idx += 4U)
+    {
+        rng4_steps(rng4, words, word_count);
+        for (uint32_t lane = 0U; lane < 4U && out_idx + lane < count; ++lane)
+        {
+            /* The lowest set bit of p starts the expansion off. */
+            uint64_t bits = words[lane];
+            for (uint32_t word_idx = 1U; word_idx < word_count; ++word_idx)
+            {
+                uint64_t const word = words[(word_idx * 4U) + lane];
+                bits = (p_fixed & (1U << (bit_low + word_idx))) != 0U
+                           ? word | bits
+                           : word & bits;
+            }
+            out[out_idx + lane] = bits;
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#include "amiss.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* How many output hashes can be recorded in one run. */
+#define OUTPUT_COUNT_MAX 64U
+
+typedef struct stage_output_s
+{
+    char path[256U];
+    uint64_t hash;
+} stage_output_st;
+
+static char const *const stage_names[AMISS_STAGE_COUNT] = {
+    [AMISS_STAGE_EXPAND] = "expand",
+    [AMISS_STAGE_INTERPRET] = "interpret",
+    [AMISS_STAGE_RASTERIZE] = "rasterize",
+    [AMISS_STAGE_SAVE] = "save",
+};
+
+/* -1 until the environment is checked, then 0 or 1. */
+static atomic_int stage_on = -1;
+static atomic_uint_fast64_t stage_ns[AMISS_STAGE_COUNT];
+static stage_output_st stage_outputs[OUTPUT_COUNT_MAX];
+static atomic_uint stage_output_count;
+
+/**
+ * @brief Write all collected stage timings and output hashes to the file named
+ * by the environment variable. Registered with atexit.
+ */
+static void stage_write(void)
+{
+    char const *const path = getenv(AMISS_STAGE_ENV);
+    FILE *const f = fopen(path, "w");
+    if (f == NULL)
+    {
+        log_err("AMISS_STAGE", "Failed to open stage file\n");
+        return;
+    }
+    for (uint32_t stage = 0U; stage < AMISS_STAGE_COUNT; ++stage)
+    {
+        fprintf(f, "stage\t%s\t%.9f\n", stage_names[stage],
+                (double)atomic_load(&stage_ns[stage]) * 1e-9);
+    }
+    uint32_t const output_count = atomic_load(&stage_output_count);
+    for (uint32_t output_idx = 0U;
+         output_idx < output_count && output_idx < OUTPUT_COUNT_MAX;
+         ++output_idx)
+    {
+        fprintf(f, "output\t%s\t%016llx\n", stage_outputs[output_idx].path,
+                (unsigned long long)stage_outputs[output_idx].hash);
+    }
+    fclose(f);
+}
+
+/**
+ * @brief Check if stage timings are collected. The first call decides it based
+ * on the environment.
+ * @return 1 if enabled, 0 if not.
+ */
+int amiss_stage_enabled(void)
+{
+    int on = atomic_load(&stage_on);
+    if (on < 0)
+    {
+        int const on_env = getenv(AMISS_STAGE_ENV) != NULL ? 1 : 0;
+        int expected = -1;
+        if (atomic_compare_exchange_strong(&stage_on, &expected, on_env) &&
+            on_env == 1)
+        {
+            atexit(stage_write);
+        }
+        on = atomic_load(&stage_on);
+    }
+    return on;
+}
+
+/**
+ * @brief Get a monotonic timestamp, used as the start of a stage.
+ * @return Time in nanoseconds.
+ */
+uint64_t amiss_stage_now(void)
+{
+    struct timespec ts;
+#if defined(_WIN32)
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Add the time since a stage began to the total of that stage. Safe to
+ * call from multiple threads.
+ * @param stage Stage that ended.
+ * @param t_begin Timestamp from amiss_stage_now taken when the stage began.
+ */
+void amiss_stage_end(amiss_stage_et const stage, uint64_t const t_begin)
+{
+    if (amiss_stage_enabled() == 0)
+    {
+        return;
+    }
+    atomic_fetch_add(&stage_ns[stage], amiss_stage_now() - t_begin);
+}
+
+/**
+ * @brief Record the hash of the pixels of an output image.
+ * @param path Where the image was saved.
+ * @param hash Hash of the pixels computed with amiss_hash.
+ */
+void amiss_stage_output(char const *const path, uint64_t const hash)
+{
+    if (amiss_stage_enabled() == 0)
+    {
+        return;
+    }
+    uint32_t const output_idx = atomic_fetch_add(&stage_output_count, 1U);
+    if (output_idx >= OUTPUT_COUNT_MAX)
+    {
+        log_warn("AMISS_STAGE", "Too many outputs, dropping hash of %s\n",
+                 path);
+        return;
+    }
+    snprintf(stage_outputs[output_idx].path,
+             sizeof(stage_outputs[output_idx].path), "%s", path);
+    stage_outputs[output_idx].hash = hash;
+}
+
+/**
+ * @brief Hash bytes with FNV-1a. Can be applied to consecutive buffers to hash
+ * them as if they were one.
+ * @param hash AMISS_HASH_INIT or the hash of preceding bytes.
+ * @param b Bytes to hash.
+ * @param len Number of bytes.
+ * @return Updated hash.
+ */
+uint64_t amiss_hash(uint64_t const hash, uint8_t const *const b,
+                    size_t const len)
+{
+    uint64_t hash_new = hash;
+    for (size_t b_idx = 0U; b_idx < len; ++b_idx)
+    {
+        hash_new = (hash_new ^ b[b_idx]) * 0x100000001B3U;
+    }
+    return hash_new;
+}